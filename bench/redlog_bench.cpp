@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <redlog.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+// redlog-bench: microbenchmarks for the logging hot paths, written to a null sink
+
+namespace {
+
+// allocations made by the whole process, counted by the operator new below
+std::atomic<std::uint64_t> allocations{0};
+
+} // namespace
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+// gcc pairs the inlined free() with the library's operator new calls and warns about a mismatch that is not there
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+// accepts everything and only counts bytes, so the benchmarks measure redlog rather than a terminal or disk
+class null_sink : public redlog::sink {
+  std::atomic<std::uint64_t> bytes_{0};
+
+public:
+  void write(std::string_view formatted) override { bytes_.fetch_add(formatted.size(), std::memory_order_relaxed); }
+  void write_record(redlog::level, std::string_view formatted) override { write(formatted); }
+  void flush() override {}
+
+  std::uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+};
+
+struct point {
+  int x;
+  int y;
+
+  friend std::ostream& operator<<(std::ostream& os, const point& p) { return os << '(' << p.x << ", " << p.y << ')'; }
+};
+
+} // namespace
+
+// kept inline in fields and streamed only when formatted
+template <> struct redlog::inline_field_value<point> : std::true_type {};
+
+namespace {
+
+struct options {
+  enum class output { text, json, csv } format = output::text;
+  std::string filter;
+  std::chrono::milliseconds min_time{200};
+  std::vector<int> threads{1, 2, 4, 8, 16};
+};
+
+struct result {
+  std::string name;
+  int threads = 1;
+  std::uint64_t calls = 0;
+  double seconds = 0;
+  double mean_ns = 0;
+  double p50_ns = 0;
+  double p90_ns = 0;
+  double p99_ns = 0;
+  double p999_ns = 0;
+  double allocs_per_call = 0;
+  double bytes_per_second = 0;
+};
+
+// calls per timed sample; per-call latency is the sample time divided by this
+constexpr int batch = 64;
+
+double percentile(std::vector<double>& sorted, double q) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  std::size_t index = static_cast<std::size_t>(q * static_cast<double>(sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+/**
+ * Run `body` in batches on `threads` threads until min_time has passed and
+ * summarize the per-call latency of every batch. Each thread gets its own
+ * logger copy, as a thread in an application would.
+ */
+result measure(
+    const std::string& name, int threads, const options& opts, const std::shared_ptr<null_sink>& sink_ptr,
+    const std::function<void(int thread, int i)>& body
+) {
+  // warm up caches, interned names and scratch buffers
+  for (int i = 0; i < batch * 16; ++i) {
+    body(0, i);
+  }
+
+  std::vector<std::vector<double>> samples(static_cast<std::size_t>(threads));
+  std::atomic<bool> start{false};
+  std::atomic<int> ready{0};
+  const auto deadline_length = opts.min_time;
+
+  auto worker = [&](int thread) {
+    std::vector<double>& mine = samples[static_cast<std::size_t>(thread)];
+    mine.reserve(1 << 16);
+    ready.fetch_add(1);
+    while (!start.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    const auto end = std::chrono::steady_clock::now() + deadline_length;
+    int i = 0;
+    for (;;) {
+      auto before = std::chrono::steady_clock::now();
+      for (int n = 0; n < batch; ++n, ++i) {
+        body(thread, i);
+      }
+      auto after = std::chrono::steady_clock::now();
+      mine.push_back(std::chrono::duration<double, std::nano>(after - before).count() / batch);
+      if (after >= end) {
+        break;
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (int t = 1; t < threads; ++t) {
+    pool.emplace_back(worker, t);
+  }
+  while (ready.load() < threads - 1) {
+    std::this_thread::yield();
+  }
+
+  const std::uint64_t bytes_before = sink_ptr->bytes();
+  const auto wall_start = std::chrono::steady_clock::now();
+  const std::uint64_t allocations_before = allocations.load();
+  start.store(true, std::memory_order_release);
+  worker(0);
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  const std::uint64_t allocations_after = allocations.load();
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+  std::vector<double> all;
+  for (auto& per_thread : samples) {
+    all.insert(all.end(), per_thread.begin(), per_thread.end());
+  }
+  std::sort(all.begin(), all.end());
+
+  result out;
+  out.name = name;
+  out.threads = threads;
+  out.calls = static_cast<std::uint64_t>(all.size()) * batch;
+  out.seconds = seconds;
+  double total = 0;
+  for (double sample : all) {
+    total += sample;
+  }
+  out.mean_ns = all.empty() ? 0 : total / static_cast<double>(all.size());
+  out.p50_ns = percentile(all, 0.50);
+  out.p90_ns = percentile(all, 0.90);
+  out.p99_ns = percentile(all, 0.99);
+  out.p999_ns = percentile(all, 0.999);
+  // the sample vectors grow a few times per thread; spread that over the calls
+  out.allocs_per_call =
+      out.calls ? static_cast<double>(allocations_after - allocations_before) / static_cast<double>(out.calls) : 0;
+  out.bytes_per_second = seconds > 0 ? static_cast<double>(sink_ptr->bytes() - bytes_before) / seconds : 0;
+  return out;
+}
+
+void print_header(const options& opts) {
+  if (opts.format == options::output::text) {
+    std::printf(
+        "%-28s %7s %12s %9s %9s %9s %9s %9s %10s %12s\n", "benchmark", "threads", "calls", "mean ns", "p50 ns",
+        "p90 ns", "p99 ns", "p99.9 ns", "allocs", "MB/s"
+    );
+  } else if (opts.format == options::output::csv) {
+    std::printf("name,threads,calls,seconds,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,allocs_per_call,bytes_per_second\n");
+  }
+}
+
+void print_result(const options& opts, const result& r, bool first) {
+  switch (opts.format) {
+  case options::output::text:
+    std::printf(
+        "%-28s %7d %12llu %9.1f %9.1f %9.1f %9.1f %9.1f %10.3f %12.1f\n", r.name.c_str(), r.threads,
+        static_cast<unsigned long long>(r.calls), r.mean_ns, r.p50_ns, r.p90_ns, r.p99_ns, r.p999_ns,
+        r.allocs_per_call, r.bytes_per_second / 1e6
+    );
+    break;
+  case options::output::csv:
+    std::printf(
+        "%s,%d,%llu,%.6f,%.2f,%.2f,%.2f,%.2f,%.2f,%.4f,%.0f\n", r.name.c_str(), r.threads,
+        static_cast<unsigned long long>(r.calls), r.seconds, r.mean_ns, r.p50_ns, r.p90_ns, r.p99_ns, r.p999_ns,
+        r.allocs_per_call, r.bytes_per_second
+    );
+    break;
+  case options::output::json:
+    std::printf(
+        "%s\n  {\"name\":\"%s\",\"threads\":%d,\"calls\":%llu,\"seconds\":%.6f,\"mean_ns\":%.2f,\"p50_ns\":%.2f,"
+        "\"p90_ns\":%.2f,\"p99_ns\":%.2f,\"p999_ns\":%.2f,\"allocs_per_call\":%.4f,\"bytes_per_second\":%.0f}",
+        first ? "" : ",", r.name.c_str(), r.threads, static_cast<unsigned long long>(r.calls), r.seconds, r.mean_ns,
+        r.p50_ns, r.p90_ns, r.p99_ns, r.p999_ns, r.allocs_per_call, r.bytes_per_second
+    );
+    break;
+  }
+  std::fflush(stdout);
+}
+
+void usage() {
+  std::cerr << "usage: redlog_bench [--json|--csv] [--filter=text] [--min-time=ms] [--threads=1,2,4]\n"
+            << "  times redlog calls against a null sink and reports per-call latency percentiles,\n"
+            << "  allocations per call and formatted bytes per second\n";
+}
+
+bool parse(int argc, char** argv, options& opts) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--json") {
+      opts.format = options::output::json;
+    } else if (arg == "--csv") {
+      opts.format = options::output::csv;
+    } else if (arg.rfind("--filter=", 0) == 0) {
+      opts.filter = arg.substr(9);
+    } else if (arg.rfind("--min-time=", 0) == 0) {
+      opts.min_time = std::chrono::milliseconds(std::atoi(arg.c_str() + 11));
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      opts.threads.clear();
+      for (const char* p = arg.c_str() + 10; *p;) {
+        char* next = nullptr;
+        long count = std::strtol(p, &next, 10);
+        if (next == p || count < 1) {
+          return false;
+        }
+        opts.threads.push_back(static_cast<int>(count));
+        p = *next == ',' ? next + 1 : next;
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  using namespace redlog;
+
+  options opts;
+  if (!parse(argc, argv, opts)) {
+    usage();
+    return 2;
+  }
+
+  set_level(level::info);
+  auto sink_ptr = std::make_shared<null_sink>();
+  auto plain = std::make_shared<default_formatter>(themes::plain);
+  logger log("bench", plain, sink_ptr);
+  logger json_log("bench", std::make_shared<json_formatter>(), sink_ptr);
+  logger scoped = log.with_name("request").with_field("request_id", 12345).with_field("method", "POST");
+  const std::string user = "alice";
+  const point where{3, 4};
+
+  struct benchmark_case {
+    std::string name;
+    std::function<void(int thread, int i)> body;
+  };
+  const std::vector<benchmark_case> single = {
+      {"disabled_level", [&](int, int i) { log.debug("disabled", field("i", i)); }},
+      {"disabled_macro", [&](int, int i) { REDLOG_DEBUG(log, "disabled", field("i", i)); }},
+      {"simple_message", [&](int, int) { log.info("simple message"); }},
+      {"fields_1", [&](int, int i) { log.info("fields", field("id", i)); }},
+      {"fields_4",
+       [&](int, int i) {
+         log.info("fields", field("id", i), field("user", user), field("ok", true), field("x", 0.5));
+       }},
+      {"fields_8",
+       [&](int, int i) {
+         log.info(
+             "fields", field("a", i), field("b", i + 1), field("c", user), field("d", "literal"), field("e", 2.5),
+             field("f", false), field("g", 7u), field("h", 'z')
+         );
+       }},
+      {"printf_%d", [&](int, int i) { log.info_f("value %d", i); }},
+      {"printf_%s", [&](int, int) { log.info_f("user %s", user); }},
+      {"printf_%f", [&](int, int i) { log.info_f("value %f", i * 0.5); }},
+      {"printf_%.2f", [&](int, int i) { log.info_f("value %.2f", i * 0.5); }},
+      {"printf_%x", [&](int, int i) { log.info_f("value %x", i); }},
+      {"printf_%o", [&](int, int i) { log.info_f("value %o", i); }},
+      {"printf_%c", [&](int, int) { log.info_f("value %c", 'q'); }},
+      {"printf_compiled", [&](int, int i) { log.info_f(REDLOG_FMT("value %d %s"), i, user); }},
+      {"printf_custom_type", [&](int, int) { log.info_f("at %s", where); }},
+      {"field_custom_type", [&](int, int) { log.info("at", field("where", where)); }},
+      {"get_logger", [&](int, int) { get_logger("bench.registry").debug("disabled"); }},
+      {"scoped_logger", [&](int, int) { scoped.info("scoped message"); }},
+      {"with_field_chain",
+       [&](int, int i) { log.with_name("module").with_field("session", i).with_field("user", user).info("chain"); }},
+      {"json_fields_4",
+       [&](int, int i) {
+         json_log.info("fields", field("id", i), field("user", user), field("ok", true), field("x", 0.5));
+       }},
+  };
+
+  const std::vector<benchmark_case> contended = {
+      {"contended_fields_2", [&](int thread, int i) { log.info("contended", field("thread", thread), field("i", i)); }},
+      {"contended_printf", [&](int thread, int i) { log.info_f("thread %d call %d", thread, i); }},
+  };
+
+  auto wanted = [&](const std::string& name) {
+    return opts.filter.empty() || name.find(opts.filter) != std::string::npos;
+  };
+
+  bool first = true;
+  if (opts.format == options::output::json) {
+    std::printf("[");
+  }
+  print_header(opts);
+  for (const auto& c : single) {
+    if (wanted(c.name)) {
+      print_result(opts, measure(c.name, 1, opts, sink_ptr, c.body), first);
+      first = false;
+    }
+  }
+  for (const auto& c : contended) {
+    if (!wanted(c.name)) {
+      continue;
+    }
+    for (int threads : opts.threads) {
+      print_result(opts, measure(c.name, threads, opts, sink_ptr, c.body), first);
+      first = false;
+    }
+  }
+  if (opts.format == options::output::json) {
+    std::printf("\n]\n");
+  }
+  return 0;
+}
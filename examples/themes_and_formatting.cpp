@@ -315,7 +315,7 @@ public:
 
     // Source component
     if (!entry.source.empty()) {
-      std::string source_part = entry.source;
+      std::string source_part(entry.source);
       oss << redlog::detail::colorize(source_part, theme_.source_color, redlog::color::none) << " ";
     }
 
@@ -336,7 +336,7 @@ public:
         }
         first = false;
         oss << redlog::detail::colorize(f.key, theme_.field_key_color, redlog::color::none) << "="
-            << redlog::detail::colorize(f.value, theme_.field_value_color, redlog::color::none);
+            << redlog::detail::colorize(f.value.str(), theme_.field_value_color, redlog::color::none);
       }
       oss << "]";
     }
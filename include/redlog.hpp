@@ -1,35 +1,89 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <charconv>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
+#include <deque>
 #include <functional>
-#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <memory>
-#include <sstream>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
 #include <vector>
 
 // platform detection for TTY support
 #ifdef _WIN32
+#include <fcntl.h>
 #include <io.h>
+#include <sys/stat.h>
 #define REDLOG_IS_TTY(stream) _isatty(_fileno(stream))
 #else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <unistd.h>
 #define REDLOG_IS_TTY(stream) isatty(fileno(stream))
 #endif
 
-// compile-time log level filtering
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define REDLOG_HAS_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define REDLOG_HAS_TSC 1
+#endif
+
+// vector scanning for string escaping
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define REDLOG_HAS_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define REDLOG_HAS_NEON 1
+#endif
+
+// compile-time parsed printf format: log.info_f(REDLOG_FMT("took %.2f ms"), ms)
+#define REDLOG_FMT(str) (::redlog::detail::compiled_format<::redlog::detail::fixed_string{str}>{})
+
+// compile-time log level filtering; the REDLOG_<LEVEL> macros remove calls above it, arguments included
 #ifndef REDLOG_MIN_LEVEL
 #define REDLOG_MIN_LEVEL 8 // annoying level (allow all levels by default)
 #endif
 
+// redlog::stats() counters; 0 compiles them out
+#ifndef REDLOG_STATS
+#define REDLOG_STATS 1
+#endif
+
 namespace redlog {
 
 /**
@@ -64,6 +118,14 @@ constexpr std::string_view level_short_name(level l) noexcept {
   return (idx >= 0 && idx < 9) ? names[idx] : "unk";
 }
 
+// level sets as bit masks: level_mask(level::error) | level_mask(level::critical) == levels_up_to(level::error)
+constexpr std::uint32_t level_mask(level l) noexcept {
+  int idx = static_cast<int>(l);
+  return (idx >= 0 && idx < 9) ? (1u << idx) : 0u;
+}
+
+constexpr std::uint32_t levels_up_to(level l) noexcept { return level_mask(l) ? (level_mask(l) << 1) - 1 : 0u; }
+
 // ansi color codes
 enum class color : int {
   none = 0,
@@ -141,6 +203,8 @@ struct theme {
   int source_width = 12;        // fixed width for source names
   int message_fixed_width = 44; // fixed width for message field (logrus-style)
   bool pad_level_text = true;   // pad level text for consistent alignment
+
+  bool operator==(const theme&) const = default;
 };
 
 namespace themes {
@@ -177,6 +241,38 @@ inline constexpr theme plain{
 };
 } // namespace themes
 
+/**
+ * Where record timestamps come from.
+ */
+enum class clock_source {
+  system, // std::chrono::system_clock::now()
+  coarse, // last kernel tick (CLOCK_REALTIME_COARSE where available); a few ms of resolution, much cheaper
+  tsc,    // cpu timestamp counter scaled to wall time and recalibrated every second; system where unavailable
+  none    // no clock read at all; records carry a zero time_point
+};
+
+class formatter;
+class sink;
+
+/**
+ * Run-time configuration edited as a whole through configure().
+ */
+struct settings {
+  level min_level = level::info;
+  theme active_theme = themes::default_theme;
+  clock_source clock = clock_source::system;
+  std::map<std::string, level, std::less<>> level_overrides; // logger name -> level for it and its children
+  std::uint32_t source_levels = 0; // levels whose REDLOG_<LEVEL> records carry their call site, see level_mask()
+  bool measure_latency = false;    // time formatting and sink writes for redlog::stats()
+
+  // where get_logger() loggers write and how they format; null: one shared console_sink / default_formatter
+  std::shared_ptr<sink> output_sink;
+  std::shared_ptr<formatter> output_formatter;
+  std::map<std::string, std::shared_ptr<sink>, std::less<>> sink_routes; // logger name -> sink for it and its children
+
+  bool operator==(const settings&) const = default;
+};
+
 namespace detail {
 
 // simple TTY and color detection
@@ -193,6 +289,150 @@ inline bool should_use_color() noexcept {
   return use_color;
 }
 
+/**
+ * Growable character buffer with inline storage.
+ *
+ * Formatting appends into this instead of std::ostringstream; records that
+ * fit the inline capacity never touch the heap.
+ */
+template <std::size_t InlineCapacity> class basic_fmt_buffer {
+  char inline_[InlineCapacity];
+  std::unique_ptr<char[]> heap_;
+  char* data_ = inline_;
+  std::size_t size_ = 0;
+  std::size_t capacity_ = InlineCapacity;
+
+  void grow(std::size_t min_capacity) {
+    std::size_t new_capacity = std::max(capacity_ * 2, min_capacity);
+    auto new_heap = std::make_unique<char[]>(new_capacity);
+    std::memcpy(new_heap.get(), data_, size_);
+    heap_ = std::move(new_heap);
+    data_ = heap_.get();
+    capacity_ = new_capacity;
+  }
+
+public:
+  basic_fmt_buffer() = default;
+  basic_fmt_buffer(const basic_fmt_buffer&) = delete;
+  basic_fmt_buffer& operator=(const basic_fmt_buffer&) = delete;
+
+  void reserve(std::size_t capacity) {
+    if (capacity > capacity_) {
+      grow(capacity);
+    }
+  }
+
+  // make room for n more characters and return where they go
+  char* append_uninitialized(std::size_t n) {
+    reserve(size_ + n);
+    char* out = data_ + size_;
+    size_ += n;
+    return out;
+  }
+
+  void append(std::string_view text) {
+    if (!text.empty()) {
+      std::memcpy(append_uninitialized(text.size()), text.data(), text.size());
+    }
+  }
+
+  void append(std::size_t count, char c) {
+    if (count > 0) {
+      std::memset(append_uninitialized(count), c, count);
+    }
+  }
+
+  void push_back(char c) {
+    if (size_ == capacity_) {
+      grow(size_ + 1);
+    }
+    data_[size_++] = c;
+  }
+
+  void resize(std::size_t size) {
+    reserve(size);
+    size_ = size;
+  }
+
+  void clear() noexcept { size_ = 0; }
+  char* data() noexcept { return data_; }
+  const char* data() const noexcept { return data_; }
+  std::size_t size() const noexcept { return size_; }
+  std::size_t capacity() const noexcept { return capacity_; }
+  bool empty() const noexcept { return size_ == 0; }
+  std::string_view view() const noexcept { return std::string_view(data_, size_); }
+  std::string str() const { return std::string(data_, size_); }
+};
+
+using fmt_buffer = basic_fmt_buffer<256>;
+
+/**
+ * Per-thread formatting buffer that keeps its capacity between records,
+ * so steady-state logging does not allocate. Nested use on one thread
+ * (a formatter or operator<< that logs) takes the next buffer in the pool.
+ */
+class scratch_buffer {
+  static constexpr int pool_size = 4;
+
+  struct pool {
+    fmt_buffer buffers[pool_size];
+    int depth = 0;
+  };
+
+  static pool& thread_pool() {
+    thread_local pool instance;
+    return instance;
+  }
+
+  fmt_buffer* buffer_;
+  std::unique_ptr<fmt_buffer> overflow_;
+
+public:
+  scratch_buffer() {
+    pool& p = thread_pool();
+    if (p.depth < pool_size) {
+      buffer_ = &p.buffers[p.depth++];
+      buffer_->clear();
+    } else {
+      overflow_ = std::make_unique<fmt_buffer>();
+      buffer_ = overflow_.get();
+    }
+  }
+
+  ~scratch_buffer() {
+    if (!overflow_) {
+      thread_pool().depth--;
+    }
+  }
+
+  scratch_buffer(const scratch_buffer&) = delete;
+  scratch_buffer& operator=(const scratch_buffer&) = delete;
+
+  fmt_buffer& get() noexcept { return *buffer_; }
+  std::string_view view() const noexcept { return buffer_->view(); }
+};
+
+// streambuf appending to a fmt_buffer, for types that only know operator<<
+class buffer_streambuf : public std::streambuf {
+  fmt_buffer& out_;
+
+protected:
+  int_type overflow(int_type ch) override {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+      out_.push_back(traits_type::to_char_type(ch));
+    }
+    return traits_type::not_eof(ch);
+  }
+
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    out_.append(std::string_view(s, static_cast<std::size_t>(n)));
+    return n;
+  }
+
+public:
+  explicit buffer_streambuf(fmt_buffer& out) : out_(out) {}
+};
+
 // simple ansi color formatting
 inline std::string colorize(std::string_view text, color fg_color, color bg_color = color::none) {
   if (!should_use_color() || (fg_color == color::none && bg_color == color::none)) {
@@ -223,6 +463,88 @@ inline std::string colorize(std::string_view text, color fg_color, color bg_colo
   return escape_seq + std::string(text) + "\033[0m";
 }
 
+// append text wrapped in ansi color codes (same bytes as colorize)
+inline void colorize_to(fmt_buffer& out, std::string_view text, color fg_color, color bg_color = color::none) {
+  if (!should_use_color() || (fg_color == color::none && bg_color == color::none)) {
+    out.append(text);
+    return;
+  }
+
+  char codes[16];
+  char* pos = codes;
+  if (fg_color != color::none) {
+    pos = std::to_chars(pos, codes + sizeof(codes), static_cast<int>(fg_color)).ptr;
+  }
+  if (bg_color != color::none) {
+    if (pos != codes) {
+      *pos++ = ';';
+    }
+    pos = std::to_chars(pos, codes + sizeof(codes), static_cast<int>(bg_color)).ptr;
+  }
+
+  out.append("\033[");
+  out.append(std::string_view(codes, static_cast<std::size_t>(pos - codes)));
+  out.push_back('m');
+  out.append(text);
+  out.append("\033[0m");
+}
+
+/**
+ * Precomputed escape sequence for one fg/bg color pair.
+ *
+ * Wrapping text in open() and close() yields the same bytes as colorize_to;
+ * both are empty when the pair has no colors or color output is disabled.
+ */
+class ansi_style {
+  char open_[16] = {};
+  std::uint8_t open_length_ = 0;
+  bool active_ = false;
+
+public:
+  static constexpr std::string_view reset = "\033[0m";
+
+  constexpr ansi_style() = default;
+
+  ansi_style(color fg_color, color bg_color, bool enabled = should_use_color()) {
+    if (!enabled || (fg_color == color::none && bg_color == color::none)) {
+      return;
+    }
+
+    char* pos = open_;
+    *pos++ = '\033';
+    *pos++ = '[';
+    if (fg_color != color::none) {
+      pos = std::to_chars(pos, open_ + sizeof(open_), static_cast<int>(fg_color)).ptr;
+    }
+    if (bg_color != color::none) {
+      if (fg_color != color::none) {
+        *pos++ = ';';
+      }
+      pos = std::to_chars(pos, open_ + sizeof(open_), static_cast<int>(bg_color)).ptr;
+    }
+    *pos++ = 'm';
+    open_length_ = static_cast<std::uint8_t>(pos - open_);
+    active_ = true;
+  }
+
+  bool active() const noexcept { return active_; }
+  std::string_view open() const noexcept { return std::string_view(open_, open_length_); }
+  std::string_view close() const noexcept { return active_ ? reset : std::string_view(); }
+
+  // total bytes added around the text
+  std::size_t overhead() const noexcept { return open_length_ + close().size(); }
+
+  void wrap(fmt_buffer& out, std::string_view text) const {
+    if (!active_) {
+      out.append(text);
+      return;
+    }
+    out.append(open());
+    out.append(text);
+    out.append(reset);
+  }
+};
+
 // SFINAE helpers for type detection
 template <typename T, typename = void> struct has_ostream_operator : std::false_type {};
 
@@ -230,6 +552,69 @@ template <typename T>
 struct has_ostream_operator<T, std::void_t<decltype(std::declval<std::ostream&>() << std::declval<T>())>>
     : std::true_type {};
 
+// append an integer in the given base (lowercase digits)
+template <typename T> void write_integer(fmt_buffer& out, T value, int base = 10) {
+  char digits[72];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value, base);
+  out.append(std::string_view(digits, static_cast<std::size_t>(result.ptr - digits)));
+}
+
+// append a floating point value exactly as printf would with the given format
+template <typename T> void write_float(fmt_buffer& out, T value, std::chars_format format, int precision) {
+  // render in place, retrying with more room for huge values or precisions
+  for (std::size_t room = 64; room <= (std::size_t(1) << 24); room *= 8) {
+    std::size_t start = out.size();
+    char* dst = out.append_uninitialized(room);
+    auto result = std::to_chars(dst, dst + room, value, format, precision);
+    if (result.ec == std::errc()) {
+      out.resize(start + static_cast<std::size_t>(result.ptr - dst));
+      return;
+    }
+    out.resize(start);
+  }
+  out.append("[format_error]");
+}
+
+/**
+ * Append any value to a buffer using stringify's rules.
+ *
+ * Strings are appended without copies, arithmetic types produce the same
+ * text as std::to_string, and custom types stream through operator<<.
+ */
+template <typename T> void stringify_to(fmt_buffer& out, const T& value) {
+  using decay_t = std::decay_t<T>;
+
+  // handle string types directly
+  if constexpr (std::is_same_v<decay_t, const char*> || std::is_same_v<decay_t, char*>) {
+    const char* text = value;
+    out.append(text ? std::string_view(text) : std::string_view("null"));
+  } else if constexpr (std::is_convertible_v<const decay_t&, std::string_view>) {
+    out.append(std::string_view(value));
+  }
+  // handle arithmetic types (matching std::to_string)
+  else if constexpr (std::is_same_v<decay_t, float>) {
+    write_float(out, static_cast<double>(value), std::chars_format::fixed, 6);
+  } else if constexpr (std::is_floating_point_v<decay_t>) {
+    write_float(out, value, std::chars_format::fixed, 6);
+  } else if constexpr (std::is_arithmetic_v<decay_t>) {
+    if constexpr (sizeof(decay_t) < sizeof(int)) {
+      write_integer(out, static_cast<int>(value));
+    } else {
+      write_integer(out, value);
+    }
+  }
+  // handle types with operator<<
+  else if constexpr (has_ostream_operator<decay_t>::value) {
+    buffer_streambuf streambuf(out);
+    std::ostream os(&streambuf);
+    os << value;
+  }
+  // fallback for unprintable types
+  else {
+    out.append("[unprintable]");
+  }
+}
+
 /**
  * Universal type-to-string conversion.
  *
@@ -242,28 +627,58 @@ struct has_ostream_operator<T, std::void_t<decltype(std::declval<std::ostream&>(
 template <typename T> std::string stringify(T&& value) {
   using decay_t = std::decay_t<T>;
 
-  // handle string types directly
   if constexpr (std::is_same_v<decay_t, std::string>) {
-    return value;
-  } else if constexpr (std::is_convertible_v<decay_t, std::string_view>) {
-    return std::string(value);
-  } else if constexpr (std::is_same_v<decay_t, const char*> || std::is_same_v<decay_t, char*>) {
-    return value ? std::string(value) : "null";
+    return std::forward<T>(value);
+  } else if constexpr (std::is_convertible_v<const decay_t&, std::string_view> && !std::is_pointer_v<decay_t>) {
+    return std::string(std::string_view(value));
+  } else {
+    fmt_buffer out;
+    stringify_to(out, value);
+    return out.str();
+  }
+}
+
+constexpr bool is_format_digit(char c) noexcept { return c >= '0' && c <= '9'; }
+
+constexpr bool is_conversion_char(char c) noexcept {
+  constexpr std::string_view conversions = "diouxXeEfFgGaAcspn";
+  return conversions.find(c) != std::string_view::npos;
+}
+
+/**
+ * Find the end of the format specifier starting at the '%' at `percent`.
+ *
+ * Returns the index one past the conversion character, or npos if the
+ * format ends before one is found. Shared by the runtime and compile-time
+ * parsers so both accept exactly the same specifiers.
+ */
+constexpr std::size_t scan_format_spec(std::string_view format, std::size_t percent) noexcept {
+  std::size_t pos = percent + 1;
+
+  // skip flags like '0', '-'
+  while (pos < format.size() && (format[pos] == '0' || format[pos] == '-')) {
+    pos++;
   }
-  // handle arithmetic types
-  else if constexpr (std::is_arithmetic_v<decay_t>) {
-    return std::to_string(value);
+
+  // skip width specifier
+  while (pos < format.size() && is_format_digit(format[pos])) {
+    pos++;
   }
-  // handle types with operator<<
-  else if constexpr (has_ostream_operator<decay_t>::value) {
-    std::ostringstream oss;
-    oss << value;
-    return oss.str();
+
+  // skip precision specifier like %.2f
+  if (pos < format.size() && format[pos] == '.') {
+    pos++;
+    while (pos < format.size() && is_format_digit(format[pos])) {
+      pos++;
+    }
   }
-  // fallback for unprintable types
-  else {
-    return "[unprintable]";
+
+  // find the actual format character
+  while (pos < format.size() && !is_conversion_char(format[pos])) {
+    pos++;
   }
+
+  return pos < format.size() ? pos + 1 : std::string_view::npos;
 }
 
 /**
@@ -271,20 +686,20 @@ template <typename T> std::string stringify(T&& value) {
  */
 // helper to parse format specifiers with width and precision
 struct format_spec_info {
-  char format_char;
+  char format_char = 's';
   int width = 0;
   int precision = -1;
   bool zero_pad = false;
   bool left_align = false;
 
-  static format_spec_info parse(const std::string& format_spec) {
+  static constexpr format_spec_info parse(std::string_view format_spec) noexcept {
     format_spec_info info;
     if (format_spec.length() < 2) {
       return info;
     }
 
     info.format_char = format_spec.back();
-    std::string_view spec_view(format_spec);
+    std::string_view spec_view = format_spec;
     spec_view.remove_prefix(1); // remove '%'
     spec_view.remove_suffix(1); // remove format char
 
@@ -305,116 +720,129 @@ struct format_spec_info {
 
     // parse width
     std::size_t width_start = pos;
-    while (pos < spec_view.length() && std::isdigit(spec_view[pos])) {
-      pos++;
-    }
-    if (pos > width_start) {
-      std::string width_str(spec_view.substr(width_start, pos - width_start));
-      info.width = std::stoi(width_str);
+    pos = parse_number(spec_view, pos, info.width);
+    if (pos == width_start) {
+      info.width = 0;
     }
 
     // parse precision
     if (pos < spec_view.length() && spec_view[pos] == '.') {
       pos++;
       std::size_t precision_start = pos;
-      while (pos < spec_view.length() && std::isdigit(spec_view[pos])) {
-        pos++;
-      }
+      int precision = 0;
+      pos = parse_number(spec_view, pos, precision);
       if (pos > precision_start) {
-        std::string precision_str(spec_view.substr(precision_start, pos - precision_start));
-        info.precision = std::stoi(precision_str);
+        info.precision = precision;
       }
     }
 
     return info;
   }
+
+private:
+  // parse a run of digits, saturating instead of overflowing
+  static constexpr std::size_t parse_number(std::string_view text, std::size_t pos, int& out) noexcept {
+    constexpr int limit = 1 << 20;
+    out = 0;
+    while (pos < text.length() && is_format_digit(text[pos])) {
+      out = out < limit ? out * 10 + (text[pos] - '0') : limit;
+      pos++;
+    }
+    return pos;
+  }
 };
 
-template <typename T> void format_argument(std::ostringstream& oss, T&& value, const std::string& format_spec) {
-  using decay_t = std::decay_t<T>;
+/**
+ * Stream state that the original ostringstream implementation carried from
+ * one specifier to the next within a single format call: a precision set by
+ * %.Nf/%.Ne becomes the default for later %f/%e, and %X/%E leave uppercase
+ * on until a %x. Tracked explicitly so output stays byte-identical.
+ */
+struct format_state {
+  int precision = 6;
+  bool uppercase = false;
+};
 
-  if (format_spec.length() < 2) {
-    oss << stringify(std::forward<T>(value));
+// pad the text written since `start` to the specifier width
+inline void pad_to_width(fmt_buffer& out, std::size_t start, const format_spec_info& spec, bool zero_fill) {
+  std::size_t length = out.size() - start;
+  if (spec.width <= 0 || length >= static_cast<std::size_t>(spec.width)) {
     return;
   }
 
-  auto spec_info = format_spec_info::parse(format_spec);
+  std::size_t padding = static_cast<std::size_t>(spec.width) - length;
+  if (spec.left_align) {
+    out.append(padding, ' ');
+    return;
+  }
+
+  out.resize(out.size() + padding);
+  char* begin = out.data() + start;
+  std::memmove(begin + padding, begin, length);
+  std::memset(begin, zero_fill ? '0' : ' ', padding);
+}
+
+inline void uppercase_from(fmt_buffer& out, std::size_t start) {
+  for (char* c = out.data() + start; c != out.data() + out.size(); ++c) {
+    if (*c >= 'a' && *c <= 'z') {
+      *c = static_cast<char>(*c - 'a' + 'A');
+    }
+  }
+}
+
+template <typename T>
+void format_argument(fmt_buffer& out, const T& value, const format_spec_info& spec_info, format_state& state) {
+  using decay_t = std::decay_t<T>;
+
+  // numeric conversions of non-arithmetic values fall back to stringify, unpadded
+  if constexpr (!std::is_arithmetic_v<decay_t>) {
+    switch (spec_info.format_char) {
+    case 'd':
+    case 'i':
+    case 'x':
+    case 'X':
+    case 'o':
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'c':
+      stringify_to(out, value);
+      return;
+    default:
+      break;
+    }
+  }
+
+  std::size_t start = out.size();
+  bool zero_fill = spec_info.zero_pad && !spec_info.left_align;
 
   // Handle different format specifiers
   switch (spec_info.format_char) {
   case 'd':
   case 'i':
     if constexpr (std::is_arithmetic_v<decay_t>) {
-      if (spec_info.width > 0) {
-        oss << std::setw(spec_info.width);
-        if (spec_info.zero_pad && !spec_info.left_align) {
-          oss << std::setfill('0');
-        }
-        if (spec_info.left_align) {
-          oss << std::left;
-        }
-      }
-      oss << static_cast<long long>(value);
-      oss << std::setfill(' ') << std::right; // reset
-    } else {
-      oss << stringify(std::forward<T>(value));
+      write_integer(out, static_cast<long long>(value));
+      pad_to_width(out, start, spec_info, zero_fill);
     }
     break;
 
   case 'x':
-    if constexpr (std::is_arithmetic_v<decay_t>) {
-      oss << std::hex << std::nouppercase;
-      if (spec_info.width > 0) {
-        oss << std::setw(spec_info.width);
-        if (spec_info.zero_pad && !spec_info.left_align) {
-          oss << std::setfill('0');
-        }
-        if (spec_info.left_align) {
-          oss << std::left;
-        }
-      }
-      oss << static_cast<unsigned long long>(value) << std::dec;
-      oss << std::setfill(' ') << std::right; // reset
-    } else {
-      oss << stringify(std::forward<T>(value));
-    }
-    break;
-
   case 'X':
     if constexpr (std::is_arithmetic_v<decay_t>) {
-      oss << std::hex << std::uppercase;
-      if (spec_info.width > 0) {
-        oss << std::setw(spec_info.width);
-        if (spec_info.zero_pad && !spec_info.left_align) {
-          oss << std::setfill('0');
-        }
-        if (spec_info.left_align) {
-          oss << std::left;
-        }
+      state.uppercase = spec_info.format_char == 'X';
+      write_integer(out, static_cast<unsigned long long>(value), 16);
+      if (state.uppercase) {
+        uppercase_from(out, start);
       }
-      oss << static_cast<unsigned long long>(value) << std::dec;
-      oss << std::setfill(' ') << std::right; // reset
-    } else {
-      oss << stringify(std::forward<T>(value));
+      pad_to_width(out, start, spec_info, zero_fill);
     }
     break;
 
   case 'o':
     if constexpr (std::is_arithmetic_v<decay_t>) {
-      oss << std::oct;
-      if (spec_info.width > 0) {
-        oss << std::setw(spec_info.width);
-        if (spec_info.zero_pad && !spec_info.left_align) {
-          oss << std::setfill('0');
-        }
-        if (spec_info.left_align) {
-          oss << std::left;
-        }
-      }
-      oss << static_cast<unsigned long long>(value) << std::dec;
-      oss << std::setfill(' ') << std::right; // reset
-    } else {
-      oss << stringify(std::forward<T>(value));
+      write_integer(out, static_cast<unsigned long long>(value), 8);
+      pad_to_width(out, start, spec_info, zero_fill);
     }
     break;
 
@@ -422,301 +850,475 @@ template <typename T> void format_argument(std::ostringstream& oss, T&& value, c
   case 'F':
     if constexpr (std::is_arithmetic_v<decay_t>) {
       if (spec_info.precision >= 0) {
-        oss << std::fixed << std::setprecision(spec_info.precision);
+        state.precision = spec_info.precision;
+        write_float(out, static_cast<double>(value), std::chars_format::fixed, state.precision);
+      } else {
+        write_float(out, static_cast<double>(value), std::chars_format::general, state.precision);
       }
-      if (spec_info.width > 0) {
-        oss << std::setw(spec_info.width);
-        if (spec_info.zero_pad && !spec_info.left_align) {
-          oss << std::setfill('0');
-        }
-        if (spec_info.left_align) {
-          oss << std::left;
-        }
+      if (state.uppercase) {
+        uppercase_from(out, start);
       }
-      oss << static_cast<double>(value);
-      oss.unsetf(std::ios::fixed);
-      oss << std::setfill(' ') << std::right; // reset
-    } else {
-      oss << stringify(std::forward<T>(value));
+      pad_to_width(out, start, spec_info, zero_fill);
     }
     break;
 
   case 'e':
   case 'E':
     if constexpr (std::is_arithmetic_v<decay_t>) {
-      oss << std::scientific;
       if (spec_info.format_char == 'E') {
-        oss << std::uppercase;
+        state.uppercase = true;
       }
       if (spec_info.precision >= 0) {
-        oss << std::setprecision(spec_info.precision);
+        state.precision = spec_info.precision;
       }
-      if (spec_info.width > 0) {
-        oss << std::setw(spec_info.width);
-        if (spec_info.left_align) {
-          oss << std::left;
-        }
+      write_float(out, static_cast<double>(value), std::chars_format::scientific, state.precision);
+      if (state.uppercase) {
+        uppercase_from(out, start);
       }
-      oss << static_cast<double>(value);
-      oss.unsetf(std::ios::scientific);
-      oss << std::setfill(' ') << std::right; // reset
-    } else {
-      oss << stringify(std::forward<T>(value));
+      pad_to_width(out, start, spec_info, false);
     }
     break;
 
   case 'c':
     if constexpr (std::is_arithmetic_v<decay_t>) {
-      oss << static_cast<char>(value);
-    } else {
-      oss << stringify(std::forward<T>(value));
+      out.push_back(static_cast<char>(value));
     }
     break;
 
   case 's':
   default:
-    if (spec_info.width > 0) {
-      oss << std::setw(spec_info.width);
-      if (spec_info.left_align) {
-        oss << std::left;
-      }
-    }
-    oss << stringify(std::forward<T>(value));
-    oss << std::right; // reset
+    stringify_to(out, value);
+    pad_to_width(out, start, spec_info, false);
     break;
   }
 }
 
 /**
- * Stream-based printf implementation.
+ * Buffer-based printf implementation.
  *
- * Parses format specifiers and applies appropriate stream formatting.
- * Uses stringstream to handle both basic and custom types seamlessly.
+ * Parses format specifiers and appends each converted argument to a
+ * fmt_buffer; custom types still work through operator<<.
  */
 // optimized printf implementation using direct argument processing
 namespace printf_detail {
-template <std::size_t I, typename... Args>
-void process_arg_at_index(
-    std::ostringstream& oss, const std::string& format_spec, std::size_t target_index, const std::tuple<Args...>& args
+// format the argument at a runtime index through a table of per-index formatters
+template <typename Tuple, std::size_t... I>
+void format_arg_at_index(
+    fmt_buffer& out, const Tuple& args, std::size_t index, const format_spec_info& spec, format_state& state,
+    std::index_sequence<I...>
 ) {
-  if constexpr (I < sizeof...(Args)) {
-    if (I == target_index) {
-      format_argument(oss, std::get<I>(args), format_spec);
-    } else {
-      process_arg_at_index<I + 1>(oss, format_spec, target_index, args);
-    }
-  }
+  using format_fn = void (*)(fmt_buffer&, const Tuple&, const format_spec_info&, format_state&);
+  static constexpr format_fn table[] = {
+      [](fmt_buffer& o, const Tuple& t, const format_spec_info& s, format_state& st) {
+        format_argument(o, std::get<I>(t), s, st);
+      }...
+  };
+  table[index](out, args, spec, state);
 }
 } // namespace printf_detail
 
-template <typename... Args> std::string stream_printf(const char* format, Args&&... args) {
-  if constexpr (sizeof...(args) == 0) {
-    // handle zero-argument case efficiently
-    std::string result(format);
-    // just replace %% with %
-    std::size_t pos = 0;
-    while ((pos = result.find("%%", pos)) != std::string::npos) {
-      result.replace(pos, 2, "%");
-      pos += 1;
-    }
-    return result;
-  } else {
-    std::ostringstream result;
-    const char* pos = format;
-    const char* end = format + std::strlen(format);
-    std::size_t arg_index = 0;
-    auto arg_tuple = std::make_tuple(std::forward<Args>(args)...);
-
-    while (pos < end) {
-      const char* percent_pos = std::find(pos, end, '%');
-
-      if (percent_pos == end) {
-        // no more format specifiers
-        result.write(pos, end - pos);
-        break;
-      }
-
-      // append text before format specifier
-      result.write(pos, percent_pos - pos);
-
-      if (percent_pos + 1 >= end) {
-        result << '%'; // trailing % at end
-        break;
-      }
-
-      char next_char = percent_pos[1];
-      if (next_char == '%') {
-        result << '%'; // escaped %%
-        pos = percent_pos + 2;
-        continue;
+// walk a printf format, handing each conversion to format_one(index, spec, state)
+template <typename FormatOne>
+void printf_loop(fmt_buffer& out, std::string_view text, std::size_t arg_count, FormatOne&& format_one) {
+  if (arg_count == 0) {
+    // handle zero-argument case efficiently: just replace %% with %
+    for (std::size_t pos = 0; pos < text.size(); ++pos) {
+      out.push_back(text[pos]);
+      if (text[pos] == '%' && pos + 1 < text.size() && text[pos + 1] == '%') {
+        pos++;
       }
+    }
+    return;
+  }
 
-      // find end of format specifier
-      const char* spec_end = percent_pos + 1;
-
-      // skip flags like '0', '-'
-      while (spec_end < end && (*spec_end == '0' || *spec_end == '-')) {
-        spec_end++;
-      }
+  std::size_t pos = 0;
+  std::size_t arg_index = 0;
+  format_state state;
 
-      // skip width specifier
-      while (spec_end < end && std::isdigit(*spec_end)) {
-        spec_end++;
-      }
+  while (pos < text.size()) {
+    std::size_t percent_pos = text.find('%', pos);
 
-      // skip precision specifier like %.2f
-      if (spec_end < end && *spec_end == '.') {
-        spec_end++;
-        while (spec_end < end && std::isdigit(*spec_end)) {
-          spec_end++;
-        }
-      }
+    if (percent_pos == std::string_view::npos) {
+      // no more format specifiers
+      out.append(text.substr(pos));
+      break;
+    }
 
-      // find the actual format character
-      while (spec_end < end && std::strchr("diouxXeEfFgGaAcspn", *spec_end) == nullptr) {
-        spec_end++;
-      }
+    // append text before format specifier
+    out.append(text.substr(pos, percent_pos - pos));
 
-      if (spec_end >= end) {
-        // invalid format, copy as-is
-        result.write(percent_pos, end - percent_pos);
-        break;
-      }
+    if (percent_pos + 1 >= text.size()) {
+      out.push_back('%'); // trailing % at end
+      break;
+    }
 
-      spec_end++; // include the format character
+    if (text[percent_pos + 1] == '%') {
+      out.push_back('%'); // escaped %%
+      pos = percent_pos + 2;
+      continue;
+    }
 
-      if (arg_index < sizeof...(args)) {
-        std::string format_spec(percent_pos, spec_end - percent_pos);
-        printf_detail::process_arg_at_index<0>(result, format_spec, arg_index, arg_tuple);
-        arg_index++;
-      } else {
-        // no more args, copy format specifier as-is
-        result.write(percent_pos, spec_end - percent_pos);
-      }
+    std::size_t spec_end = scan_format_spec(text, percent_pos);
+    if (spec_end == std::string_view::npos) {
+      // invalid format, copy as-is
+      out.append(text.substr(percent_pos));
+      break;
+    }
 
-      pos = spec_end;
+    std::string_view format_spec = text.substr(percent_pos, spec_end - percent_pos);
+    if (arg_index < arg_count) {
+      format_one(arg_index, format_spec_info::parse(format_spec), state);
+      arg_index++;
+    } else {
+      // no more args, copy format specifier as-is
+      out.append(format_spec);
     }
 
-    return result.str();
+    pos = spec_end;
   }
 }
 
-// helper for level text alignment
-inline int get_max_level_text_width() {
-  static int cached_width = []() {
-    int max_width = 0;
-    for (int i = 0; i <= static_cast<int>(level::annoying); ++i) {
-      int width = static_cast<int>(level_short_name(static_cast<level>(i)).length());
-      max_width = std::max(max_width, width);
-    }
-    return max_width + 2; // +2 for brackets []
-  }();
-  return cached_width;
+template <typename... Args> void stream_printf_to(fmt_buffer& out, const char* format, const Args&... args) {
+  if constexpr (sizeof...(args) == 0) {
+    printf_loop(out, format, 0, [](std::size_t, const format_spec_info&, format_state&) {});
+  } else {
+    auto arg_tuple = std::forward_as_tuple(args...);
+    printf_loop(
+        out, format, sizeof...(args),
+        [&out, &arg_tuple](std::size_t index, const format_spec_info& spec, format_state& state) {
+          printf_detail::format_arg_at_index(out, arg_tuple, index, spec, state, std::index_sequence_for<Args...>{});
+        }
+    );
+  }
 }
 
-// global configuration
-class config {
-  std::atomic<level> min_level_{level::info};
-  theme theme_ = themes::default_theme;
+/**
+ * A printf argument with its C++ type reduced to a tag, as stored in binary
+ * logs. Formatting one gives the same text as the original argument.
+ */
+struct arg_value {
+  enum class kind : std::uint8_t {
+    boolean,
+    character,
+    signed_char,
+    unsigned_char,
+    int16,
+    uint16,
+    int32,
+    uint32,
+    int64,
+    uint64,
+    float64,
+    pointer,
+    string,
+    null_string
+  };
+
+  kind type = kind::null_string;
+  union {
+    std::int64_t i;
+    std::uint64_t u;
+    double d;
+  } number{};
+  std::string_view text;
+
+  template <typename T> static arg_value from(const T& value) {
+    using decay_t = std::decay_t<T>;
+    arg_value result;
+    if constexpr (std::is_enum_v<decay_t>) {
+      return from(static_cast<std::underlying_type_t<decay_t>>(value));
+    } else if constexpr (std::is_same_v<decay_t, bool>) {
+      result.type = kind::boolean;
+      result.number.u = value ? 1 : 0;
+    } else if constexpr (std::is_same_v<decay_t, char>) {
+      result.type = kind::character;
+      result.number.i = value;
+    } else if constexpr (std::is_same_v<decay_t, signed char>) {
+      result.type = kind::signed_char;
+      result.number.i = value;
+    } else if constexpr (std::is_same_v<decay_t, unsigned char>) {
+      result.type = kind::unsigned_char;
+      result.number.u = value;
+    } else if constexpr (std::is_floating_point_v<decay_t>) {
+      result.type = kind::float64;
+      result.number.d = static_cast<double>(value);
+    } else if constexpr (std::is_integral_v<decay_t>) {
+      constexpr bool is_signed = std::is_signed_v<decay_t>;
+      if constexpr (sizeof(decay_t) <= 2) {
+        result.type = is_signed ? kind::int16 : kind::uint16;
+      } else if constexpr (sizeof(decay_t) <= 4) {
+        result.type = is_signed ? kind::int32 : kind::uint32;
+      } else {
+        result.type = is_signed ? kind::int64 : kind::uint64;
+      }
+      if constexpr (is_signed) {
+        result.number.i = value;
+      } else {
+        result.number.u = value;
+      }
+    } else if constexpr (std::is_same_v<decay_t, void*> || std::is_same_v<decay_t, const void*>) {
+      result.type = kind::pointer;
+      result.number.u = reinterpret_cast<std::uintptr_t>(value);
+    } else if constexpr (std::is_same_v<decay_t, const char*> || std::is_same_v<decay_t, char*>) {
+      const char* str = value;
+      if (str) {
+        result.type = kind::string;
+        result.text = str;
+      }
+    } else {
+      result.type = kind::string;
+      result.text = std::string_view(value);
+    }
+    return result;
+  }
 
-public:
-  static config& instance() {
-    static config instance_;
-    return instance_;
+  // format as the C++ type the value was taken from
+  void format(fmt_buffer& out, const format_spec_info& spec, format_state& state) const {
+    switch (type) {
+    case kind::boolean:
+      return format_argument(out, number.u != 0, spec, state);
+    case kind::character:
+      return format_argument(out, static_cast<char>(number.i), spec, state);
+    case kind::signed_char:
+      return format_argument(out, static_cast<signed char>(number.i), spec, state);
+    case kind::unsigned_char:
+      return format_argument(out, static_cast<unsigned char>(number.u), spec, state);
+    case kind::int16:
+      return format_argument(out, static_cast<std::int16_t>(number.i), spec, state);
+    case kind::uint16:
+      return format_argument(out, static_cast<std::uint16_t>(number.u), spec, state);
+    case kind::int32:
+      return format_argument(out, static_cast<std::int32_t>(number.i), spec, state);
+    case kind::uint32:
+      return format_argument(out, static_cast<std::uint32_t>(number.u), spec, state);
+    case kind::int64:
+      return format_argument(out, number.i, spec, state);
+    case kind::uint64:
+      return format_argument(out, number.u, spec, state);
+    case kind::float64:
+      return format_argument(out, number.d, spec, state);
+    case kind::pointer:
+      return format_argument(out, reinterpret_cast<const void*>(static_cast<std::uintptr_t>(number.u)), spec, state);
+    case kind::string:
+      return format_argument(out, text, spec, state);
+    case kind::null_string:
+    default:
+      return format_argument(out, static_cast<const char*>(nullptr), spec, state);
+    }
   }
+};
+
+// printf with arguments whose types are only known at run time
+inline void stream_printf_to(fmt_buffer& out, std::string_view format, std::span<const arg_value> args) {
+  printf_loop(
+      out, format, args.size(),
+      [&out, args](std::size_t index, const format_spec_info& spec, format_state& state) {
+        args[index].format(out, spec, state);
+      }
+  );
+}
 
-  level min_level() const noexcept { return min_level_.load(std::memory_order_relaxed); }
+template <typename... Args> std::string stream_printf(const char* format, Args&&... args) {
+  fmt_buffer out;
+  stream_printf_to(out, format, args...);
+  return out.str();
+}
 
-  void set_level(level l) noexcept { min_level_.store(l, std::memory_order_relaxed); }
+/**
+ * String literal usable as a template argument (see REDLOG_FMT).
+ */
+template <std::size_t N> struct fixed_string {
+  char data[N]{};
 
-  theme get_theme() const { return theme_; }
+  constexpr fixed_string(const char (&text)[N]) noexcept {
+    for (std::size_t i = 0; i < N; ++i) {
+      data[i] = text[i];
+    }
+  }
 
-  void set_theme(const theme& t) { theme_ = t; }
+  constexpr std::string_view view() const noexcept { return std::string_view(data, N - 1); }
 };
 
-} // namespace detail
-
 /**
- * Simple structured field for key-value logging.
- *
- * Just stores a key and value as strings - no complex lazy evaluation.
+ * Format string split at compile time into unescaped literal text and
+ * parsed specifiers. Specifier i is preceded by literals[literal_ends[i-1]..literal_ends[i]).
  */
-struct field {
-  std::string key;
-  std::string value;
+template <std::size_t N> struct format_layout {
+  char literals[N + 1]{};
+  std::size_t literal_size = 0;
+  std::size_t spec_count = 0;
+  std::size_t literal_ends[N / 2 + 1]{};
+  format_spec_info specs[N / 2 + 1]{};
+};
 
-  template <typename T> field(std::string_view k, T&& v) : key(k), value(detail::stringify(std::forward<T>(v))) {}
+// a throw in a constant expression is how the parser reports bad formats at compile time
+template <std::size_t N> constexpr format_layout<N> parse_format_layout(std::string_view text) {
+  format_layout<N> layout;
+  std::size_t pos = 0;
+  while (pos < text.size()) {
+    if (text[pos] != '%') {
+      layout.literals[layout.literal_size++] = text[pos++];
+      continue;
+    }
+    if (pos + 1 < text.size() && text[pos + 1] == '%') {
+      layout.literals[layout.literal_size++] = '%';
+      pos += 2;
+      continue;
+    }
+    std::size_t spec_end = scan_format_spec(text, pos);
+    if (pos + 1 >= text.size() || spec_end == std::string_view::npos) {
+      throw "redlog: format string has an unterminated '%' specifier";
+    }
+    layout.literal_ends[layout.spec_count] = layout.literal_size;
+    layout.specs[layout.spec_count] = format_spec_info::parse(text.substr(pos, spec_end - pos));
+    layout.spec_count++;
+    pos = spec_end;
+  }
+  return layout;
+}
 
-  template <typename T>
-  field(std::string_view k, const char* format_spec, T&& v)
-      : key(k), value(detail::stream_printf(format_spec, std::forward<T>(v))) {}
-};
+constexpr bool is_numeric_conversion(char c) noexcept {
+  return c == 'd' || c == 'i' || c == 'x' || c == 'X' || c == 'o' || c == 'f' || c == 'F' || c == 'e' || c == 'E' ||
+         c == 'c';
+}
 
 /**
- * Collection of fields with simple operations.
+ * Compile-time parsed format string created with REDLOG_FMT.
  *
- * Optimized for the common case of small numbers of fields.
+ * Literal runs and specifiers are split once during compilation; the number
+ * of arguments must match the number of specifiers, and numeric conversions
+ * (%d, %x, %f, %e, %c, ...) only accept arithmetic arguments. At runtime only
+ * the argument conversions are left.
  */
-class field_set {
-  std::vector<field> fields_;
-
-public:
-  field_set() = default;
-  field_set(std::initializer_list<field> fields) : fields_(fields) {}
-
-  void add(field f) { fields_.emplace_back(std::move(f)); }
+template <fixed_string Format> struct compiled_format {
+  static constexpr std::string_view text = Format.view();
+  static constexpr auto layout = parse_format_layout<text.size()>(text);
 
-  void merge(const field_set& other) { fields_.insert(fields_.end(), other.fields_.begin(), other.fields_.end()); }
+  template <typename... Args> static constexpr bool check() {
+    static_assert(sizeof...(Args) == layout.spec_count, "redlog: argument count does not match the format string");
+    return check_types<Args...>(std::index_sequence_for<Args...>{});
+  }
 
-  // immutable operations for clean chaining
-  field_set with_field(field f) const {
-    field_set result = *this;
-    result.add(std::move(f));
-    return result;
+  template <typename... Args> static void format_to(fmt_buffer& out, const Args&... args) {
+    static_assert(check<Args...>());
+    format_state state;
+    format_impl(out, state, std::index_sequence_for<Args...>{}, args...);
   }
 
-  field_set with_fields(const field_set& other) const {
-    field_set result = *this;
-    result.merge(other);
-    return result;
+private:
+  template <typename... Args, std::size_t... I> static constexpr bool check_types(std::index_sequence<I...>) {
+    static_assert(
+        ((!is_numeric_conversion(layout.specs[I].format_char) || std::is_arithmetic_v<std::decay_t<Args>>) && ...),
+        "redlog: numeric format specifier used with a non-arithmetic argument"
+    );
+    return true;
   }
 
-  const std::vector<field>& fields() const { return fields_; }
-  bool empty() const { return fields_.empty(); }
-  std::size_t size() const { return fields_.size(); }
+  template <std::size_t... I, typename... Args>
+  static void format_impl(fmt_buffer& out, format_state& state, std::index_sequence<I...>, const Args&... args) {
+    std::size_t pos = 0;
+    (
+        (out.append(std::string_view(layout.literals + pos, layout.literal_ends[I] - pos)),
+         format_argument(out, args, layout.specs[I], state), pos = layout.literal_ends[I]),
+        ...
+    );
+    out.append(std::string_view(layout.literals + pos, layout.literal_size - pos));
+  }
 };
 
-/**
- * Log entry representing a single log message with metadata.
- */
-struct log_entry {
-  level level_val;
-  std::string message;
-  std::string source;
-  field_set fields;
-  std::chrono::system_clock::time_point timestamp;
+// raw text of a runtime or compiled format, for diagnostics
+inline std::string_view format_text(const char* format) noexcept { return format; }
+template <fixed_string Format> constexpr std::string_view format_text(compiled_format<Format>) noexcept {
+  return compiled_format<Format>::text;
+}
 
-  log_entry(level l, std::string msg, std::string src, field_set f)
-      : level_val(l), message(std::move(msg)), source(std::move(src)), fields(std::move(f)),
-        timestamp(std::chrono::system_clock::now()) {}
-};
+template <fixed_string Format, typename... Args>
+void stream_printf_to(fmt_buffer& out, compiled_format<Format>, const Args&... args) {
+  compiled_format<Format>::format_to(out, args...);
+}
+
+template <fixed_string Format, typename... Args>
+std::string stream_printf(compiled_format<Format> format, const Args&... args) {
+  fmt_buffer out;
+  stream_printf_to(out, format, args...);
+  return out.str();
+}
+
+// helper for level text alignment
+inline int get_max_level_text_width() {
+  static int cached_width = []() {
+    int max_width = 0;
+    for (int i = 0; i <= static_cast<int>(level::annoying); ++i) {
+      int width = static_cast<int>(level_short_name(static_cast<level>(i)).length());
+      max_width = std::max(max_width, width);
+    }
+    return max_width + 2; // +2 for brackets []
+  }();
+  return cached_width;
+}
 
 /**
- * Formatter interface for customizable output.
+ * Escape sequences and level labels resolved once from a theme; shared by
+ * every default_formatter drawing with that theme.
  */
-class formatter {
+class theme_styles {
 public:
-  virtual ~formatter() = default;
-  virtual std::string format(const log_entry& entry) const = 0;
-};
+  // bracketed, padded level label and its escape sequence
+  struct level_style {
+    ansi_style style;
+    char label[32] = {};
+    std::size_t label_length = 0;
+  };
+
+  // one slot per level plus a trailing slot for out-of-range values
+  static constexpr std::size_t level_slots = static_cast<std::size_t>(level::annoying) + 2;
+
+  explicit theme_styles(const theme& t) : theme_(t) {
+    const bool enabled = should_use_color();
+    source_ = ansi_style(theme_.source_color, theme_.source_bg_color, enabled);
+    message_ = ansi_style(theme_.message_color, color::none, enabled);
+    field_key_ = ansi_style(theme_.field_key_color, color::none, enabled);
+    field_value_ = ansi_style(theme_.field_value_color, color::none, enabled);
+    colored_ = enabled;
+
+    const int label_capacity = static_cast<int>(sizeof(level_style::label));
+    const int target_width = theme_.pad_level_text ? std::min(get_max_level_text_width(), label_capacity) : 0;
+    for (std::size_t i = 0; i < level_slots; ++i) {
+      level lvl = static_cast<level>(i);
+      level_style& slot = levels_[i];
+      slot.style = ansi_style(level_color(lvl), level_bg_color(lvl), enabled);
+
+      std::string_view level_text = level_short_name(lvl);
+      slot.label[slot.label_length++] = '[';
+      level_text.copy(slot.label + slot.label_length, level_text.size());
+      slot.label_length += level_text.size();
+      slot.label[slot.label_length++] = ']';
+      while (static_cast<int>(slot.label_length) < target_width) {
+        slot.label[slot.label_length++] = ' ';
+      }
+    }
+  }
 
-/**
- * Default formatter producing beautiful aligned output.
- *
- * Format: [source]      [lvl] message                    key=value key=value
- */
-class default_formatter : public formatter {
+  const theme& values() const noexcept { return theme_; }
+  const ansi_style& source() const noexcept { return source_; }
+  const ansi_style& message() const noexcept { return message_; }
+  const ansi_style& field_key() const noexcept { return field_key_; }
+  const ansi_style& field_value() const noexcept { return field_value_; }
+  bool colored() const noexcept { return colored_; }
+
+  const level_style& level_for(level l) const noexcept {
+    auto idx = static_cast<std::size_t>(static_cast<int>(l));
+    return levels_[idx < level_slots - 1 ? idx : level_slots - 1];
+  }
+
+private:
   theme theme_;
+  std::array<level_style, level_slots> levels_;
+  ansi_style source_;
+  ansi_style message_;
+  ansi_style field_key_;
+  ansi_style field_value_;
+  bool colored_ = false;
 
   color level_color(level l) const {
     switch (l) {
@@ -767,287 +1369,6286 @@ class default_formatter : public formatter {
       return color::none;
     }
   }
+};
 
-public:
-  default_formatter() : theme_(detail::config::instance().get_theme()) {}
-  explicit default_formatter(const theme& t) : theme_(t) {}
-
-  std::string format(const log_entry& entry) const override {
-    std::ostringstream oss;
-
-    // source component with fixed width padding
-    if (!entry.source.empty()) {
-      std::string source_part = "[" + entry.source + "]";
-      oss << detail::colorize(source_part, theme_.source_color, theme_.source_bg_color);
-
-      int padding = theme_.source_width - static_cast<int>(source_part.length());
-      oss << std::string(std::max(1, padding), ' ');
-    }
-
-    // level component with optional padding
-    std::string level_text = std::string(level_short_name(entry.level_val));
-    std::string level_part = "[" + level_text + "]";
-
-    if (theme_.pad_level_text) {
-      int target_width = detail::get_max_level_text_width();
-      int padding = target_width - static_cast<int>(level_part.length());
-      if (padding > 0) {
-        level_part += std::string(padding, ' ');
-      }
-    }
-
-    oss << detail::colorize(level_part, level_color(entry.level_val), level_bg_color(entry.level_val)) << " ";
-
-    // message component with fixed width (logrus-style)
-    oss << std::left << std::setw(theme_.message_fixed_width)
-        << detail::colorize(entry.message, theme_.message_color, color::none) << std::right;
-
-    // fields component
-    if (!entry.fields.empty()) {
-      oss << " ";
+/**
+ * The global minimum level. Kept outside the settings snapshots so that
+ * set_level() is one store and leaves no snapshot behind; the min_level of a
+ * published snapshot is not read.
+ */
+inline std::atomic<level> global_level{level::info};
 
-      bool first = true;
-      for (const auto& f : entry.fields.fields()) {
-        if (!first) {
-          oss << " ";
+/**
+ * Immutable published configuration. Writers build a modified copy and swap
+ * it in; readers keep using whichever snapshot they loaded.
+ */
+struct config_snapshot {
+  settings values;
+  theme_styles styles;
+
+  explicit config_snapshot(settings s) : values(std::move(s)), styles(values.active_theme) {}
+
+  // entry for the closest name along a dotted path ("app.db.pool", "app.db", "app"), or null
+  template <typename Map>
+  static const typename Map::mapped_type* closest(const Map& overrides, std::string_view name) {
+    if (!overrides.empty()) {
+      for (;;) {
+        auto found = overrides.find(name);
+        if (found != overrides.end()) {
+          return &found->second;
         }
-        first = false;
-
-        oss << detail::colorize(f.key, theme_.field_key_color, color::none) << "="
-            << detail::colorize(f.value, theme_.field_value_color, color::none);
+        std::size_t dot = name.rfind('.');
+        if (dot == std::string_view::npos) {
+          break;
+        }
+        name = name.substr(0, dot);
       }
     }
+    return nullptr;
+  }
+
+  // level for a logger name: the closest override along its dotted path, else the global level
+  level resolve_level(std::string_view name) const {
+    const level* found = closest(values.level_overrides, name);
+    return found ? *found : global_level.load(std::memory_order_relaxed);
+  }
 
-    return oss.str();
+  // sink for a get_logger() logger name: the closest route, else output_sink; null for the shared console
+  sink* resolve_sink(std::string_view name) const {
+    const std::shared_ptr<sink>* found = closest(values.sink_routes, name);
+    return found ? found->get() : values.output_sink.get();
   }
 };
 
 /**
- * Output sink interface.
+ * Bumped on every level change; loggers cache their resolved level together
+ * with the generation it was resolved in. Constant-initialized, so reading
+ * it needs no static-init guard.
  */
-class sink {
-public:
-  virtual ~sink() = default;
-  virtual void write(std::string_view formatted) = 0;
-  virtual void flush() = 0;
-};
+inline std::atomic<std::uint64_t> level_generation{1};
+
+// current snapshot; null only until config is first constructed
+inline std::atomic<const config_snapshot*> published_config{nullptr};
 
 /**
- * Console sink for stderr output.
+ * A reader's hazard pointer: the snapshot it may still be reading, which
+ * config::publish does not free. One slot per thread that reads the
+ * configuration; slots are reused after their thread exits, never freed.
  */
-class console_sink : public sink {
-public:
-  void write(std::string_view formatted) override {
-    std::fprintf(stderr, "%.*s\n", static_cast<int>(formatted.size()), formatted.data());
-  }
+struct config_hazard {
+  std::atomic<const config_snapshot*> pointer{nullptr};
+  std::atomic<bool> leased{false};
+  config_hazard* next = nullptr;
+};
+
+// every hazard slot ever created, newest first
+inline std::atomic<config_hazard*> config_hazards{nullptr};
 
-  void flush() override { std::fflush(stderr); }
+// this thread's slot and config_pin depth; constant-initialized, so reading it needs no TLS guard
+struct config_reader {
+  config_hazard* hazard = nullptr;
+  const config_snapshot* pinned = nullptr;
+  unsigned depth = 0;
+  bool exited = false;
 };
 
-/**
- * File sink for logging to a file.
- * Falls back to stderr if file cannot be opened.
- */
-class file_sink : public sink {
-  FILE* file_;
-  bool should_close_;
+inline thread_local config_reader this_config_reader;
+
+// hands the thread's slot back when it exits
+struct config_lease {
+  config_lease() = default;
+  config_lease(const config_lease&) = delete;
+  config_lease& operator=(const config_lease&) = delete;
+
+  ~config_lease() {
+    config_reader& reader = this_config_reader;
+    reader.exited = true;
+    if (reader.hazard && reader.depth == 0) {
+      reader.hazard->pointer.store(nullptr, std::memory_order_release);
+      reader.hazard->leased.store(false, std::memory_order_release);
+      reader.hazard = nullptr;
+    }
+  }
+};
 
-public:
-  explicit file_sink(const std::string& filename) : file_(nullptr), should_close_(false) {
-    file_ = std::fopen(filename.c_str(), "a");
-    should_close_ = (file_ != nullptr);
-    if (!file_) {
-      // fallback to stderr if file open fails
-      file_ = stderr;
-      should_close_ = false;
+inline config_hazard& config_reader_hazard() noexcept {
+  config_reader& reader = this_config_reader;
+  if (reader.hazard) {
+    return *reader.hazard;
+  }
+  for (config_hazard* slot = config_hazards.load(std::memory_order_acquire); slot; slot = slot->next) {
+    if (!slot->leased.load(std::memory_order_relaxed) && !slot->leased.exchange(true, std::memory_order_acquire)) {
+      reader.hazard = slot;
+      break;
+    }
+  }
+  if (!reader.hazard) {
+    auto* slot = new config_hazard;
+    slot->leased.store(true, std::memory_order_relaxed);
+    slot->next = config_hazards.load(std::memory_order_relaxed);
+    while (!config_hazards.compare_exchange_weak(slot->next, slot, std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
     }
+    reader.hazard = slot;
+  }
+  // a thread that logs from its own thread_local destructors keeps the slot it leases then
+  if (!reader.exited) {
+    static thread_local config_lease lease;
+    (void) lease;
   }
+  return *reader.hazard;
+}
 
-  ~file_sink() {
-    if (should_close_ && file_) {
-      std::fclose(file_);
+// whether some reader's hazard names snapshot
+inline bool config_in_use(const config_snapshot* snapshot) noexcept {
+  for (config_hazard* slot = config_hazards.load(std::memory_order_acquire); slot; slot = slot->next) {
+    if (slot->pointer.load(std::memory_order_seq_cst) == snapshot) {
+      return true;
     }
   }
+  return false;
+}
 
-  // non-copyable, moveable
-  file_sink(const file_sink&) = delete;
-  file_sink& operator=(const file_sink&) = delete;
-  file_sink(file_sink&&) = default;
-  file_sink& operator=(file_sink&&) = default;
+// the current snapshot, with the hazard set before it is checked to still be current; defined after config
+inline const config_snapshot* protect_config(config_hazard& hazard) noexcept;
+inline const config_snapshot& current_config() noexcept;
 
-  void write(std::string_view formatted) override {
-    if (file_) {
-      std::fprintf(file_, "%.*s\n", static_cast<int>(formatted.size()), formatted.data());
+/**
+ * Keeps the current snapshot alive on this thread while in scope, so
+ * current_config() may be used freely inside it. Pins nest; only the
+ * outermost one touches the hazard slot. Records pin once on their way in.
+ */
+class config_pin {
+public:
+  config_pin() noexcept {
+    config_reader& reader = this_config_reader;
+    if (reader.depth++ == 0) {
+      reader.pinned = protect_config(config_reader_hazard());
     }
   }
 
-  void flush() override {
-    if (file_) {
-      std::fflush(file_);
+  ~config_pin() {
+    config_reader& reader = this_config_reader;
+    if (--reader.depth == 0) {
+      reader.pinned = nullptr;
+      if (reader.hazard) {
+        reader.hazard->pointer.store(nullptr, std::memory_order_release);
+      }
     }
   }
+
+  config_pin(const config_pin&) = delete;
+  config_pin& operator=(const config_pin&) = delete;
 };
 
 /**
- * Main logger class with immutable design for natural thread safety.
+ * Global configuration.
  *
- * Loggers are immutable - methods like with_name() and with_field() return
- * new logger instances rather than modifying the original. This provides
- * clean scoping semantics and thread safety.
+ * Reads load the published snapshot under a per-thread hazard pointer (see
+ * config_pin). Updates copy the snapshot, apply the edit and publish the copy
+ * under a writer lock; the replaced one is freed, with the sinks and
+ * formatters it references, by the first publish that finds no reader still
+ * holding it. The global level lives in global_level rather than in a
+ * snapshot, so level toggles publish nothing.
  */
-class logger {
-  std::string name_;
-  field_set fields_;
-  std::shared_ptr<formatter> formatter_;
-  std::shared_ptr<sink> sink_;
+class config {
+  using snapshot_list = std::vector<std::unique_ptr<const config_snapshot>>;
+
+  std::mutex update_mutex_;
+  std::unique_ptr<const config_snapshot> current_;
+  snapshot_list retired_; // replaced, and still named by a reader's hazard when last checked
+
+  // swap next in and return the replaced snapshots no reader holds, to be freed once the lock is released
+  snapshot_list publish(settings next) {
+    auto published = std::make_unique<const config_snapshot>(std::move(next));
+    published_config.store(published.get(), std::memory_order_seq_cst);
+    if (current_) {
+      retired_.push_back(std::move(current_));
+    }
+    current_ = std::move(published);
+
+    // an unpinned read on this thread left its hazard behind; nothing here reads through it
+    config_reader& reader = this_config_reader;
+    if (reader.depth == 0 && reader.hazard) {
+      reader.hazard->pointer.store(nullptr, std::memory_order_seq_cst);
+    }
+
+    auto held = std::partition(retired_.begin(), retired_.end(),
+                               [](const auto& snapshot) { return config_in_use(snapshot.get()); });
+    snapshot_list unused(std::make_move_iterator(held), std::make_move_iterator(retired_.end()));
+    retired_.erase(held, retired_.end());
+    return unused;
+  }
+
+  config() {
+    publish(settings{});
+    global_level.store(current_->values.min_level, std::memory_order_relaxed);
+  }
 
 public:
-  /**
-   * Create a logger with the given name.
-   * Uses default console output and formatting.
-   */
-  explicit logger(std::string_view name = "")
-      : name_(name), formatter_(std::make_shared<default_formatter>()), sink_(std::make_shared<console_sink>()) {}
+  config(const config&) = delete;
+  config& operator=(const config&) = delete;
 
-  /**
-   * Create a logger with custom formatter and sink.
-   */
-  logger(std::string_view name, std::shared_ptr<formatter> fmt, std::shared_ptr<sink> sink_ptr)
-      : name_(name), formatter_(std::move(fmt)), sink_(std::move(sink_ptr)) {}
+  static config& instance() {
+    static config instance_;
+    return instance_;
+  }
 
-  /**
-   * Create a logger with custom formatter (uses default console sink).
-   */
-  logger(std::string_view name, std::shared_ptr<formatter> fmt)
-      : name_(name), formatter_(std::move(fmt)), sink_(std::make_shared<console_sink>()) {}
+  // the current settings, with the global level filled in
+  settings values() const {
+    config_pin pin;
+    settings current = current_config().values;
+    current.min_level = global_level.load(std::memory_order_relaxed);
+    return current;
+  }
 
-  /**
-   * Create a logger with custom sink (uses default formatter).
-   */
-  logger(std::string_view name, std::shared_ptr<sink> sink_ptr)
-      : name_(name), formatter_(std::make_shared<default_formatter>()), sink_(std::move(sink_ptr)) {}
+  // apply edit to a copy of the current settings and publish the result, if it differs in more than the level
+  template <typename Fn> void update(Fn&& edit) {
+    snapshot_list unused; // destroyed after the lock, in case a freed sink's destructor logs
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    settings next = values();
+    std::forward<Fn>(edit)(next);
+    global_level.store(next.min_level, std::memory_order_relaxed);
+    next.min_level = current_->values.min_level;
+    if (!(next == current_->values)) {
+      unused = publish(std::move(next));
+    }
+    level_generation.fetch_add(1, std::memory_order_release);
+  }
 
-  /**
-   * Create a scoped logger with additional name component.
-   *
-   * Example: logger("app").with_name("db") creates logger named "app.db"
-   */
-  logger with_name(std::string_view name) const {
-    logger result = *this;
-    if (result.name_.empty()) {
-      result.name_ = name;
-    } else {
-      result.name_ += "." + std::string(name);
+  level min_level() const noexcept { return global_level.load(std::memory_order_relaxed); }
+
+  void set_level(level l) {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    global_level.store(l, std::memory_order_relaxed);
+    level_generation.fetch_add(1, std::memory_order_release);
+  }
+
+  // override the level for a logger name and everything below it ("app.db" covers "app.db.pool")
+  void set_level(std::string_view name, level l) {
+    update([name, l](settings& s) { s.level_overrides.insert_or_assign(std::string(name), l); });
+  }
+
+  void clear_level(std::string_view name) {
+    update([name](settings& s) {
+      auto found = s.level_overrides.find(name);
+      if (found != s.level_overrides.end()) {
+        s.level_overrides.erase(found);
+      }
+    });
+  }
+
+  level resolve_level(std::string_view name) const {
+    config_pin pin;
+    return current_config().resolve_level(name);
+  }
+
+  theme get_theme() const {
+    config_pin pin;
+    return current_config().values.active_theme;
+  }
+
+  void set_theme(const theme& t) {
+    update([&t](settings& s) { s.active_theme = t; });
+  }
+};
+
+inline const config_snapshot* protect_config(config_hazard& hazard) noexcept {
+  const config_snapshot* current = published_config.load(std::memory_order_acquire);
+  if (!current) {
+    config::instance();
+    current = published_config.load(std::memory_order_acquire);
+  }
+  for (;;) {
+    hazard.pointer.store(current, std::memory_order_seq_cst);
+    const config_snapshot* again = published_config.load(std::memory_order_seq_cst);
+    if (again == current) {
+      return current;
+    }
+    current = again;
+  }
+}
+
+/**
+ * The published snapshot. Inside a config_pin this is the pinned one;
+ * outside, the hazard is left set, so the reference stays valid until this
+ * thread's next read or pin.
+ */
+inline const config_snapshot& current_config() noexcept {
+  const config_reader& reader = this_config_reader;
+  return reader.pinned ? *reader.pinned : *protect_config(config_reader_hazard());
+}
+
+// nanoseconds since the epoch
+inline std::int64_t to_nanoseconds(std::chrono::system_clock::time_point time) noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+inline std::chrono::system_clock::time_point from_nanoseconds(std::int64_t nanoseconds) noexcept {
+  return std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(nanoseconds))
+  );
+}
+
+inline std::chrono::system_clock::time_point coarse_now() noexcept {
+#if defined(CLOCK_REALTIME_COARSE)
+  timespec now{};
+  if (clock_gettime(CLOCK_REALTIME_COARSE, &now) == 0) {
+    return from_nanoseconds(static_cast<std::int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec);
+  }
+#endif
+  return std::chrono::system_clock::now();
+}
+
+/**
+ * Wall time from the cpu timestamp counter.
+ *
+ * Each reading is base_ns + (ticks - base_ticks) * ns_per_tick. The base is
+ * re-anchored to the system clock about once a second by whichever thread
+ * notices first; until two anchors exist, the system clock is used directly.
+ * The anchor is published through a sequence lock so readers never block.
+ * Assumes an invariant TSC, as on current x86 processors.
+ */
+class tsc_clock {
+  static constexpr std::int64_t calibration_period = 1000000000; // ns between calibrations
+
+  std::atomic<std::uint32_t> sequence_{0};
+  std::atomic<std::uint64_t> base_ticks_{0};
+  std::atomic<std::int64_t> base_ns_{0};
+  std::atomic<double> ns_per_tick_{0.0};
+  std::atomic<std::uint64_t> next_calibration_{0}; // tick count at which to recalibrate
+  std::atomic<bool> calibrating_{false};
+
+  static std::uint64_t ticks() noexcept {
+#ifdef REDLOG_HAS_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  void calibrate() noexcept {
+    if (calibrating_.exchange(true, std::memory_order_acquire)) {
+      return; // another thread is on it
+    }
+    std::uint64_t now_ticks = ticks();
+    std::int64_t now_ns = to_nanoseconds(std::chrono::system_clock::now());
+    std::uint64_t previous_ticks = base_ticks_.load(std::memory_order_relaxed);
+    std::int64_t previous_ns = base_ns_.load(std::memory_order_relaxed);
+
+    double rate = ns_per_tick_.load(std::memory_order_relaxed);
+    if (previous_ticks != 0 && now_ticks > previous_ticks && now_ns > previous_ns) {
+      rate = static_cast<double>(now_ns - previous_ns) / static_cast<double>(now_ticks - previous_ticks);
+    }
+
+    std::uint32_t seq = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    base_ticks_.store(now_ticks, std::memory_order_relaxed);
+    base_ns_.store(now_ns, std::memory_order_relaxed);
+    ns_per_tick_.store(rate, std::memory_order_relaxed);
+    sequence_.store(seq + 2, std::memory_order_release);
+
+    // first anchor: take the second one soon to learn the rate
+    std::int64_t period = rate > 0.0 ? calibration_period : calibration_period / 100;
+    double ticks_per_ns = rate > 0.0 ? 1.0 / rate : 1.0;
+    next_calibration_.store(now_ticks + static_cast<std::uint64_t>(period * ticks_per_ns), std::memory_order_relaxed);
+    calibrating_.store(false, std::memory_order_release);
+  }
+
+public:
+  static tsc_clock& instance() {
+    static tsc_clock clock;
+    return clock;
+  }
+
+  static constexpr bool available() noexcept {
+#ifdef REDLOG_HAS_TSC
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  std::chrono::system_clock::time_point now() noexcept {
+    if (!available()) {
+      return std::chrono::system_clock::now();
+    }
+
+    std::uint64_t now_ticks = ticks();
+    if (now_ticks >= next_calibration_.load(std::memory_order_relaxed)) {
+      calibrate();
+    }
+
+    for (;;) {
+      std::uint32_t seq = sequence_.load(std::memory_order_acquire);
+      if (seq & 1) {
+        continue;
+      }
+      std::uint64_t base_ticks = base_ticks_.load(std::memory_order_relaxed);
+      std::int64_t base_ns = base_ns_.load(std::memory_order_relaxed);
+      double rate = ns_per_tick_.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) != seq) {
+        continue;
+      }
+
+      if (rate <= 0.0) {
+        return std::chrono::system_clock::now();
+      }
+      // another core may be a few ticks behind the anchor
+      double offset = now_ticks >= base_ticks ? static_cast<double>(now_ticks - base_ticks) * rate
+                                              : -static_cast<double>(base_ticks - now_ticks) * rate;
+      return from_nanoseconds(base_ns + static_cast<std::int64_t>(offset));
+    }
+  }
+};
+
+// record timestamp from the configured clock source
+inline std::chrono::system_clock::time_point clock_now() noexcept {
+  config_pin pin;
+  switch (current_config().values.clock) {
+  case clock_source::coarse:
+    return coarse_now();
+  case clock_source::tsc:
+    return tsc_clock::instance().now();
+  case clock_source::none:
+    return {};
+  case clock_source::system:
+  default:
+    return std::chrono::system_clock::now();
+  }
+}
+
+/**
+ * Process-wide table of interned strings: logger names, literal field keys
+ * and keys passed through intern_key().
+ *
+ * Each distinct string is stored once and never freed, so the views handed
+ * out stay valid for the life of the process and can be copied freely.
+ * Meant for the bounded set of names and keys a program uses, not for
+ * arbitrary data.
+ */
+class intern_table {
+  mutable std::mutex mutex_;
+  std::deque<std::string> strings_; // deque: elements never move
+  std::unordered_set<std::string_view> index_;
+
+public:
+  static intern_table& instance() {
+    static intern_table table;
+    return table;
+  }
+
+  std::string_view intern(std::string_view text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(text);
+    if (found != index_.end()) {
+      return *found;
     }
+    std::string_view stored = strings_.emplace_back(text);
+    index_.insert(stored);
+    return stored;
+  }
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return strings_.size();
+  }
+};
+
+/**
+ * Interned copy of text. A small per-thread cache, keyed by the caller's
+ * pointer and checked against the contents, answers repeated keys from
+ * literals without touching the shared table.
+ */
+inline std::string_view intern(std::string_view text) {
+  if (text.empty()) {
+    return {};
+  }
+
+  struct cache_entry {
+    const char* source = nullptr;
+    std::string_view interned;
+  };
+  static constexpr std::size_t cache_size = 64;
+  thread_local std::array<cache_entry, cache_size> cache;
+
+  auto address = reinterpret_cast<std::uintptr_t>(text.data());
+  cache_entry& entry = cache[((address >> 3) ^ text.size()) % cache_size];
+  if (entry.source == text.data() && entry.interned == text) {
+    return entry.interned;
+  }
+
+  entry.source = text.data();
+  entry.interned = intern_table::instance().intern(text);
+  return entry.interned;
+}
+
+} // namespace detail
+
+/**
+ * A field key that lives in the intern table; see intern_key().
+ */
+struct interned_key {
+  std::string_view text;
+};
+
+/**
+ * Intern a key built at run time so fields with it copy as a view.
+ *
+ * String literal keys are interned automatically; other keys are stored in
+ * each field. Use this only for keys from a small fixed set (e.g. read from
+ * configuration): interned strings are never freed.
+ */
+inline interned_key intern_key(std::string_view k) { return {detail::intern(k)}; }
+
+template <typename Fn> class lazy_field;
+
+/**
+ * Opt-in for keeping field values of type T inline instead of rendering them
+ * when the field is built: specialize as std::true_type for a small,
+ * trivially copyable type with operator<<. The value is copied bit for bit
+ * and streamed when a record is formatted, which may be later and on another
+ * thread (async sinks, logger context fields), so only types that own
+ * everything operator<< reads qualify; nothing that points at other data.
+ * Enums are in by default.
+ */
+template <typename T> struct inline_field_value : std::is_enum<T> {};
+
+/**
+ * Typed value of a structured field.
+ *
+ * Integers, floating point values and booleans stay numbers and are rendered
+ * straight into the output buffer; text is owned, or viewed when built with
+ * ref(). Enums and types opted in with inline_field_value are copied inline
+ * and only streamed when a record is formatted; anything else is rendered to
+ * text up front. The text form is exactly what stringify produces.
+ */
+class field_value {
+public:
+  enum class kind : std::uint8_t { string, view, int64, uint64, float64, boolean, custom };
+
+  // a small value of some other type and the function that renders it
+  struct custom_value {
+    void (*render)(detail::fmt_buffer& out, const void* object) = nullptr;
+    alignas(8) unsigned char object[16] = {};
+  };
+
+  field_value() = default;
+
+  template <typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, field_value>>>
+  field_value(T&& value) : data_(make(std::forward<T>(value))) {}
+
+  // text that is not copied; it must outlive every use of the value
+  static field_value ref(std::string_view text) {
+    field_value result;
+    result.data_.emplace<std::string_view>(text);
     return result;
   }
 
+  kind type() const noexcept { return static_cast<kind>(data_.index()); }
+  bool is_text() const noexcept { return type() == kind::string || type() == kind::view; }
+
+  // typed accessors; each is only meaningful for its kind
+  std::string_view text() const noexcept {
+    if (auto owned = std::get_if<std::string>(&data_)) {
+      return *owned;
+    }
+    auto viewed = std::get_if<std::string_view>(&data_);
+    return viewed ? *viewed : std::string_view();
+  }
+  std::int64_t as_int64() const noexcept { return type() == kind::int64 ? std::get<std::int64_t>(data_) : 0; }
+  std::uint64_t as_uint64() const noexcept { return type() == kind::uint64 ? std::get<std::uint64_t>(data_) : 0; }
+  double as_double() const noexcept { return type() == kind::float64 ? std::get<double>(data_) : 0.0; }
+  bool as_bool() const noexcept { return type() == kind::boolean && std::get<bool>(data_); }
+
+  // append the text form
+  void format_to(detail::fmt_buffer& out) const {
+    switch (type()) {
+    case kind::string:
+    case kind::view:
+      out.append(text());
+      break;
+    case kind::int64:
+      detail::write_integer(out, std::get<std::int64_t>(data_));
+      break;
+    case kind::uint64:
+      detail::write_integer(out, std::get<std::uint64_t>(data_));
+      break;
+    case kind::float64:
+      detail::write_float(out, std::get<double>(data_), std::chars_format::fixed, 6);
+      break;
+    case kind::boolean:
+      out.push_back(std::get<bool>(data_) ? '1' : '0');
+      break;
+    case kind::custom: {
+      const custom_value& custom = std::get<custom_value>(data_);
+      custom.render(out, custom.object);
+      break;
+    }
+    }
+  }
+
+  std::string str() const {
+    if (is_text()) {
+      return std::string(text());
+    }
+    detail::fmt_buffer out;
+    format_to(out);
+    return out.str();
+  }
+
+  // compares the text form
+  friend bool operator==(const field_value& value, std::string_view text) {
+    if (value.is_text()) {
+      return value.text() == text;
+    }
+    detail::fmt_buffer rendered;
+    value.format_to(rendered);
+    return rendered.view() == text;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, const field_value& value) {
+    detail::fmt_buffer rendered;
+    value.format_to(rendered);
+    return os << rendered.view();
+  }
+
+private:
+  using storage = std::variant<std::string, std::string_view, std::int64_t, std::uint64_t, double, bool, custom_value>;
+  storage data_;
+
+  template <typename T>
+  static constexpr bool is_inline_custom_v = inline_field_value<T>::value && std::is_trivially_copyable_v<T> &&
+                                             sizeof(T) <= sizeof(custom_value::object) && alignof(T) <= 8 &&
+                                             detail::has_ostream_operator<T>::value;
+
+  template <typename T> static void render_custom(detail::fmt_buffer& out, const void* object) {
+    detail::stringify_to(out, *std::launder(static_cast<const T*>(object)));
+  }
+
+  template <typename T> static storage make(T&& value) {
+    using decay_t = std::decay_t<T>;
+
+    if constexpr (std::is_same_v<decay_t, std::string>) {
+      return storage(std::in_place_index<0>, std::forward<T>(value));
+    } else if constexpr (std::is_same_v<decay_t, const char*> || std::is_same_v<decay_t, char*>) {
+      const char* text = value;
+      return storage(std::in_place_index<0>, text ? text : "null");
+    } else if constexpr (std::is_convertible_v<const decay_t&, std::string_view>) {
+      return storage(std::in_place_index<0>, std::string_view(value));
+    } else if constexpr (std::is_same_v<decay_t, bool>) {
+      return storage(std::in_place_index<5>, value);
+    } else if constexpr (std::is_same_v<decay_t, float> || std::is_same_v<decay_t, double>) {
+      return storage(std::in_place_index<4>, static_cast<double>(value));
+    } else if constexpr (std::is_integral_v<decay_t> && std::is_signed_v<decay_t>) {
+      return storage(std::in_place_index<2>, static_cast<std::int64_t>(value));
+    } else if constexpr (std::is_integral_v<decay_t>) {
+      return storage(std::in_place_index<3>, static_cast<std::uint64_t>(value));
+    } else if constexpr (is_inline_custom_v<decay_t>) {
+      custom_value custom;
+      custom.render = &render_custom<decay_t>;
+      ::new (static_cast<void*>(custom.object)) decay_t(value);
+      return storage(std::in_place_index<6>, custom);
+    } else {
+      return storage(std::in_place_index<0>, detail::stringify(std::forward<T>(value)));
+    }
+  }
+};
+
+/**
+ * Simple structured field for key-value logging.
+ *
+ * String literal keys, and keys from intern_key(), are interned, so fields
+ * with them copy as cheaply as a view. Any other key is copied into storage
+ * the field shares with its copies, so keys built from data cost memory only
+ * while fields use them. The value keeps its type (see field_value). Values
+ * that are expensive to produce can be wrapped with field::lazy and are only
+ * computed for records that pass the level check.
+ *
+ * A field owns its value once built (see inline_field_value for what is
+ * kept unrendered), except text viewed with ref(), which must outlive every
+ * logger and record using the field, including records still queued in an
+ * async sink.
+ */
+struct field {
+private:
+  std::shared_ptr<const std::string> owned_key_; // storage for keys that are not interned
+
+  static std::shared_ptr<const std::string> own(std::string_view k) {
+    return k.empty() ? nullptr : std::make_shared<const std::string>(k);
+  }
+
+public:
+  std::string_view key;
+  field_value value;
+
+  template <typename T> field(interned_key k, T&& v) : key(k.text), value(std::forward<T>(v)) {}
+
+  template <std::size_t N, typename T>
+  field(const char (&k)[N], T&& v) : field(intern_key(k), std::forward<T>(v)) {}
+
+  // a writable array holds run-time text, not a literal
+  template <std::size_t N, typename T>
+  field(char (&k)[N], T&& v) : field(std::string_view(k), std::forward<T>(v)) {}
+
+  template <typename T>
+  field(std::string_view k, T&& v)
+      : owned_key_(own(k)), key(owned_key_ ? std::string_view(*owned_key_) : std::string_view()),
+        value(std::forward<T>(v)) {}
+
+  template <typename K, typename T>
+  field(K&& k, const char* format_spec, T&& v)
+      : field(std::forward<K>(k), detail::stream_printf(format_spec, std::forward<T>(v))) {}
+
+  /**
+   * Field whose value is computed by calling fn, once and only if the record
+   * is written. Pass it directly to a log call; the key and anything fn
+   * captures must outlive that call.
+   *
+   * Example: log.debug("state", field::lazy("dump", [&] { return dump(); }));
+   */
+  template <typename Fn> static lazy_field<std::decay_t<Fn>> lazy(std::string_view k, Fn&& fn) {
+    return lazy_field<std::decay_t<Fn>>(k, false, std::forward<Fn>(fn));
+  }
+
+  template <std::size_t N, typename Fn> static lazy_field<std::decay_t<Fn>> lazy(const char (&k)[N], Fn&& fn) {
+    return lazy_field<std::decay_t<Fn>>(intern_key(k).text, true, std::forward<Fn>(fn));
+  }
+
   /**
-   * Create a logger with additional field.
-   * Field values are converted to strings using the universal stringify function.
+   * Field that views text instead of copying it (see field_value::ref). The
+   * text must outlive every logger and record holding the field; meant for
+   * constants and values that live as long as the logger using them.
+   *
+   * Example: log.with_fields(field::ref("region", config.region))
    */
-  template <typename T> logger with_field(std::string_view key, T&& value) const {
-    logger result = *this;
-    result.fields_.add(field(key, std::forward<T>(value)));
+  template <typename K> static field ref(K&& k, std::string_view text) {
+    return field(std::forward<K>(k), field_value::ref(text));
+  }
+};
+
+/**
+ * Deferred field produced by field::lazy; turns into a field when logged.
+ */
+template <typename Fn> class lazy_field {
+  std::string_view key_;
+  bool interned_;
+  Fn fn_;
+
+public:
+  lazy_field(std::string_view k, bool interned, Fn fn) : key_(k), interned_(interned), fn_(std::move(fn)) {}
+
+  operator field() const { return interned_ ? field(interned_key{key_}, fn_()) : field(key_, fn_()); }
+};
+
+/**
+ * Collection of fields with simple operations.
+ *
+ * Optimized for the common case of small numbers of fields.
+ */
+class field_set {
+  std::vector<field> fields_;
+
+public:
+  field_set() = default;
+  field_set(std::initializer_list<field> fields) : fields_(fields) {}
+
+  void add(field f) { fields_.emplace_back(std::move(f)); }
+
+  void merge(const field_set& other) { fields_.insert(fields_.end(), other.fields_.begin(), other.fields_.end()); }
+
+  // immutable operations for clean chaining
+  field_set with_field(field f) const {
+    field_set result = *this;
+    result.add(std::move(f));
     return result;
   }
 
-  /**
-   * Create a logger with additional fields.
-   */
-  logger with_fields(const field_set& new_fields) const {
-    logger result = *this;
-    result.fields_.merge(new_fields);
-    return result;
+  field_set with_fields(const field_set& other) const {
+    field_set result = *this;
+    result.merge(other);
+    return result;
+  }
+
+  const std::vector<field>& fields() const { return fields_; }
+  bool empty() const { return fields_.empty(); }
+  std::size_t size() const { return fields_.size(); }
+};
+
+namespace detail {
+
+// one field as default_formatter writes it: key=value, styled when colored
+inline void append_field(fmt_buffer& out, const theme_styles& look, const field& f, bool colored) {
+  if (!colored) {
+    out.append(f.key);
+    out.push_back('=');
+    f.value.format_to(out);
+    return;
+  }
+  look.field_key().wrap(out, f.key);
+  out.push_back('=');
+  out.append(look.field_value().open());
+  f.value.format_to(out);
+  out.append(look.field_value().close());
+}
+
+} // namespace detail
+
+/**
+ * Fields rendered once into the text default_formatter writes for them.
+ *
+ * Meant for context that many records repeat, such as a connection's peer
+ * and id: a logger made with logger::with_fields(rendered) copies the text
+ * into each line instead of formatting the fields again. Both the plain and
+ * the colored text are kept; the colored one is used while the formatter's
+ * field styles match the theme it was rendered with, and other formatters
+ * see the fields as usual. Copies share the rendered text.
+ */
+class rendered_fields {
+  struct state {
+    field_set fields;
+    std::string plain;
+    std::string colored;
+    // field styles the colored text was rendered with
+    std::string key_open;
+    std::string key_close;
+    std::string value_open;
+    std::string value_close;
+  };
+  std::shared_ptr<const state> state_;
+
+  static std::shared_ptr<const state> render(field_set fields, const detail::theme_styles& look) {
+    auto rendered = std::make_shared<state>();
+    detail::fmt_buffer plain;
+    detail::fmt_buffer colored;
+    bool first = true;
+    for (const field& f : fields.fields()) {
+      if (!first) {
+        plain.push_back(' ');
+        colored.push_back(' ');
+      }
+      first = false;
+      detail::append_field(plain, look, f, false);
+      detail::append_field(colored, look, f, true);
+    }
+    rendered->fields = std::move(fields);
+    rendered->plain = plain.str();
+    rendered->colored = colored.str();
+    rendered->key_open = std::string(look.field_key().open());
+    rendered->key_close = std::string(look.field_key().close());
+    rendered->value_open = std::string(look.field_value().open());
+    rendered->value_close = std::string(look.field_value().close());
+    return rendered;
+  }
+
+  static std::shared_ptr<const state> render_current(field_set fields) {
+    detail::config_pin pin;
+    return render(std::move(fields), detail::current_config().styles);
+  }
+
+public:
+  // rendered with the current theme
+  explicit rendered_fields(field_set fields) : state_(render_current(std::move(fields))) {}
+  rendered_fields(std::initializer_list<field> fields) : rendered_fields(field_set(fields)) {}
+  rendered_fields(field_set fields, const theme& t) : state_(render(std::move(fields), detail::theme_styles(t))) {}
+
+  const field_set& fields() const noexcept { return state_->fields; }
+  bool empty() const noexcept { return state_->fields.empty(); }
+  std::size_t size() const noexcept { return state_->fields.size(); }
+
+  // the text for a formatter using look, or null when it was rendered with other field styles
+  const std::string* text_for(const detail::theme_styles& look) const noexcept {
+    const state& rendered = *state_;
+    if (!look.colored()) {
+      return &rendered.plain;
+    }
+    if (look.field_key().open() != rendered.key_open || look.field_key().close() != rendered.key_close ||
+        look.field_value().open() != rendered.value_open || look.field_value().close() != rendered.value_close) {
+      return nullptr;
+    }
+    return &rendered.colored;
+  }
+};
+
+/**
+ * Read-only view over the fields of one record, without copying them.
+ *
+ * A record's fields live in a few places (the logger context, the call
+ * site); the view chains up to max_segments contiguous runs and iterates
+ * them in order.
+ */
+class field_view {
+public:
+  static constexpr std::size_t max_segments = 8;
+
+private:
+  std::array<std::span<const field>, max_segments> segments_{};
+  std::size_t segment_count_ = 0;
+  std::size_t size_ = 0;
+  const rendered_fields* rendered_ = nullptr;
+
+public:
+  class iterator {
+    const field_view* view_ = nullptr;
+    std::size_t segment_ = 0;
+    std::size_t index_ = 0;
+
+    void skip_empty() {
+      while (segment_ < view_->segment_count_ && index_ >= view_->segments_[segment_].size()) {
+        segment_++;
+        index_ = 0;
+      }
+    }
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = field;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const field*;
+    using reference = const field&;
+
+    iterator() = default;
+    iterator(const field_view* view, std::size_t segment) : view_(view), segment_(segment) { skip_empty(); }
+
+    reference operator*() const { return view_->segments_[segment_][index_]; }
+    pointer operator->() const { return &**this; }
+
+    iterator& operator++() {
+      index_++;
+      skip_empty();
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+
+    bool operator==(const iterator& other) const { return segment_ == other.segment_ && index_ == other.index_; }
+    bool operator!=(const iterator& other) const { return !(*this == other); }
+  };
+
+  field_view() = default;
+  field_view(const field_set& fields) { append(fields.fields()); }
+  field_view(std::span<const field> context, std::span<const field> local) {
+    append(context);
+    append(local);
+  }
+
+  // add a run of fields after the existing ones; returns false if the view is full
+  bool append(std::span<const field> fields) {
+    if (fields.empty()) {
+      return true;
+    }
+    if (segment_count_ == max_segments) {
+      return false;
+    }
+    segments_[segment_count_++] = fields;
+    size_ += fields.size();
+    return true;
+  }
+
+  iterator begin() const { return iterator(this, 0); }
+  iterator end() const { return iterator(this, segment_count_); }
+
+  /**
+   * Text for the first rendered()->size() fields of the view, rendered ahead
+   * of time; null when there is none. Set by the logger context, which owns it.
+   */
+  const rendered_fields* rendered() const noexcept { return rendered_; }
+  void set_rendered(const rendered_fields* prefix) noexcept { rendered_ = prefix; }
+
+  // for symmetry with field_set: entry.fields.fields()
+  const field_view& fields() const { return *this; }
+  bool empty() const { return size_ == 0; }
+  std::size_t size() const { return size_; }
+};
+
+namespace detail {
+
+/**
+ * Immutable naming and field context shared by a logger, the loggers derived
+ * from it, and records that have not been written yet.
+ *
+ * Contexts form a persistent chain: a derived logger adds one node holding
+ * only its own fields and points at its parent, so deriving costs the same
+ * no matter how many fields are inherited. Records view the chain's field
+ * runs in place; chains deeper than a field_view can hold are flattened.
+ */
+struct logger_context {
+  // runs a context may occupy, leaving one field_view segment for call-site fields
+  static constexpr std::size_t max_segments = field_view::max_segments - 1;
+
+  std::shared_ptr<const logger_context> parent;
+  std::string_view name;    // interned
+  field_set fields;         // fields added at this level only
+  std::size_t segments = 0; // non-empty field runs in the chain
+  // text for the first fields of the chain, when they were added pre-rendered
+  std::optional<rendered_fields> prefix;
+
+  // resolved level in the low byte, level_generation it belongs to above it
+  mutable std::atomic<std::uint64_t> level_cache{0};
+
+  logger_context(
+      std::shared_ptr<const logger_context> parent_context, std::string_view context_name, field_set local,
+      std::size_t segment_count, std::optional<rendered_fields> rendered_prefix = std::nullopt
+  )
+      : parent(std::move(parent_context)), name(intern(context_name)), fields(std::move(local)),
+        segments(segment_count), prefix(std::move(rendered_prefix)) {}
+
+  static std::shared_ptr<const logger_context> root(std::string_view name) {
+    return std::make_shared<const logger_context>(nullptr, name, field_set{}, 0);
+  }
+
+  // effective minimum level for this name; one relaxed load and compare unless levels changed
+  level threshold() const {
+    std::uint64_t generation = level_generation.load(std::memory_order_relaxed);
+    std::uint64_t cached = level_cache.load(std::memory_order_relaxed);
+    if ((cached >> 8) == generation) {
+      return static_cast<level>(cached & 0xff);
+    }
+
+    // pairs with the release bump in config::update and set_level, which follows the publish, so the
+    // snapshot read is at least this generation's
+    std::atomic_thread_fence(std::memory_order_acquire);
+    config_pin pin;
+    level resolved = current_config().resolve_level(name);
+    level_cache.store((generation << 8) | static_cast<std::uint8_t>(resolved), std::memory_order_relaxed);
+    return resolved;
+  }
+
+  // new context below base with a name and additional fields
+  static std::shared_ptr<const logger_context>
+  extend(const std::shared_ptr<const logger_context>& base, std::string_view name, field_set local) {
+    // nodes without fields of their own are never kept as parents
+    std::shared_ptr<const logger_context> parent = base->fields.empty() ? base->parent : base;
+    std::size_t segments = (parent ? parent->segments : 0) + (local.empty() ? 0 : 1);
+
+    // the chain's first fields stay first, so a rendered prefix carries over to derived contexts
+    std::optional<rendered_fields> prefix = parent ? parent->prefix : std::nullopt;
+
+    if (segments > max_segments) {
+      field_set flat;
+      for (const field& f : parent->view()) {
+        flat.add(f);
+      }
+      flat.merge(local);
+      return std::make_shared<const logger_context>(nullptr, name, std::move(flat), 1, std::move(prefix));
+    }
+
+    return std::make_shared<const logger_context>(
+        std::move(parent), name, std::move(local), segments, std::move(prefix)
+    );
+  }
+
+  // new context below base with pre-rendered fields; inherited fields are rendered along with them
+  static std::shared_ptr<const logger_context>
+  extend(const std::shared_ptr<const logger_context>& base, std::string_view name, const rendered_fields& local) {
+    if (local.empty()) {
+      return extend(base, name, field_set{});
+    }
+
+    field_view inherited = base->view();
+    if (inherited.empty()) {
+      return std::make_shared<const logger_context>(nullptr, name, local.fields(), 1, local);
+    }
+
+    field_set all;
+    for (const field& f : inherited) {
+      all.add(f);
+    }
+    all.merge(local.fields());
+    rendered_fields combined(std::move(all));
+    return std::make_shared<const logger_context>(nullptr, name, combined.fields(), 1, std::move(combined));
+  }
+
+  // all fields of the chain, oldest first, followed by the given call-site fields
+  field_view view(std::span<const field> local = {}) const {
+    field_view result;
+    if (prefix) {
+      result.set_rendered(&*prefix);
+    }
+    append_to(result);
+    result.append(local);
+    return result;
+  }
+
+private:
+  void append_to(field_view& result) const {
+    if (parent) {
+      parent->append_to(result);
+    }
+    result.append(fields.fields());
+  }
+};
+
+} // namespace detail
+
+/**
+ * A logging call site: file, line and enclosing function.
+ *
+ * The REDLOG_<LEVEL> macros build one per call site as a static constexpr
+ * object, so the path is trimmed during compilation and records only copy a
+ * pointer to it. The address is stable for the life of the program.
+ */
+struct source_site {
+  std::string_view file;
+  std::uint32_t line = 0;
+  std::string_view function;
+};
+
+namespace detail {
+
+/**
+ * The part of a __FILE__ path that records show: relative to
+ * REDLOG_SOURCE_ROOT when the build defines it (as a string ending in a
+ * separator) and the path lies below it, otherwise the file name alone.
+ */
+constexpr std::string_view source_path(std::string_view path) noexcept {
+#ifdef REDLOG_SOURCE_ROOT
+  constexpr std::string_view root = REDLOG_SOURCE_ROOT;
+  if (!root.empty() && path.substr(0, root.size()) == root) {
+    return path.substr(root.size());
+  }
+#endif
+  std::size_t separator = path.find_last_of("/\\");
+  return separator == std::string_view::npos ? path : path.substr(separator + 1);
+}
+
+} // namespace detail
+
+/**
+ * Log entry representing a single log message with metadata.
+ *
+ * The entry only views its message, source and fields; whoever creates it
+ * keeps them alive while it is formatted. The owning constructor is for
+ * building entries by hand and keeps private copies instead.
+ */
+struct log_entry {
+  level level_val;
+  std::string_view message;
+  std::string_view source;
+  field_view fields;
+  std::chrono::system_clock::time_point timestamp;
+  const source_site* where = nullptr; // set for levels in settings::source_levels
+
+  log_entry(
+      level l, std::string_view msg, std::string_view src, field_view f,
+      std::chrono::system_clock::time_point ts = detail::clock_now()
+  )
+      : level_val(l), message(msg), source(src), fields(f), timestamp(ts) {}
+
+  log_entry(level l, std::string msg, std::string src, field_set f)
+      : level_val(l), timestamp(detail::clock_now()),
+        storage_(std::make_unique<storage>(storage{std::move(msg), std::move(src), std::move(f)})) {
+    message = storage_->message;
+    source = storage_->source;
+    fields = field_view(storage_->fields);
+  }
+
+  log_entry(const log_entry&) = delete;
+  log_entry& operator=(const log_entry&) = delete;
+  log_entry(log_entry&&) = default;
+  log_entry& operator=(log_entry&&) = default;
+
+private:
+  struct storage {
+    std::string message;
+    std::string source;
+    field_set fields;
+  };
+  std::unique_ptr<storage> storage_;
+};
+
+/**
+ * Formatter interface for customizable output.
+ *
+ * format_to() appends to a reusable buffer and is what loggers call; the
+ * default implementation forwards to format(), so formatters only need one.
+ */
+class formatter {
+public:
+  virtual ~formatter() = default;
+  virtual std::string format(const log_entry& entry) const = 0;
+  virtual void format_to(detail::fmt_buffer& out, const log_entry& entry) const { out.append(format(entry)); }
+};
+
+/**
+ * How a timestamp component is rendered.
+ *
+ * The strftime pattern covers everything down to whole seconds and is
+ * rendered once per second per thread; only the fraction digits are
+ * written for every record.
+ */
+struct timestamp_format {
+  std::string_view pattern = "%Y-%m-%d %H:%M:%S"; // strftime pattern
+  int fraction_digits = 3;                         // digits after the seconds, 0 to 9
+  bool utc = false;                                // utc instead of local time
+  std::string_view suffix = "";                    // written after the fraction, e.g. "Z"
+
+  // "2024-01-02T03:04:05.123Z"
+  static constexpr timestamp_format rfc3339(int digits = 3) {
+    return timestamp_format{"%Y-%m-%dT%H:%M:%S", digits, true, "Z"};
+  }
+};
+
+namespace detail {
+
+// the last rendered second for a pattern; two slots so alternating formatters do not evict each other
+struct timestamp_cache {
+  struct slot {
+    std::int64_t second = 0;
+    bool valid = false;
+    bool utc = false;
+    char pattern[48] = {};
+    std::size_t pattern_length = 0;
+    char text[64] = {};
+    std::size_t text_length = 0;
+  };
+
+  std::array<slot, 2> slots;
+  std::size_t next = 0;
+
+  static timestamp_cache& local() {
+    thread_local timestamp_cache cache;
+    return cache;
+  }
+};
+
+inline std::size_t render_seconds(char* out, std::size_t capacity, const char* pattern, std::time_t seconds, bool utc) {
+  std::tm parts{};
+#ifdef _WIN32
+  utc ? gmtime_s(&parts, &seconds) : localtime_s(&parts, &seconds);
+#else
+  utc ? gmtime_r(&seconds, &parts) : localtime_r(&seconds, &parts);
+#endif
+  return std::strftime(out, capacity, pattern, &parts);
+}
+
+/**
+ * Append a timestamp: the cached date and time prefix, then a dot and the
+ * requested fraction digits.
+ */
+inline void append_timestamp(fmt_buffer& out, std::chrono::system_clock::time_point time, const timestamp_format& fmt) {
+  std::int64_t nanoseconds = to_nanoseconds(time);
+  std::int64_t second = nanoseconds / 1000000000;
+  std::int64_t fraction = nanoseconds % 1000000000;
+  if (fraction < 0) {
+    second -= 1;
+    fraction += 1000000000;
+  }
+
+  timestamp_cache& cache = timestamp_cache::local();
+  timestamp_cache::slot* hit = nullptr;
+  for (auto& candidate : cache.slots) {
+    if (candidate.valid && candidate.second == second && candidate.utc == fmt.utc &&
+        std::string_view(candidate.pattern, candidate.pattern_length) == fmt.pattern) {
+      hit = &candidate;
+      break;
+    }
+  }
+
+  if (hit) {
+    out.append(std::string_view(hit->text, hit->text_length));
+  } else if (fmt.pattern.size() < sizeof(timestamp_cache::slot::pattern)) {
+    timestamp_cache::slot& fresh = cache.slots[cache.next];
+    cache.next = (cache.next + 1) % cache.slots.size();
+    fmt.pattern.copy(fresh.pattern, fmt.pattern.size());
+    fresh.pattern[fmt.pattern.size()] = '\0';
+    fresh.pattern_length = fmt.pattern.size();
+    fresh.second = second;
+    fresh.utc = fmt.utc;
+    fresh.text_length =
+        render_seconds(fresh.text, sizeof(fresh.text), fresh.pattern, static_cast<std::time_t>(second), fmt.utc);
+    fresh.valid = true;
+    out.append(std::string_view(fresh.text, fresh.text_length));
+  } else {
+    // pattern too long to cache
+    std::string pattern(fmt.pattern);
+    char text[256];
+    out.append(std::string_view(
+        text, render_seconds(text, sizeof(text), pattern.c_str(), static_cast<std::time_t>(second), fmt.utc)
+    ));
+  }
+
+  int digits = std::clamp(fmt.fraction_digits, 0, 9);
+  if (digits > 0) {
+    char fraction_text[10];
+    for (int i = 8; i >= 0; --i) {
+      fraction_text[i] = static_cast<char>('0' + fraction % 10);
+      fraction /= 10;
+    }
+    out.push_back('.');
+    out.append(std::string_view(fraction_text, static_cast<std::size_t>(digits)));
+  }
+  out.append(fmt.suffix);
+}
+
+} // namespace detail
+
+/**
+ * Default formatter producing beautiful aligned output.
+ *
+ * Format: [source]      [lvl] message                    key=value key=value
+ *
+ * With a timestamp_format the line starts with the record time.
+ */
+class default_formatter : public formatter {
+  // set when constructed with an explicit theme; otherwise the current global one is used
+  std::shared_ptr<const detail::theme_styles> styles_;
+  std::optional<timestamp_format> timestamp_;
+
+  const detail::theme_styles& styles() const noexcept {
+    return styles_ ? *styles_ : detail::current_config().styles;
+  }
+
+public:
+  // follows set_theme() and configure() while running
+  default_formatter() = default;
+  explicit default_formatter(const theme& t) : styles_(std::make_shared<const detail::theme_styles>(t)) {}
+  explicit default_formatter(timestamp_format timestamp) : timestamp_(timestamp) {}
+  default_formatter(const theme& t, timestamp_format timestamp)
+      : styles_(std::make_shared<const detail::theme_styles>(t)), timestamp_(timestamp) {}
+
+  std::string format(const log_entry& entry) const override {
+    detail::fmt_buffer out;
+    format_to(out, entry);
+    return out.str();
+  }
+
+  // append the formatted record to a buffer
+  void format_to(detail::fmt_buffer& out, const log_entry& entry) const override {
+    detail::config_pin pin;
+    const detail::theme_styles& look = styles();
+    const theme& layout = look.values();
+
+    if (timestamp_) {
+      detail::append_timestamp(out, entry.timestamp, *timestamp_);
+      out.push_back(' ');
+    }
+
+    // source component with fixed width padding
+    if (!entry.source.empty()) {
+      out.append(look.source().open());
+      out.push_back('[');
+      out.append(entry.source);
+      out.push_back(']');
+      out.append(look.source().close());
+
+      int padding = layout.source_width - static_cast<int>(entry.source.size() + 2);
+      out.append(static_cast<std::size_t>(std::max(1, padding)), ' ');
+    }
+
+    // level component with optional padding
+    const auto& lvl = look.level_for(entry.level_val);
+    lvl.style.wrap(out, std::string_view(lvl.label, lvl.label_length));
+    out.push_back(' ');
+
+    // message component with fixed width (logrus-style); the width counts color codes, as setw did
+    look.message().wrap(out, entry.message);
+    std::size_t message_length = entry.message.size() + look.message().overhead();
+    if (layout.message_fixed_width > 0 && message_length < static_cast<std::size_t>(layout.message_fixed_width)) {
+      out.append(static_cast<std::size_t>(layout.message_fixed_width) - message_length, ' ');
+    }
+
+    // fields component
+    if (!entry.fields.empty()) {
+      out.push_back(' ');
+
+      bool first = true;
+      std::size_t skip = 0;
+      // context fields rendered ahead of time are copied as they are
+      if (const rendered_fields* prefix = entry.fields.rendered()) {
+        if (const std::string* text = prefix->text_for(look)) {
+          out.append(*text);
+          skip = prefix->size();
+          first = false;
+        }
+      }
+
+      for (const auto& f : entry.fields.fields()) {
+        if (skip > 0) {
+          skip--;
+          continue;
+        }
+        if (!first) {
+          out.push_back(' ');
+        }
+        first = false;
+        detail::append_field(out, look, f, look.colored());
+      }
+    }
+
+    // call site component: [file:line function]
+    if (entry.where) {
+      out.push_back(' ');
+      out.append(look.source().open());
+      out.push_back('[');
+      out.append(entry.where->file);
+      out.push_back(':');
+      detail::write_integer(out, entry.where->line);
+      if (!entry.where->function.empty()) {
+        out.push_back(' ');
+        out.append(entry.where->function);
+      }
+      out.push_back(']');
+      out.append(look.source().close());
+    }
+  }
+};
+
+namespace detail {
+
+// characters json strings escape; logfmt additionally quotes values with spaces or '='
+template <bool Logfmt> constexpr bool is_special_char(char c) noexcept {
+  const auto byte = static_cast<unsigned char>(c);
+  return byte < (Logfmt ? 0x21 : 0x20) || c == '"' || c == '\\' || (Logfmt && c == '=');
+}
+
+/**
+ * Length of the leading run of text without special characters.
+ *
+ * Scans 16 bytes per step with SSE2 or NEON where available; the scalar loop
+ * finishes the tail and pinpoints the character inside a flagged block.
+ */
+template <bool Logfmt> inline std::size_t clean_prefix(const char* data, std::size_t size) noexcept {
+  std::size_t i = 0;
+#if defined(REDLOG_HAS_SSE2)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i equals = _mm_set1_epi8('=');
+  const __m128i control = _mm_set1_epi8(static_cast<char>(Logfmt ? 0x20 : 0x1f));
+  for (; i + 16 <= size; i += 16) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    // min(chunk, limit) == chunk is an unsigned chunk <= limit
+    __m128i special = _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk);
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, quote));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, backslash));
+    if constexpr (Logfmt) {
+      special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, equals));
+    }
+    const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+    if (mask != 0) {
+      return i + static_cast<std::size_t>(std::countr_zero(mask));
+    }
+  }
+#elif defined(REDLOG_HAS_NEON)
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  const uint8x16_t equals = vdupq_n_u8('=');
+  const uint8x16_t control = vdupq_n_u8(Logfmt ? 0x20 : 0x1f);
+  for (; i + 16 <= size; i += 16) {
+    const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+    uint8x16_t special = vcleq_u8(chunk, control);
+    special = vorrq_u8(special, vceqq_u8(chunk, quote));
+    special = vorrq_u8(special, vceqq_u8(chunk, backslash));
+    if constexpr (Logfmt) {
+      special = vorrq_u8(special, vceqq_u8(chunk, equals));
+    }
+    if (vmaxvq_u8(special) != 0) {
+      break;
+    }
+  }
+#endif
+  while (i < size && !is_special_char<Logfmt>(data[i])) {
+    ++i;
+  }
+  return i;
+}
+
+/**
+ * Append text as the inside of a json string: clean runs are copied in bulk,
+ * quotes, backslashes and control characters are escaped. Other bytes,
+ * including utf-8 sequences, pass through unchanged.
+ */
+template <typename Out> void append_json_escaped(Out& out, std::string_view text) {
+  static constexpr char hex[] = "0123456789abcdef";
+  for (;;) {
+    const std::size_t clean = clean_prefix<false>(text.data(), text.size());
+    out.append(text.substr(0, clean));
+    if (clean == text.size()) {
+      return;
+    }
+
+    const char c = text[clean];
+    switch (c) {
+    case '"':
+      out.append("\\\"");
+      break;
+    case '\\':
+      out.append("\\\\");
+      break;
+    case '\n':
+      out.append("\\n");
+      break;
+    case '\r':
+      out.append("\\r");
+      break;
+    case '\t':
+      out.append("\\t");
+      break;
+    default: {
+      const auto byte = static_cast<unsigned char>(c);
+      const char escaped[] = {'\\', 'u', '0', '0', hex[byte >> 4], hex[byte & 0xf]};
+      out.append(std::string_view(escaped, sizeof(escaped)));
+    }
+    }
+    text.remove_prefix(clean + 1);
+  }
+}
+
+template <typename Out> void append_json_string(Out& out, std::string_view text) {
+  out.push_back('"');
+  append_json_escaped(out, text);
+  out.push_back('"');
+}
+
+// a logfmt value: bare when it has no spaces, quotes, '=' or control characters, else quoted
+template <typename Out> void append_logfmt_string(Out& out, std::string_view text) {
+  if (!text.empty() && clean_prefix<true>(text.data(), text.size()) == text.size()) {
+    out.append(text);
+    return;
+  }
+  append_json_string(out, text);
+}
+
+// numbers and booleans as json literals, everything else as a string
+inline void append_json_value(fmt_buffer& out, const field_value& value) {
+  using kind = field_value::kind;
+  switch (value.type()) {
+  case kind::boolean:
+    out.append(value.as_bool() ? "true" : "false");
+    return;
+  case kind::int64:
+  case kind::uint64:
+    value.format_to(out);
+    return;
+  case kind::float64:
+    if (std::isfinite(value.as_double())) {
+      value.format_to(out);
+      return;
+    }
+    break;
+  case kind::string:
+  case kind::view:
+    append_json_string(out, value.text());
+    return;
+  default:
+    break;
+  }
+  scratch_buffer text;
+  value.format_to(text.get());
+  append_json_string(out, text.view());
+}
+
+inline void append_logfmt_value(fmt_buffer& out, const field_value& value) {
+  using kind = field_value::kind;
+  switch (value.type()) {
+  case kind::boolean:
+    out.append(value.as_bool() ? "true" : "false");
+    return;
+  case kind::int64:
+  case kind::uint64:
+  case kind::float64:
+    value.format_to(out);
+    return;
+  case kind::string:
+  case kind::view:
+    append_logfmt_string(out, value.text());
+    return;
+  default:
+    break;
+  }
+  scratch_buffer text;
+  value.format_to(text.get());
+  append_logfmt_string(out, text.view());
+}
+
+// logfmt keys cannot be quoted: characters a key may not contain become '_'
+inline void append_logfmt_key(fmt_buffer& out, std::string_view key) {
+  if (key.empty()) {
+    out.push_back('_');
+    return;
+  }
+  if (std::none_of(key.begin(), key.end(), is_special_char<true>)) {
+    out.append(key);
+    return;
+  }
+  for (char c : key) {
+    out.push_back(is_special_char<true>(c) ? '_' : c);
+  }
+}
+
+} // namespace detail
+
+/**
+ * One json object per record:
+ *
+ *   {"time":"2024-01-02T03:04:05.123Z","level":"info","source":"app","message":"hi","user":"alice","id":7}
+ *
+ * Numbers and booleans are written as json literals. Fields follow the
+ * fixed keys (and "file", "line", "function" for records with a call site)
+ * in logging order; repeated keys are written as they come.
+ */
+class json_formatter : public formatter {
+  std::optional<timestamp_format> timestamp_;
+
+public:
+  json_formatter() : timestamp_(timestamp_format::rfc3339()) {}
+  // std::nullopt leaves out the "time" key
+  explicit json_formatter(std::optional<timestamp_format> timestamp) : timestamp_(timestamp) {}
+
+  std::string format(const log_entry& entry) const override {
+    detail::fmt_buffer out;
+    format_to(out, entry);
+    return out.str();
+  }
+
+  void format_to(detail::fmt_buffer& out, const log_entry& entry) const override {
+    out.push_back('{');
+    if (timestamp_) {
+      out.append("\"time\":\"");
+      detail::append_timestamp(out, entry.timestamp, *timestamp_);
+      out.append("\",");
+    }
+    out.append("\"level\":\"");
+    out.append(level_name(entry.level_val));
+    out.push_back('"');
+    if (!entry.source.empty()) {
+      out.append(",\"source\":");
+      detail::append_json_string(out, entry.source);
+    }
+    out.append(",\"message\":");
+    detail::append_json_string(out, entry.message);
+    if (entry.where) {
+      out.append(",\"file\":");
+      detail::append_json_string(out, entry.where->file);
+      out.append(",\"line\":");
+      detail::write_integer(out, entry.where->line);
+      out.append(",\"function\":");
+      detail::append_json_string(out, entry.where->function);
+    }
+    for (const auto& f : entry.fields.fields()) {
+      out.push_back(',');
+      detail::append_json_string(out, f.key);
+      out.push_back(':');
+      detail::append_json_value(out, f.value);
+    }
+    out.push_back('}');
+  }
+};
+
+/**
+ * logfmt lines:
+ *
+ *   time=2024-01-02T03:04:05.123Z level=info source=app msg="user login" user=alice id=7
+ *
+ * Values are quoted, with json escapes, only when they contain spaces,
+ * quotes, '=' or control characters.
+ */
+class logfmt_formatter : public formatter {
+  std::optional<timestamp_format> timestamp_;
+
+public:
+  logfmt_formatter() : timestamp_(timestamp_format::rfc3339()) {}
+  // std::nullopt leaves out the "time" key
+  explicit logfmt_formatter(std::optional<timestamp_format> timestamp) : timestamp_(timestamp) {}
+
+  std::string format(const log_entry& entry) const override {
+    detail::fmt_buffer out;
+    format_to(out, entry);
+    return out.str();
+  }
+
+  void format_to(detail::fmt_buffer& out, const log_entry& entry) const override {
+    if (timestamp_) {
+      detail::scratch_buffer time;
+      detail::append_timestamp(time.get(), entry.timestamp, *timestamp_);
+      out.append("time=");
+      detail::append_logfmt_string(out, time.view());
+      out.push_back(' ');
+    }
+    out.append("level=");
+    out.append(level_name(entry.level_val));
+    if (!entry.source.empty()) {
+      out.append(" source=");
+      detail::append_logfmt_string(out, entry.source);
+    }
+    out.append(" msg=");
+    detail::append_logfmt_string(out, entry.message);
+    if (entry.where) {
+      out.append(" file=");
+      detail::append_logfmt_string(out, entry.where->file);
+      out.append(" line=");
+      detail::write_integer(out, entry.where->line);
+      out.append(" func=");
+      detail::append_logfmt_string(out, entry.where->function);
+    }
+    for (const auto& f : entry.fields.fields()) {
+      out.push_back(' ');
+      detail::append_logfmt_key(out, f.key);
+      out.push_back('=');
+      detail::append_logfmt_value(out, f.value);
+    }
+  }
+};
+
+namespace detail {
+
+// argument types that can be captured by value and formatted later
+template <typename T>
+inline constexpr bool is_raw_deferrable_v =
+    std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_same_v<T, void*> || std::is_same_v<T, const void*>;
+
+template <typename T>
+inline constexpr bool is_string_deferrable_v = std::is_same_v<T, const char*> || std::is_same_v<T, char*> ||
+                                               std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+
+template <typename T>
+inline constexpr bool is_deferrable_v = is_raw_deferrable_v<std::decay_t<T>> || is_string_deferrable_v<std::decay_t<T>>;
+
+// type an argument is decoded as on the formatting side
+template <typename T>
+using deferred_decoded_t = std::conditional_t<
+    is_raw_deferrable_v<T>, T,
+    std::conditional_t<std::is_same_v<T, const char*> || std::is_same_v<T, char*>, const char*, std::string_view>>;
+
+/**
+ * Compact binary record of a printf-style call whose formatting is deferred.
+ *
+ * The format string and arguments are copied into inline storage (strings
+ * by value, so callers may free them right after the call) together with a
+ * decoder instantiated for the argument types. materialize() runs the usual
+ * stream_printf and formatter on whichever thread ends up writing it.
+ */
+class deferred_record {
+  static constexpr std::uint32_t null_string = 0xffffffffu;
+
+  template <typename T> static const unsigned char* decode(const unsigned char* in, deferred_decoded_t<T>& out) {
+    if constexpr (is_raw_deferrable_v<T>) {
+      std::memcpy(&out, in, sizeof(T));
+      return in + sizeof(T);
+    } else {
+      std::uint32_t length;
+      std::memcpy(&length, in, sizeof(length));
+      in += sizeof(length);
+      if constexpr (std::is_same_v<deferred_decoded_t<T>, const char*>) {
+        if (length == null_string) {
+          out = nullptr;
+          return in;
+        }
+        out = reinterpret_cast<const char*>(in);
+        return in + length + 1;
+      } else {
+        out = std::string_view(reinterpret_cast<const char*>(in), length);
+        return in + length;
+      }
+    }
+  }
+
+  template <typename... Args> static std::tuple<deferred_decoded_t<Args>...> decode_args(const unsigned char* in) {
+    std::tuple<deferred_decoded_t<Args>...> args;
+    std::apply([&in](auto&... decoded) { ((in = decode<Args>(in, decoded)), ...); }, args);
+    return args;
+  }
+
+  // runtime format: the format string is stored in front of the arguments
+  template <typename... Args> static std::string render_impl(const unsigned char* data) {
+    const char* format = reinterpret_cast<const char*>(data);
+    auto args = decode_args<Args...>(data + std::strlen(format) + 1);
+    return std::apply([format](const auto&... decoded) { return stream_printf(format, decoded...); }, args);
+  }
+
+  // compiled format: the format lives in the type, only arguments are stored
+  template <typename Format, typename... Args> static std::string render_compiled(const unsigned char* data) {
+    auto args = decode_args<Args...>(data);
+    return std::apply([](const auto&... decoded) { return stream_printf(Format{}, decoded...); }, args);
+  }
+
+  // convert decoded arguments to tagged values; returns the argument count even if out is smaller
+  template <typename Tuple> static std::size_t describe_args(const Tuple& args, std::span<arg_value> out) {
+    std::size_t index = 0;
+    std::apply(
+        [&](const auto&... decoded) {
+          ((index < out.size() ? void(out[index] = arg_value::from(decoded)) : void(), ++index), ...);
+        },
+        args
+    );
+    return std::tuple_size_v<Tuple>;
+  }
+
+  template <typename... Args>
+  static std::size_t describe_impl(const unsigned char* data, std::string_view& format, std::span<arg_value> out) {
+    format = reinterpret_cast<const char*>(data);
+    return describe_args(decode_args<Args...>(data + format.size() + 1), out);
+  }
+
+  template <typename Format, typename... Args>
+  static std::size_t describe_compiled(const unsigned char* data, std::string_view& format, std::span<arg_value> out) {
+    format = Format::text;
+    return describe_args(decode_args<Args...>(data), out);
+  }
+
+  bool put(const void* src, std::size_t length) {
+    if (length > inline_capacity - size) {
+      return false;
+    }
+    std::memcpy(data + size, src, length);
+    size += length;
+    return true;
+  }
+
+  template <typename T> bool put_arg(const T& value) {
+    using decay_t = std::decay_t<T>;
+    if constexpr (is_raw_deferrable_v<decay_t>) {
+      return put(&value, sizeof(decay_t));
+    } else if constexpr (std::is_same_v<decay_t, const char*> || std::is_same_v<decay_t, char*>) {
+      const char* text = value;
+      if (!text) {
+        return put(&null_string, sizeof(null_string));
+      }
+      auto length = static_cast<std::uint32_t>(std::strlen(text));
+      return put(&length, sizeof(length)) && put(text, length + 1);
+    } else {
+      std::string_view view(value);
+      auto length = static_cast<std::uint32_t>(view.size());
+      return put(&length, sizeof(length)) && put(view.data(), view.size());
+    }
+  }
+
+public:
+  static constexpr std::size_t inline_capacity = 256;
+  using render_fn = std::string (*)(const unsigned char* data);
+  using describe_fn = std::size_t (*)(const unsigned char* data, std::string_view& format, std::span<arg_value> out);
+
+  level level_val = level::info;
+  render_fn render = nullptr;
+  describe_fn describe = nullptr;
+  std::shared_ptr<const logger_context> context;
+  std::shared_ptr<formatter> fmt;
+  std::chrono::system_clock::time_point timestamp;
+  const source_site* where = nullptr;
+  std::size_t size = 0;
+  unsigned char data[inline_capacity];
+
+  /**
+   * Copy the format string and arguments into the record.
+   * Returns false (leaving the record unusable) if they do not fit.
+   */
+  template <typename... Args> bool capture(const char* format, const Args&... args) {
+    size = 0;
+    render = nullptr;
+    describe = nullptr;
+    if (!put(format, std::strlen(format) + 1) || !(put_arg(args) && ...)) {
+      return false;
+    }
+    render = &render_impl<std::decay_t<Args>...>;
+    describe = &describe_impl<std::decay_t<Args>...>;
+    return true;
+  }
+
+  template <fixed_string Format, typename... Args> bool capture(compiled_format<Format>, const Args&... args) {
+    size = 0;
+    render = nullptr;
+    describe = nullptr;
+    if (!(put_arg(args) && ...)) {
+      return false;
+    }
+    render = &render_compiled<compiled_format<Format>, std::decay_t<Args>...>;
+    describe = &describe_compiled<compiled_format<Format>, std::decay_t<Args>...>;
+    return true;
+  }
+
+  /**
+   * The format string and up to out.size() arguments as tagged values, for
+   * sinks that store calls unformatted. Returns the total argument count.
+   */
+  std::size_t arguments(std::string_view& format, std::span<arg_value> out) const {
+    return describe(data, format, out);
+  }
+
+  // format the message alone
+  std::string message() const {
+    try {
+      return render(data);
+    } catch (...) {
+      return "[printf_format_error]";
+    }
+  }
+
+  // format the message and the full log line
+  std::string materialize() const {
+    std::string text = message();
+    log_entry entry(level_val, text, context->name, context->view(), timestamp);
+    entry.where = where;
+    return fmt->format(entry);
+  }
+};
+
+// severity of the i-th record in a batch; missing levels read as info
+inline level batch_level(std::span<const level> levels, std::size_t i) noexcept {
+  return i < levels.size() ? levels[i] : level::info;
+}
+
+// records joined with trailing newlines, as consecutive write() calls would produce them
+inline void join_records(fmt_buffer& out, std::span<const std::string_view> records) {
+  for (std::string_view record : records) {
+    out.append(record);
+    out.push_back('\n');
+  }
+}
+
+} // namespace detail
+
+/**
+ * Latency distribution in power-of-two buckets: counts[k] holds samples of
+ * at most 2^k nanoseconds (and more than 2^(k-1)); the last bucket also
+ * takes everything slower.
+ */
+struct latency_histogram {
+  static constexpr std::size_t bucket_count = 32;
+
+  std::array<std::uint64_t, bucket_count> counts{};
+  std::uint64_t count = 0;
+  std::uint64_t sum_ns = 0;
+
+  static constexpr std::uint64_t upper_bound_ns(std::size_t bucket) noexcept { return std::uint64_t{1} << bucket; }
+};
+
+// output of one built-in sink, or of earlier sinks of its kind that are gone
+struct sink_statistics {
+  std::string name; // the sink kind ("file", or a buffered_file_sink's stats name), ".2", ".3", ... for later ones
+  std::uint64_t bytes = 0;   // bytes handed to the operating system
+  std::uint64_t writes = 0;  // write calls that carried them
+  std::uint64_t flushes = 0; // flush() calls
+};
+
+// one live async_sink queue
+struct queue_statistics {
+  std::string name;           // the async_sink's name; repeats get ".2", ".3"... in creation order
+  std::size_t depth = 0;      // records waiting for the worker
+  std::size_t high_water = 0; // largest depth seen
+  std::size_t capacity = 0;
+};
+
+/**
+ * Snapshot of redlog's own counters, see redlog::stats(). Per-level arrays
+ * are indexed by static_cast<int>(level).
+ */
+struct statistics {
+  std::array<std::uint64_t, 9> emitted{};  // records written to a sink
+  std::array<std::uint64_t, 9> filtered{}; // records below the active level
+  std::array<std::uint64_t, 9> dropped{};  // records discarded by a full async queue
+  latency_histogram format_time;           // formatter time per record, with settings::measure_latency
+  latency_histogram write_time;            // time the logging thread spent in the sink per record
+  std::vector<sink_statistics> sinks;
+  std::vector<queue_statistics> queues;
+
+  // prometheus text exposition format
+  std::string prometheus() const;
+};
+
+namespace detail {
+
+inline std::int64_t steady_ns() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// bump a counter; shards written by a single thread skip the locked read-modify-write
+inline void bump(std::atomic<std::uint64_t>& counter, std::uint64_t amount, bool shared) noexcept {
+  if (shared) {
+    counter.fetch_add(amount, std::memory_order_relaxed);
+  } else {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+}
+
+struct latency_cells {
+  std::array<std::atomic<std::uint64_t>, latency_histogram::bucket_count> counts{};
+  std::atomic<std::uint64_t> sum_ns{0};
+
+  void add(std::int64_t ns, bool shared) noexcept {
+    auto value = static_cast<std::uint64_t>(ns > 0 ? ns : 0);
+    std::size_t bucket = value > 1 ? static_cast<std::size_t>(std::bit_width(value - 1)) : 0;
+    bump(counts[std::min(bucket, latency_histogram::bucket_count - 1)], 1, shared);
+    bump(sum_ns, value, shared);
+  }
+
+  void add_to(latency_histogram& out) const noexcept {
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+      std::uint64_t n = counts[i].load(std::memory_order_relaxed);
+      out.counts[i] += n;
+      out.count += n;
+    }
+    out.sum_ns += sum_ns.load(std::memory_order_relaxed);
+  }
+};
+
+/**
+ * Per-thread record counters. Each thread leases a shard on first use and
+ * returns it at exit for the next new thread, so totals survive thread churn.
+ * Shards are only written by their thread and read with relaxed loads.
+ */
+struct stats_shard {
+  std::array<std::atomic<std::uint64_t>, 9> emitted{};
+  std::array<std::atomic<std::uint64_t>, 9> filtered{};
+  std::array<std::atomic<std::uint64_t>, 9> dropped{};
+  latency_cells format_time;
+  latency_cells write_time;
+  bool shared = false; // written by several threads (the shard used while threads exit)
+};
+
+// byte, write and flush counts for one sink
+struct sink_meter {
+  std::string name; // unique among meters, set by stats_registry::add_meter
+  std::string kind; // the name it was requested under
+  bool leased = false; // held by a live sink; guarded by the registry mutex
+  std::atomic<std::uint64_t> bytes{0};
+  std::atomic<std::uint64_t> writes{0};
+  std::atomic<std::uint64_t> flushes{0};
+
+  sink_meter(std::string meter_name, std::string_view meter_kind) : name(std::move(meter_name)), kind(meter_kind) {}
+
+  void wrote(std::size_t size) noexcept {
+#if REDLOG_STATS
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    writes.fetch_add(1, std::memory_order_relaxed);
+#else
+    (void) size;
+#endif
+  }
+
+  void flushed() noexcept {
+#if REDLOG_STATS
+    flushes.fetch_add(1, std::memory_order_relaxed);
+#endif
+  }
+};
+
+// depth and high-water mark of one async queue, registered while the queue lives
+struct queue_gauge {
+  std::string name; // unique among registered queues, set by stats_registry::add_queue
+  std::atomic<std::size_t> depth{0};
+  std::atomic<std::size_t> high_water{0};
+  std::size_t capacity = 0;
+
+  void pushed() noexcept {
+#if REDLOG_STATS
+    std::size_t now = depth.fetch_add(1, std::memory_order_relaxed) + 1;
+    std::size_t peak = high_water.load(std::memory_order_relaxed);
+    while (now > peak && !high_water.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+#endif
+  }
+
+  void popped(std::size_t count) noexcept {
+#if REDLOG_STATS
+    depth.fetch_sub(count, std::memory_order_relaxed);
+#else
+    (void) count;
+#endif
+  }
+};
+
+class stats_registry {
+  std::mutex mutex_;
+  std::deque<stats_shard> shards_;
+  std::vector<stats_shard*> free_;
+  std::deque<sink_meter> meters_;
+  std::map<std::string, std::size_t, std::less<>> meter_names_; // meters ever created per kind
+  std::vector<const queue_gauge*> queues_;
+  std::map<std::string, std::size_t, std::less<>> queue_names_; // queues ever registered per name
+
+  // name, or name.2, name.3, ... for later uses
+  static std::string unique_name(std::map<std::string, std::size_t, std::less<>>& uses, std::string_view name) {
+    std::size_t count = ++uses[std::string(name)];
+    return count == 1 ? std::string(name) : std::string(name) + "." + std::to_string(count);
+  }
+
+  stats_registry() { shards_.emplace_back().shared = true; }
+
+public:
+  static stats_registry& instance() {
+    static stats_registry* registry = new stats_registry(); // never destroyed: threads may count during exit
+    return *registry;
+  }
+
+  stats_shard& shared_shard() { return shards_.front(); }
+
+  stats_shard* lease() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_.empty()) {
+      stats_shard* shard = free_.back();
+      free_.pop_back();
+      return shard;
+    }
+    return &shards_.emplace_back();
+  }
+
+  void release(stats_shard* shard) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(shard);
+  }
+
+  /**
+   * A meter for one sink, named like queues: kind, kind.2, kind.3, ...
+   * Meters live for the whole program, so a sink's counts are still reported
+   * after it is gone; a released meter is reused by the next sink of its kind.
+   */
+  sink_meter& add_meter(std::string_view kind) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& existing : meters_) {
+      if (!existing.leased && existing.kind == kind) {
+        existing.leased = true;
+        return existing;
+      }
+    }
+    sink_meter& created = meters_.emplace_back(unique_name(meter_names_, kind), kind);
+    created.leased = true;
+    return created;
+  }
+
+  void release_meter(sink_meter& meter) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    meter.leased = false;
+  }
+
+  void add_queue(queue_gauge* gauge, std::string_view name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gauge->name = unique_name(queue_names_, name);
+    queues_.push_back(gauge);
+  }
+
+  void remove_queue(const queue_gauge* gauge) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queues_.erase(std::remove(queues_.begin(), queues_.end(), gauge), queues_.end());
+  }
+
+  statistics snapshot() {
+    statistics out;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const stats_shard& shard : shards_) {
+      for (std::size_t i = 0; i < 9; ++i) {
+        out.emitted[i] += shard.emitted[i].load(std::memory_order_relaxed);
+        out.filtered[i] += shard.filtered[i].load(std::memory_order_relaxed);
+        out.dropped[i] += shard.dropped[i].load(std::memory_order_relaxed);
+      }
+      shard.format_time.add_to(out.format_time);
+      shard.write_time.add_to(out.write_time);
+    }
+    for (const sink_meter& m : meters_) {
+      out.sinks.push_back(sink_statistics{m.name, m.bytes.load(std::memory_order_relaxed),
+                                          m.writes.load(std::memory_order_relaxed),
+                                          m.flushes.load(std::memory_order_relaxed)});
+    }
+    for (const queue_gauge* gauge : queues_) {
+      out.queues.push_back(queue_statistics{gauge->name, gauge->depth.load(std::memory_order_relaxed),
+                                            gauge->high_water.load(std::memory_order_relaxed), gauge->capacity});
+    }
+    return out;
+  }
+};
+
+// the calling thread's shard; the lease hands it back when the thread exits
+inline thread_local stats_shard* local_stats = nullptr;
+
+/**
+ * A sink's meter: its own one of a kind, handed back with the sink, or one
+ * borrowed from an owner that outlives it (rotating_file_sink's segments).
+ */
+class meter_lease {
+  sink_meter* meter_;
+  bool owned_;
+
+public:
+  explicit meter_lease(std::string_view kind) : meter_(&stats_registry::instance().add_meter(kind)), owned_(true) {}
+  explicit meter_lease(sink_meter& shared) noexcept : meter_(&shared), owned_(false) {}
+
+  ~meter_lease() {
+    if (owned_) {
+      stats_registry::instance().release_meter(*meter_);
+    }
+  }
+
+  meter_lease(meter_lease&& other) noexcept : meter_(other.meter_), owned_(std::exchange(other.owned_, false)) {}
+  meter_lease(const meter_lease&) = delete;
+  meter_lease& operator=(const meter_lease&) = delete;
+
+  sink_meter& get() const noexcept { return *meter_; }
+  sink_meter* operator->() const noexcept { return meter_; }
+};
+
+struct stats_lease {
+  stats_shard* shard = stats_registry::instance().lease();
+
+  stats_lease() { local_stats = shard; }
+  ~stats_lease() {
+    local_stats = &stats_registry::instance().shared_shard(); // records logged later in thread exit
+    stats_registry::instance().release(shard);
+  }
+};
+
+inline stats_shard& thread_stats() {
+  if (stats_shard* shard = local_stats) {
+    return *shard;
+  }
+  thread_local stats_lease lease;
+  return *local_stats;
+}
+
+inline void count_record(std::array<std::atomic<std::uint64_t>, 9> stats_shard::*counters, level lvl) noexcept {
+#if REDLOG_STATS
+  auto index = static_cast<std::size_t>(lvl);
+  if (index < 9) {
+    stats_shard& shard = thread_stats();
+    bump((shard.*counters)[index], 1, shard.shared);
+  }
+#else
+  (void) counters;
+  (void) lvl;
+#endif
+}
+
+inline void count_emitted(level lvl) noexcept { count_record(&stats_shard::emitted, lvl); }
+inline void count_filtered(level lvl) noexcept { count_record(&stats_shard::filtered, lvl); }
+inline void count_dropped(level lvl) noexcept { count_record(&stats_shard::dropped, lvl); }
+
+inline bool measuring_latency() noexcept {
+#if REDLOG_STATS
+  config_pin pin;
+  return current_config().values.measure_latency;
+#else
+  return false;
+#endif
+}
+
+// one formatted and written record: [start, formatted) in the formatter, [formatted, now) in the sink
+inline void record_latency(std::int64_t start, std::int64_t formatted) noexcept {
+  stats_shard& shard = thread_stats();
+  shard.format_time.add(formatted - start, shard.shared);
+  shard.write_time.add(steady_ns() - formatted, shard.shared);
+}
+
+// label values in the prometheus text format escape only backslash, quote and newline
+inline void append_prometheus_label(std::string& out, std::string_view text) {
+  for (char c : text) {
+    switch (c) {
+    case '\\':
+      out += "\\\\";
+      break;
+    case '"':
+      out += "\\\"";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    default:
+      out += c;
+    }
+  }
+}
+
+} // namespace detail
+
+inline std::string statistics::prometheus() const {
+  std::string out;
+  char line[160];
+  auto per_level = [&](const char* metric, const char* help, const std::array<std::uint64_t, 9>& values) {
+    std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n", metric, help, metric);
+    out += line;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      std::string_view name = level_name(static_cast<level>(i));
+      std::snprintf(line, sizeof(line), "%s{level=\"%.*s\"} %llu\n", metric, static_cast<int>(name.size()),
+                    name.data(), static_cast<unsigned long long>(values[i]));
+      out += line;
+    }
+  };
+  auto histogram = [&](const char* metric, const char* help, const latency_histogram& h) {
+    std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s histogram\n", metric, help, metric);
+    out += line;
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i + 1 < h.counts.size(); ++i) {
+      cumulative += h.counts[i];
+      std::snprintf(line, sizeof(line), "%s_bucket{le=\"%.9g\"} %llu\n", metric,
+                    static_cast<double>(latency_histogram::upper_bound_ns(i)) * 1e-9,
+                    static_cast<unsigned long long>(cumulative));
+      out += line;
+    }
+    std::snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.9g\n%s_count %llu\n", metric,
+                  static_cast<unsigned long long>(h.count), metric, static_cast<double>(h.sum_ns) * 1e-9, metric,
+                  static_cast<unsigned long long>(h.count));
+    out += line;
+  };
+  auto per_sink = [&](const char* metric, const char* help, std::uint64_t sink_statistics::*value) {
+    std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n", metric, help, metric);
+    out += line;
+    for (const auto& sink_stats : sinks) {
+      out += metric;
+      out += "{sink=\"";
+      detail::append_prometheus_label(out, sink_stats.name);
+      std::snprintf(line, sizeof(line), "\"} %llu\n", static_cast<unsigned long long>(sink_stats.*value));
+      out += line;
+    }
+  };
+  auto per_queue = [&](const char* metric, const char* help, std::size_t queue_statistics::*value) {
+    std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s gauge\n", metric, help, metric);
+    out += line;
+    for (const auto& queue : queues) {
+      out += metric;
+      out += "{queue=\"";
+      detail::append_prometheus_label(out, queue.name);
+      std::snprintf(line, sizeof(line), "\"} %zu\n", queue.*value);
+      out += line;
+    }
+  };
+
+  per_level("redlog_records_emitted_total", "Records written to a sink.", emitted);
+  per_level("redlog_records_filtered_total", "Records below the active level.", filtered);
+  per_level("redlog_records_dropped_total", "Records discarded by a full async queue.", dropped);
+  histogram("redlog_format_seconds", "Time spent formatting a record.", format_time);
+  histogram("redlog_sink_write_seconds", "Time the logging thread spent writing a record.", write_time);
+  per_sink("redlog_sink_bytes_total", "Bytes handed to the operating system.", &sink_statistics::bytes);
+  per_sink("redlog_sink_writes_total", "Write calls made by sinks.", &sink_statistics::writes);
+  per_sink("redlog_sink_flushes_total", "Sink flushes.", &sink_statistics::flushes);
+  per_queue("redlog_async_queue_depth", "Records waiting in an async queue.", &queue_statistics::depth);
+  per_queue("redlog_async_queue_high_water", "Largest async queue depth seen.", &queue_statistics::high_water);
+  per_queue("redlog_async_queue_capacity", "Async queue capacity.", &queue_statistics::capacity);
+  return out;
+}
+
+/**
+ * Output sink interface.
+ */
+class sink {
+public:
+  virtual ~sink() = default;
+  virtual void write(std::string_view formatted) = 0;
+  virtual void flush() = 0;
+
+  /**
+   * Deferred records carry raw printf arguments instead of formatted text.
+   * Sinks that format on a background thread opt in by returning true;
+   * everything else receives plain write() calls.
+   */
+  virtual bool accepts_deferred() const noexcept { return false; }
+  virtual void write_deferred(detail::deferred_record&& record) {
+    write_record(record.level_val, record.materialize());
+  }
+
+  /**
+   * Write a record together with its severity. Loggers call this; sinks that
+   * flush or route by level override it, the default ignores the level.
+   */
+  virtual void write_record(level lvl, std::string_view formatted) {
+    (void) lvl;
+    write(formatted);
+  }
+
+  /**
+   * Entry point for loggers: format the entry with the logger's formatter and
+   * write it. Sinks that pick their own formatters (dist_sink) override this.
+   */
+  virtual void write_entry(const log_entry& entry, const formatter& fmt) {
+    detail::scratch_buffer formatted;
+    if (!detail::measuring_latency()) {
+      fmt.format_to(formatted.get(), entry);
+      write_record(entry.level_val, formatted.view());
+      return;
+    }
+    std::int64_t start = detail::steady_ns();
+    fmt.format_to(formatted.get(), entry);
+    std::int64_t formatted_at = detail::steady_ns();
+    write_record(entry.level_val, formatted.view());
+    detail::record_latency(start, formatted_at);
+  }
+
+  /**
+   * Write several records at once; levels[i] is the severity of records[i].
+   * The default writes them one by one. Sinks in front of a file or terminal
+   * override it to hand the whole batch to the operating system in one call.
+   */
+  virtual void write_batch(std::span<const std::string_view> records, std::span<const level> levels) {
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      write_record(detail::batch_level(levels, i), records[i]);
+    }
+  }
+};
+
+/**
+ * File sink for logging to a file.
+ * Falls back to stderr if file cannot be opened.
+ */
+class file_sink : public sink {
+  FILE* file_;
+  bool should_close_;
+  detail::meter_lease meter_{"file"};
+
+public:
+  explicit file_sink(const std::string& filename) : file_(nullptr), should_close_(false) {
+    file_ = std::fopen(filename.c_str(), "a");
+    should_close_ = (file_ != nullptr);
+    if (!file_) {
+      // fallback to stderr if file open fails
+      file_ = stderr;
+      should_close_ = false;
+    }
+  }
+
+  ~file_sink() {
+    if (should_close_ && file_) {
+      std::fclose(file_);
+    }
+  }
+
+  // non-copyable, moveable
+  file_sink(const file_sink&) = delete;
+  file_sink& operator=(const file_sink&) = delete;
+  file_sink(file_sink&&) = default;
+  file_sink& operator=(file_sink&&) = default;
+
+  void write(std::string_view formatted) override {
+    if (file_) {
+      std::fprintf(file_, "%.*s\n", static_cast<int>(formatted.size()), formatted.data());
+      meter_->wrote(formatted.size() + 1);
+    }
+  }
+
+  // one fwrite for the whole batch
+  void write_batch(std::span<const std::string_view> records, std::span<const level>) override {
+    if (file_) {
+      detail::scratch_buffer joined;
+      detail::join_records(joined.get(), records);
+      std::fwrite(joined.get().data(), 1, joined.get().size(), file_);
+      meter_->wrote(joined.get().size());
+    }
+  }
+
+  void flush() override {
+    if (file_) {
+      std::fflush(file_);
+      meter_->flushed();
+    }
+  }
+};
+
+namespace detail {
+
+// raw file descriptor helpers; writes retry on partial writes and EINTR
+inline int open_append(const std::string& filename) noexcept {
+#ifdef _WIN32
+  return _open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+  return ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+}
+
+inline void close_fd(int fd) noexcept {
+#ifdef _WIN32
+  _close(fd);
+#else
+  ::close(fd);
+#endif
+}
+
+inline void sync_fd(int fd) noexcept {
+#ifdef _WIN32
+  _commit(fd);
+#else
+  ::fsync(fd);
+#endif
+}
+
+// size of a file in bytes, zero if it does not exist
+inline std::uint64_t file_size(const std::string& filename) noexcept {
+#ifdef _WIN32
+  struct _stat64 info;
+  return _stat64(filename.c_str(), &info) == 0 ? static_cast<std::uint64_t>(info.st_size) : 0;
+#else
+  struct stat info;
+  return ::stat(filename.c_str(), &info) == 0 ? static_cast<std::uint64_t>(info.st_size) : 0;
+#endif
+}
+
+inline bool write_all(int fd, const char* data, std::size_t size) noexcept {
+  while (size > 0) {
+#ifdef _WIN32
+    int written = _write(fd, data, static_cast<unsigned int>(std::min<std::size_t>(size, 1u << 30)));
+#else
+    ssize_t written = ::write(fd, data, size);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+#endif
+    if (written <= 0) {
+      return false;
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+// write several buffers in order, with one syscall where the platform allows
+inline bool write_all(int fd, std::span<const std::string_view> parts) noexcept {
+#ifndef _WIN32
+  constexpr std::size_t max_parts = 8;
+  if (parts.size() <= max_parts) {
+    iovec vec[max_parts];
+    std::size_t count = 0;
+    for (std::string_view part : parts) {
+      if (!part.empty()) {
+        vec[count].iov_base = const_cast<char*>(part.data());
+        vec[count].iov_len = part.size();
+        count++;
+      }
+    }
+
+    std::size_t first = 0;
+    while (first < count) {
+      ssize_t written = ::writev(fd, vec + first, static_cast<int>(count - first));
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written <= 0) {
+        return false;
+      }
+      auto remaining = static_cast<std::size_t>(written);
+      while (first < count && remaining >= vec[first].iov_len) {
+        remaining -= vec[first].iov_len;
+        first++;
+      }
+      if (first < count) {
+        vec[first].iov_base = static_cast<char*>(vec[first].iov_base) + remaining;
+        vec[first].iov_len -= remaining;
+      }
+    }
+    return true;
+  }
+#endif
+  for (std::string_view part : parts) {
+    if (!write_all(fd, part.data(), part.size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Flat combining for writes to one descriptor. Each writer pushes a request
+ * onto a lock-free stack and spins on its own done flag; whichever writer
+ * wins the combining flag takes every pending request, joins them in
+ * arrival order and writes them with one call. Under contention threads
+ * wait on a cache line instead of a kernel or stdio lock, and each record
+ * still reaches the descriptor whole.
+ */
+class write_combiner {
+  struct request {
+    std::span<const std::string_view> records;
+    request* next = nullptr;
+    std::atomic<bool> done{false};
+  };
+
+  int fd_;
+  std::atomic<request*> pending_{nullptr};
+  std::atomic<bool> combining_{false};
+
+  void combine() {
+    // the stack holds the newest request first
+    request* ordered = nullptr;
+    for (request* r = pending_.exchange(nullptr, std::memory_order_acquire); r;) {
+      request* next = r->next;
+      r->next = ordered;
+      ordered = r;
+      r = next;
+    }
+    scratch_buffer joined;
+    for (request* r = ordered; r; r = r->next) {
+      join_records(joined.get(), r->records);
+    }
+    write_all(fd_, joined.get().data(), joined.get().size());
+    // a request's owner may return as soon as it sees done, so read next first
+    while (ordered) {
+      request* next = ordered->next;
+      ordered->done.store(true, std::memory_order_release);
+      ordered = next;
+    }
+  }
+
+public:
+  explicit write_combiner(int fd) noexcept : fd_(fd) {}
+
+  // write each record followed by a newline; returns once they are written
+  void write(std::span<const std::string_view> records) {
+    request mine;
+    mine.records = records;
+    mine.next = pending_.load(std::memory_order_relaxed);
+    while (!pending_.compare_exchange_weak(mine.next, &mine, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    for (unsigned spins = 0; !mine.done.load(std::memory_order_acquire); ++spins) {
+      if (!combining_.load(std::memory_order_relaxed) && !combining_.exchange(true, std::memory_order_acquire)) {
+        combine();
+        combining_.store(false, std::memory_order_release);
+      } else if (spins > 64) {
+        std::this_thread::yield();
+      }
+    }
+  }
+};
+
+} // namespace detail
+
+/**
+ * How console_sink hands records to stderr. Both bypass stdio and its lock
+ * and write each record and its newline with a single call, so lines never
+ * interleave with each other or with other writers of fd 2.
+ */
+enum class console_mode {
+  direct,   // every record is its own write(2)
+  combining // concurrent records are joined by one thread into a single write(2)
+};
+
+/**
+ * Console sink for stderr output.
+ */
+class console_sink : public sink {
+  detail::meter_lease meter_{"console"};
+  console_mode mode_ = console_mode::direct;
+  detail::write_combiner combiner_{2};
+
+  void write_records(std::span<const std::string_view> records) {
+    if (mode_ == console_mode::combining) {
+      combiner_.write(records);
+      return;
+    }
+    detail::scratch_buffer joined;
+    detail::join_records(joined.get(), records);
+    detail::write_all(2, joined.get().data(), joined.get().size());
+  }
+
+public:
+  console_sink() = default;
+  explicit console_sink(console_mode mode) : mode_(mode) {}
+
+  void write(std::string_view formatted) override {
+    if (mode_ == console_mode::direct) {
+      const std::string_view parts[] = {formatted, "\n"};
+      detail::write_all(2, parts);
+    } else {
+      write_records({&formatted, 1});
+    }
+    meter_->wrote(formatted.size() + 1);
+  }
+
+  // one write for the whole batch
+  void write_batch(std::span<const std::string_view> records, std::span<const level>) override {
+    write_records(records);
+    std::size_t bytes = 0;
+    for (std::string_view record : records) {
+      bytes += record.size() + 1;
+    }
+    meter_->wrote(bytes);
+  }
+
+  // records go straight to the descriptor; there is nothing buffered to flush
+  void flush() override { meter_->flushed(); }
+};
+
+/**
+ * When a buffered_file_sink hands its buffer to the operating system.
+ *
+ * The buffer is always written when it fills up, on flush() and on
+ * destruction; the remaining triggers are optional. Time and count triggers
+ * are checked as records arrive, so an idle sink keeps its buffer until the
+ * next record or flush().
+ */
+struct flush_policy {
+  std::size_t buffer_size = 256 * 1024;            // bytes held before writing
+  std::chrono::milliseconds interval{1000};        // write once buffered data is this old; zero disables
+  std::size_t max_records = 0;                     // write after this many records; zero disables
+  std::optional<level> flush_level = level::error; // write at once for this severity or worse
+  bool sync = false;                               // fsync after every write of the buffer
+};
+
+/**
+ * File sink with its own write buffer, written with write(2)/writev.
+ *
+ * Records are copied into one large buffer and reach the file in a single
+ * syscall once a flush_policy trigger fires, instead of one stdio call per
+ * record. Oversized records bypass the buffer. Safe to share between threads.
+ * Falls back to stderr if the file cannot be opened.
+ */
+class buffered_file_sink : public sink {
+  int fd_;
+  bool should_close_;
+  flush_policy policy_;
+  std::unique_ptr<char[]> buffer_;
+  std::size_t used_ = 0;
+  std::size_t pending_records_ = 0;
+  std::chrono::steady_clock::time_point oldest_{};
+  std::size_t write_calls_ = 0;
+  detail::meter_lease meter_;
+  mutable std::mutex mutex_;
+
+  // hand buffered bytes, plus an optional unbuffered record, to the file
+  void write_out(std::string_view extra = {}, bool newline = false) {
+    std::string_view parts[] = {std::string_view(buffer_.get(), used_), extra, newline ? "\n" : ""};
+    if (used_ > 0 || !extra.empty()) {
+      detail::write_all(fd_, parts);
+      write_calls_++;
+      meter_->wrote(used_ + extra.size() + (newline ? 1 : 0));
+      if (policy_.sync) {
+        detail::sync_fd(fd_);
+      }
+    }
+    used_ = 0;
+    pending_records_ = 0;
+  }
+
+  bool severe(level lvl) const noexcept {
+    return policy_.flush_level && static_cast<int>(lvl) <= static_cast<int>(*policy_.flush_level);
+  }
+
+  buffered_file_sink(const std::string& filename, flush_policy policy, detail::meter_lease&& meter)
+      : fd_(detail::open_append(filename)), should_close_(fd_ >= 0), policy_(policy), meter_(std::move(meter)) {
+    if (fd_ < 0) {
+      // fallback to stderr if file open fails
+      fd_ = 2;
+    }
+    policy_.buffer_size = std::max<std::size_t>(policy_.buffer_size, 1);
+    buffer_ = std::make_unique<char[]>(policy_.buffer_size);
+  }
+
+public:
+  explicit buffered_file_sink(const std::string& filename, flush_policy policy = {})
+      : buffered_file_sink(filename, policy, "buffered_file") {}
+
+  // stats_name: the sink name redlog::stats() reports this sink's output under ("audit", then "audit.2", ...)
+  buffered_file_sink(const std::string& filename, flush_policy policy, std::string_view stats_name)
+      : buffered_file_sink(filename, policy, detail::meter_lease(stats_name)) {}
+
+  // counted on meter, which must outlive the sink
+  buffered_file_sink(const std::string& filename, flush_policy policy, detail::sink_meter& meter)
+      : buffered_file_sink(filename, policy, detail::meter_lease(meter)) {}
+
+  ~buffered_file_sink() override {
+    flush();
+    if (should_close_) {
+      detail::close_fd(fd_);
+    }
+  }
+
+  buffered_file_sink(const buffered_file_sink&) = delete;
+  buffered_file_sink& operator=(const buffered_file_sink&) = delete;
+
+  void write(std::string_view formatted) override { write_record(level::info, formatted); }
+
+private:
+  // buffer one record, then apply the flush triggers; mutex_ held
+  void append(level lvl, std::string_view bytes, bool newline) {
+    std::size_t needed = bytes.size() + (newline ? 1 : 0);
+
+    if (needed > policy_.buffer_size - used_) {
+      if (needed > policy_.buffer_size) {
+        write_out(bytes, newline); // too large to buffer: one writev with what is pending
+        return;
+      }
+      write_out();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (used_ == 0) {
+      oldest_ = now;
+    }
+    std::memcpy(buffer_.get() + used_, bytes.data(), bytes.size());
+    used_ += bytes.size();
+    if (newline) {
+      buffer_[used_++] = '\n';
+    }
+    pending_records_++;
+
+    if (severe(lvl) || (policy_.max_records > 0 && pending_records_ >= policy_.max_records) ||
+        (policy_.interval.count() > 0 && now - oldest_ >= policy_.interval)) {
+      write_out();
+    }
+  }
+
+protected:
+  // write bytes exactly as given, for sinks with their own record framing
+  void write_bytes(level lvl, std::string_view bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    append(lvl, bytes, false);
+  }
+
+public:
+  void write_record(level lvl, std::string_view formatted) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    append(lvl, formatted, true);
+  }
+
+  // the whole batch under one lock
+  void write_batch(std::span<const std::string_view> records, std::span<const level> levels) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      append(detail::batch_level(levels, i), records[i], true);
+    }
+  }
+
+  void flush() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_out();
+    meter_->flushed();
+  }
+
+  // bytes currently held in the buffer
+  std::size_t buffered() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_;
+  }
+
+  // number of times the buffer was handed to the operating system
+  std::size_t write_calls() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return write_calls_;
+  }
+};
+
+/**
+ * When a rotating_file_sink starts a new file and what it keeps.
+ *
+ * Archives are named file.1 (newest) through file.N. With a compressor set,
+ * each archive is passed through it on a background thread and stored with
+ * compressed_extension appended, e.g. file.1.gz.
+ */
+struct rotation_policy {
+  std::uint64_t max_size = 64ull * 1024 * 1024; // rotate once the file reaches this size; zero disables
+  std::chrono::seconds interval{0};             // rotate when the file is this old; zero disables
+  std::size_t max_files = 5;                    // archives to keep
+
+  // optional compression of a finished archive, e.g. gzip; returns true once `to` is complete
+  std::function<bool(const std::string& from, const std::string& to)> compressor;
+  std::string compressed_extension = ".gz";
+};
+
+/**
+ * File sink that rotates by size and/or age and keeps a fixed number of archives.
+ *
+ * Each segment is written through a buffered_file_sink. The background thread
+ * opens the next segment ahead of time under a staging name, so rotating only
+ * swaps it in under the writer lock; renaming the files into place, flushing
+ * the old segment, shifting archives and compression all happen on that
+ * thread. A writer opens the next segment itself only when rotations come
+ * faster than the thread can prepare them.
+ */
+class rotating_file_sink : public sink {
+  std::string filename_;
+  rotation_policy rotation_;
+  flush_policy flush_;
+  detail::meter_lease meter_{"rotating_file"}; // shared by every segment, so rotations keep one name
+
+  std::mutex mutex_;
+  std::unique_ptr<buffered_file_sink> current_;
+  std::uint64_t current_size_ = 0;
+  std::chrono::system_clock::time_point opened_;
+  std::size_t rotations_ = 0;
+  std::unique_ptr<buffered_file_sink> next_; // opened ahead of time at next_path_
+  std::string next_path_;
+  std::atomic<std::uint64_t> sequence_{0};
+
+  // a rotation the worker has yet to carry out on disk
+  struct retired_segment {
+    std::unique_ptr<buffered_file_sink> sink; // the old segment, no longer written
+    std::string next_path;                    // staging name of the segment that replaced it
+  };
+
+  std::mutex worker_mutex_;
+  std::condition_variable worker_cv_;
+  std::condition_variable idle_cv_;
+  std::vector<retired_segment> retired_;
+  bool want_next_ = true;
+  bool archiving_ = false;
+  bool stopping_ = false;
+  std::thread worker_;
+
+  std::string live_path_; // where the current segment's file is; worker only
+
+  std::string archive_path(std::size_t index, bool compressed) const {
+    std::string path = filename_ + "." + std::to_string(index);
+    if (compressed) {
+      path += rotation_.compressed_extension;
+    }
+    return path;
+  }
+
+  std::string staging_path() { return filename_ + ".next." + std::to_string(++sequence_); }
+
+  bool due(std::size_t incoming) const {
+    if (rotation_.max_size > 0 && current_size_ > 0 && current_size_ + incoming > rotation_.max_size) {
+      return true;
+    }
+    return rotation_.interval.count() > 0 && std::chrono::system_clock::now() - opened_ >= rotation_.interval;
+  }
+
+  // called with mutex_ held; swaps in the prepared segment
+  void rotate() {
+    if (!next_) {
+      next_path_ = staging_path();
+      next_ = std::make_unique<buffered_file_sink>(next_path_, flush_, meter_.get());
+    }
+
+    retired_segment segment{std::move(current_), std::move(next_path_)};
+    current_ = std::move(next_);
+    current_size_ = 0;
+    opened_ = std::chrono::system_clock::now();
+    rotations_++;
+
+    std::lock_guard<std::mutex> lock(worker_mutex_);
+    retired_.push_back(std::move(segment));
+    want_next_ = true;
+    worker_cv_.notify_one();
+  }
+
+  // worker: open the segment the next rotation will swap in
+  void prepare_next() {
+    std::string path = staging_path();
+    auto prepared = std::make_unique<buffered_file_sink>(path, flush_, meter_.get());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (next_) {
+      prepared.reset();
+      std::remove(path.c_str());
+      return;
+    }
+    next_ = std::move(prepared);
+    next_path_ = std::move(path);
+  }
+
+  // worker: move the old segment aside and the new one to filename_, then archive the old one
+  void retire(retired_segment& segment) {
+    std::string aside;
+    if (live_path_ != filename_) {
+      aside = live_path_; // never made it to filename_
+    } else {
+      aside = filename_ + ".rotating." + std::to_string(++sequence_);
+      if (std::rename(filename_.c_str(), aside.c_str()) != 0) {
+        aside.clear(); // the old segment keeps filename_
+      }
+    }
+
+    live_path_ = segment.next_path;
+    if (!aside.empty() && std::rename(segment.next_path.c_str(), filename_.c_str()) == 0) {
+      live_path_ = filename_;
+    }
+
+    if (aside.empty()) {
+      segment.sink.reset();
+      return;
+    }
+    archive(segment.sink, aside);
+  }
+
+  void archive(std::unique_ptr<buffered_file_sink>& old, const std::string& path) {
+    old.reset(); // flushes and closes the old segment
+
+    if (rotation_.max_files == 0) {
+      std::remove(path.c_str());
+      return;
+    }
+
+    for (bool compressed : {false, true}) {
+      std::remove(archive_path(rotation_.max_files, compressed).c_str());
+      for (std::size_t i = rotation_.max_files - 1; i >= 1; --i) {
+        std::rename(archive_path(i, compressed).c_str(), archive_path(i + 1, compressed).c_str());
+      }
+    }
+
+    std::string newest = archive_path(1, false);
+    std::rename(path.c_str(), newest.c_str());
+
+    if (rotation_.compressor) {
+      try {
+        if (rotation_.compressor(newest, archive_path(1, true))) {
+          std::remove(newest.c_str());
+        }
+      } catch (...) {
+        // leave the archive uncompressed
+      }
+    }
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(worker_mutex_);
+    for (;;) {
+      worker_cv_.wait(lock, [this] { return stopping_ || !retired_.empty() || want_next_; });
+      if (stopping_ && retired_.empty()) {
+        return;
+      }
+
+      std::vector<retired_segment> batch;
+      batch.swap(retired_);
+      bool prepare = want_next_ && !stopping_;
+      want_next_ = false;
+      archiving_ = true;
+      lock.unlock();
+      for (auto& segment : batch) {
+        retire(segment);
+      }
+      if (prepare) {
+        prepare_next();
+      }
+      lock.lock();
+      archiving_ = false;
+      idle_cv_.notify_all();
+    }
+  }
+
+public:
+  explicit rotating_file_sink(std::string filename, rotation_policy rotation = {}, flush_policy flush = {})
+      : filename_(std::move(filename)), rotation_(std::move(rotation)), flush_(flush), live_path_(filename_) {
+    current_ = std::make_unique<buffered_file_sink>(filename_, flush_, meter_.get());
+    current_size_ = detail::file_size(filename_);
+    opened_ = std::chrono::system_clock::now();
+    worker_ = std::thread([this] { run(); });
+  }
+
+  ~rotating_file_sink() override {
+    {
+      std::lock_guard<std::mutex> lock(worker_mutex_);
+      stopping_ = true;
+      worker_cv_.notify_one();
+    }
+    worker_.join();
+    if (next_) {
+      next_.reset();
+      std::remove(next_path_.c_str());
+    }
+  }
+
+  rotating_file_sink(const rotating_file_sink&) = delete;
+  rotating_file_sink& operator=(const rotating_file_sink&) = delete;
+
+  void write(std::string_view formatted) override { write_record(level::info, formatted); }
+
+  void write_record(level lvl, std::string_view formatted) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t incoming = formatted.size() + 1;
+    if (due(incoming)) {
+      rotate();
+    }
+    current_->write_record(lvl, formatted);
+    current_size_ += incoming;
+  }
+
+  void flush() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_->flush();
+  }
+
+  /**
+   * Block until every rotated segment has been archived (and compressed).
+   */
+  void wait_for_archives() {
+    std::unique_lock<std::mutex> lock(worker_mutex_);
+    idle_cv_.wait(lock, [this] { return retired_.empty() && !archiving_; });
+  }
+
+  // number of rotations performed so far
+  std::size_t rotations() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rotations_;
+  }
+};
+
+#ifndef _WIN32
+/**
+ * Mapping and persistence settings for mmap_file_sink.
+ */
+struct mmap_policy {
+  std::size_t segment_size = 64 * 1024 * 1024; // bytes mapped at a time, rounded up to whole pages
+  std::chrono::milliseconds sync_interval{0};  // msync(MS_ASYNC) at most this often; zero leaves it to the kernel
+};
+
+/**
+ * File sink that copies records straight into a shared memory mapping.
+ *
+ * Writers reserve space with one atomic add on the mapped segment's offset and
+ * memcpy the record in; there is no lock and no syscall per record. When a
+ * segment fills, the writer whose record crosses its end maps the next part
+ * of the file and everyone else moves on to it. Mapped pages belong to the
+ * page cache, so records survive a crash of the process without flush();
+ * flush() forces them to disk. The file is trimmed to its written length on
+ * destruction; after a crash, the zero-filled tail is dropped when the file is
+ * opened again. POSIX only; if the file cannot be mapped records go to stderr.
+ */
+class mmap_file_sink : public sink {
+  struct segment {
+    char* base = nullptr;
+    std::size_t size = 0;
+    std::uint64_t file_offset = 0;
+    std::atomic<std::size_t> offset{0};
+    std::atomic<int> writers{0};
+    bool mapped = false;
+  };
+
+  int fd_ = -1;
+  mmap_policy policy_;
+  std::size_t page_size_;
+  std::atomic<segment*> current_{nullptr};
+  std::atomic<std::int64_t> last_sync_{0};
+  std::mutex mutex_; // serializes mapping changes
+  std::vector<std::unique_ptr<segment>> segments_;
+  detail::meter_lease meter_{"mmap_file"};
+
+  std::size_t round_to_pages(std::size_t size) const { return (size + page_size_ - 1) / page_size_ * page_size_; }
+
+  // map [file_offset, file_offset + size), growing the file to cover it; mutex_ held
+  segment* map_segment(std::uint64_t file_offset, std::size_t size, std::size_t start) {
+    if (::ftruncate(fd_, static_cast<off_t>(file_offset + size)) != 0) {
+      return nullptr;
+    }
+    void* base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, static_cast<off_t>(file_offset));
+    if (base == MAP_FAILED) {
+      return nullptr;
+    }
+
+    auto mapped = std::make_unique<segment>();
+    mapped->base = static_cast<char*>(base);
+    mapped->size = size;
+    mapped->file_offset = file_offset;
+    mapped->offset.store(start);
+    mapped->mapped = true;
+    segments_.push_back(std::move(mapped));
+    return segments_.back().get();
+  }
+
+  // unmap replaced segments nobody is writing to; the bookkeeping stays until destruction. mutex_ held
+  void reclaim() {
+    segment* live = current_.load();
+    for (auto& old : segments_) {
+      if (old.get() != live && old->mapped && old->writers.load() == 0) {
+        ::munmap(old->base, old->size);
+        old->mapped = false;
+      }
+    }
+  }
+
+  // pin the current segment; null once mapping has failed
+  segment* acquire() {
+    for (;;) {
+      segment* seg = current_.load();
+      if (!seg) {
+        return nullptr;
+      }
+      seg->writers.fetch_add(1);
+      if (current_.load() == seg) {
+        return seg;
+      }
+      seg->writers.fetch_sub(1);
+    }
+  }
+
+  // copy bytes [from, to) of the record and its trailing newline
+  static void copy_record(char* dst, std::string_view text, std::size_t from, std::size_t to) {
+    if (from < text.size()) {
+      std::size_t end = std::min(to, text.size());
+      std::memcpy(dst, text.data() + from, end - from);
+      dst += end - from;
+    }
+    if (to > text.size()) {
+      *dst = '\n';
+    }
+  }
+
+  // the record crossing the end of seg wrote its first `head` bytes; map the next segment for the rest
+  void roll(segment* seg, std::string_view text, std::size_t head) {
+    std::size_t needed = text.size() + 1;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::size_t size = std::max(policy_.segment_size, round_to_pages(needed - head));
+    segment* next = map_segment(seg->file_offset + seg->size, size, needed - head);
+    if (next) {
+      next->writers.store(1);
+    }
+    current_.store(next);
+    seg->writers.fetch_sub(1);
+    reclaim();
+
+    if (next) {
+      copy_record(next->base, text, head, needed);
+      next->writers.fetch_sub(1);
+    }
+  }
+
+  void maybe_sync(segment* seg) {
+    if (policy_.sync_interval.count() <= 0) {
+      return;
+    }
+    std::int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+    std::int64_t last = last_sync_.load(std::memory_order_relaxed);
+    if (now - last >= policy_.sync_interval.count() && last_sync_.compare_exchange_strong(last, now)) {
+      ::msync(seg->base, seg->size, MS_ASYNC);
+    }
+  }
+
+  static void write_fallback(std::string_view formatted) {
+    std::string_view parts[] = {formatted, "\n"};
+    detail::write_all(2, parts);
+  }
+
+  // length of the file without the zero-filled tail a crash leaves past the last record
+  static std::uint64_t written_length(int fd, std::uint64_t size) {
+    char chunk[4096];
+    while (size > 0) {
+      std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(size, sizeof(chunk)));
+      ssize_t got = ::pread(fd, chunk, count, static_cast<off_t>(size - count));
+      if (got != static_cast<ssize_t>(count)) {
+        return size;
+      }
+      for (std::size_t i = count; i > 0; --i) {
+        if (chunk[i - 1] != '\0') {
+          return size - count + i;
+        }
+      }
+      size -= count;
+    }
+    return 0;
+  }
+
+public:
+  explicit mmap_file_sink(const std::string& filename, mmap_policy policy = {})
+      : policy_(policy), page_size_(static_cast<std::size_t>(::sysconf(_SC_PAGESIZE))) {
+    policy_.segment_size = round_to_pages(std::max<std::size_t>(policy_.segment_size, 1));
+    fd_ = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+      return;
+    }
+
+    // continue after existing content; mappings must start on a page boundary
+    std::uint64_t existing = written_length(fd_, detail::file_size(filename));
+    std::uint64_t aligned = existing / page_size_ * page_size_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_.store(map_segment(aligned, policy_.segment_size, static_cast<std::size_t>(existing - aligned)));
+  }
+
+  ~mmap_file_sink() override {
+    if (fd_ < 0) {
+      return;
+    }
+    std::uint64_t end = bytes_written();
+    for (auto& seg : segments_) {
+      if (seg->mapped) {
+        ::munmap(seg->base, seg->size);
+      }
+    }
+    if (!segments_.empty()) {
+      (void) ::ftruncate(fd_, static_cast<off_t>(end));
+    }
+    ::close(fd_);
+  }
+
+  mmap_file_sink(const mmap_file_sink&) = delete;
+  mmap_file_sink& operator=(const mmap_file_sink&) = delete;
+
+  void write(std::string_view formatted) override {
+    std::size_t needed = formatted.size() + 1;
+    meter_->wrote(needed);
+    for (;;) {
+      segment* seg = acquire();
+      if (!seg) {
+        write_fallback(formatted);
+        return;
+      }
+
+      std::size_t start = seg->offset.fetch_add(needed);
+      if (start + needed <= seg->size) {
+        copy_record(seg->base + start, formatted, 0, needed);
+        maybe_sync(seg);
+        seg->writers.fetch_sub(1);
+        return;
+      }
+      if (start <= seg->size) {
+        std::size_t head = seg->size - start;
+        copy_record(seg->base + start, formatted, 0, head);
+        roll(seg, formatted, head);
+        return;
+      }
+
+      // another writer is mapping the next segment
+      seg->writers.fetch_sub(1);
+      while (current_.load() == seg) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // write every record so far out to the file, including segments already replaced
+  void flush() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& seg : segments_) {
+      if (seg->mapped) {
+        ::msync(seg->base, seg->size, MS_SYNC);
+      }
+    }
+    if (fd_ >= 0) {
+      ::fsync(fd_); // pages of segments already unmapped
+    }
+    meter_->flushed();
+  }
+
+  // length of the log file as it will be once trimmed
+  std::uint64_t bytes_written() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (segments_.empty()) {
+      return 0;
+    }
+    const segment& last = *segments_.back();
+    return last.file_offset + std::min(last.offset.load(), last.size);
+  }
+};
+#endif
+
+/**
+ * Compact binary log encoding, written by binary_sink and read back by
+ * binary_reader (and the redlog-decode tool).
+ *
+ *   stream   := item*
+ *   item     := header | define | text | format
+ *   header   := "RLOG" version:u8              (starts a session; resets ids and time)
+ *   define   := 0x01 id:varint string          (ids count up from 1 per session)
+ *   text     := 0x02 head message:string fields
+ *   format   := 0x03 head format:ref nargs:varint value* fields
+ *   head     := dt:svarint level:u8 source:ref   (dt = nanoseconds since the previous record)
+ *   fields   := count:varint (key:ref value)*
+ *   ref      := id:varint | 0 string            (0 = not interned, string follows)
+ *   value    := kind:u8 payload                 (arg_value::kind; integers as (s)varint,
+ *                                                float64 as 8 little-endian bytes, strings inline)
+ *   string   := length:varint bytes
+ *
+ * binary_formatter emits one self-contained entry per record instead:
+ *
+ *   entry    := 0x00 time:svarint level:u8 source:string message:string count:varint (key:string value)*
+ *
+ * with time in nanoseconds since the epoch; binary_sink transcodes these into
+ * the stream form above.
+ */
+namespace binary_format {
+inline constexpr std::string_view magic = "RLOG";
+inline constexpr std::uint8_t version = 1;
+
+inline constexpr std::uint8_t entry_tag = 0x00;
+inline constexpr std::uint8_t define_tag = 0x01;
+inline constexpr std::uint8_t text_tag = 0x02;
+inline constexpr std::uint8_t format_tag = 0x03;
+} // namespace binary_format
+
+namespace detail {
+
+inline void put_varint(fmt_buffer& out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+inline std::uint64_t zigzag(std::int64_t value) noexcept {
+  return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+inline std::int64_t unzigzag(std::uint64_t value) noexcept {
+  return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+inline void put_string(fmt_buffer& out, std::string_view text) {
+  put_varint(out, text.size());
+  out.append(text);
+}
+
+inline void put_value(fmt_buffer& out, const arg_value& value) {
+  using kind = arg_value::kind;
+  out.push_back(static_cast<char>(value.type));
+  switch (value.type) {
+  case kind::character:
+  case kind::signed_char:
+  case kind::int16:
+  case kind::int32:
+  case kind::int64:
+    put_varint(out, zigzag(value.number.i));
+    break;
+  case kind::float64: {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value.number.d, sizeof(bits));
+    for (int i = 0; i < 8; ++i) {
+      out.push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+    }
+    break;
+  }
+  case kind::string:
+    put_string(out, value.text);
+    break;
+  case kind::null_string:
+    break;
+  default:
+    put_varint(out, value.number.u);
+    break;
+  }
+}
+
+// field values keep their type; custom values are stored as their text
+inline void put_field_value(fmt_buffer& out, const field_value& value) {
+  using kind = field_value::kind;
+  switch (value.type()) {
+  case kind::int64:
+    put_value(out, arg_value::from(value.as_int64()));
+    break;
+  case kind::uint64:
+    put_value(out, arg_value::from(value.as_uint64()));
+    break;
+  case kind::float64:
+    put_value(out, arg_value::from(value.as_double()));
+    break;
+  case kind::boolean:
+    put_value(out, arg_value::from(value.as_bool()));
+    break;
+  case kind::custom: {
+    fmt_buffer text;
+    value.format_to(text);
+    put_value(out, arg_value::from(text.view()));
+    break;
+  }
+  default:
+    put_value(out, arg_value::from(value.text()));
+    break;
+  }
+}
+
+// decoded field value with the type it was written with
+inline field_value decoded_field_value(const arg_value& value) {
+  using kind = arg_value::kind;
+  switch (value.type) {
+  case kind::boolean:
+    return field_value(value.number.u != 0);
+  case kind::character:
+  case kind::signed_char:
+  case kind::int16:
+  case kind::int32:
+  case kind::int64:
+    return field_value(value.number.i);
+  case kind::unsigned_char:
+  case kind::uint16:
+  case kind::uint32:
+  case kind::uint64:
+    return field_value(value.number.u);
+  case kind::float64:
+    return field_value(value.number.d);
+  case kind::string:
+    return field_value(value.text);
+  default: {
+    fmt_buffer text;
+    format_spec_info spec;
+    format_state state;
+    value.format(text, spec, state);
+    return field_value(text.view());
+  }
+  }
+}
+
+// bounds-checked reader over encoded bytes; any failure clears ok
+struct binary_cursor {
+  std::string_view data;
+  std::size_t pos = 0;
+  bool ok = true;
+
+  bool at_end() const noexcept { return pos >= data.size(); }
+
+  std::uint8_t byte() {
+    if (pos >= data.size()) {
+      ok = false;
+      return 0;
+    }
+    return static_cast<std::uint8_t>(data[pos++]);
+  }
+
+  std::uint64_t varint() {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      std::uint8_t next = byte();
+      value |= static_cast<std::uint64_t>(next & 0x7f) << shift;
+      if (!(next & 0x80)) {
+        return value;
+      }
+    }
+    ok = false;
+    return 0;
+  }
+
+  std::string_view raw(std::uint64_t length) {
+    if (length > data.size() - std::min(pos, data.size())) {
+      ok = false;
+      return {};
+    }
+    std::string_view result = data.substr(pos, static_cast<std::size_t>(length));
+    pos += static_cast<std::size_t>(length);
+    return result;
+  }
+
+  std::string_view string() { return raw(varint()); }
+
+  arg_value value() {
+    using kind = arg_value::kind;
+    arg_value result;
+    std::uint8_t tag = byte();
+    if (tag > static_cast<std::uint8_t>(kind::null_string)) {
+      ok = false;
+      return result;
+    }
+    result.type = static_cast<kind>(tag);
+    switch (result.type) {
+    case kind::character:
+    case kind::signed_char:
+    case kind::int16:
+    case kind::int32:
+    case kind::int64:
+      result.number.i = unzigzag(varint());
+      break;
+    case kind::float64: {
+      std::uint64_t bits = 0;
+      for (int i = 0; i < 8; ++i) {
+        bits |= static_cast<std::uint64_t>(byte()) << (8 * i);
+      }
+      std::memcpy(&result.number.d, &bits, sizeof(bits));
+      break;
+    }
+    case kind::string:
+      result.text = string();
+      break;
+    case kind::null_string:
+      break;
+    default:
+      result.number.u = varint();
+      break;
+    }
+    return result;
+  }
+};
+
+} // namespace detail
+
+/**
+ * Formatter that encodes each record as a self-contained binary entry.
+ *
+ * Meant to be paired with binary_sink, which interns the repeated strings
+ * and stores timestamps as deltas; other sinks need their own framing.
+ */
+class binary_formatter : public formatter {
+public:
+  std::string format(const log_entry& entry) const override {
+    detail::fmt_buffer out;
+    format_to(out, entry);
+    return out.str();
+  }
+
+  void format_to(detail::fmt_buffer& out, const log_entry& entry) const override {
+    out.push_back(static_cast<char>(binary_format::entry_tag));
+    detail::put_varint(out, detail::zigzag(detail::to_nanoseconds(entry.timestamp)));
+    out.push_back(static_cast<char>(entry.level_val));
+    detail::put_string(out, entry.source);
+    detail::put_string(out, entry.message);
+    detail::put_varint(out, entry.fields.size());
+    for (const auto& f : entry.fields) {
+      detail::put_string(out, f.key);
+      detail::put_field_value(out, f.value);
+    }
+  }
+
+  static bool is_entry(std::string_view bytes) noexcept {
+    return !bytes.empty() && static_cast<std::uint8_t>(bytes.front()) == binary_format::entry_tag;
+  }
+};
+
+/**
+ * One record read back from a binary log.
+ */
+struct binary_record {
+  level level_val = level::info;
+  std::chrono::system_clock::time_point timestamp;
+  std::string source;
+  std::string message;
+  std::string format; // printf format for records stored unformatted, otherwise empty
+  field_set fields;
+
+  // view for passing the record to a formatter
+  log_entry entry() const { return log_entry(level_val, message, source, field_view(fields), timestamp); }
+};
+
+/**
+ * Sink writing the compact binary stream described in binary_format.
+ *
+ * Sources, format strings and field keys are interned per session and
+ * timestamps are stored as deltas. printf-style calls with plain arguments
+ * arrive here unformatted and are stored as format id plus typed arguments;
+ * other records should come from a binary_formatter (anything else is kept
+ * as a plain text record). Buffering follows the given flush_policy.
+ */
+class binary_sink : public buffered_file_sink {
+  static constexpr std::size_t max_interned = 1 << 16;
+  static constexpr std::size_t max_arguments = 32;
+
+  struct string_hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view text) const noexcept { return std::hash<std::string_view>{}(text); }
+  };
+
+  std::mutex encoder_mutex_;
+  std::unordered_map<std::string, std::uint64_t, string_hash, std::equal_to<>> ids_;
+  std::int64_t last_time_ = 0;
+  detail::fmt_buffer defines_;
+  detail::fmt_buffer body_;
+
+  // reference an interned string, defining it first if needed; encoder_mutex_ held
+  void put_ref(std::string_view text) {
+    auto found = ids_.find(text);
+    if (found != ids_.end()) {
+      detail::put_varint(body_, found->second);
+      return;
+    }
+    if (ids_.size() >= max_interned) {
+      detail::put_varint(body_, 0);
+      detail::put_string(body_, text);
+      return;
+    }
+
+    std::uint64_t id = ids_.size() + 1;
+    ids_.emplace(std::string(text), id);
+    defines_.push_back(static_cast<char>(binary_format::define_tag));
+    detail::put_varint(defines_, id);
+    detail::put_string(defines_, text);
+    detail::put_varint(body_, id);
+  }
+
+  void put_head(std::uint8_t tag, std::int64_t time, level lvl, std::string_view source) {
+    defines_.clear();
+    body_.clear();
+    body_.push_back(static_cast<char>(tag));
+    detail::put_varint(body_, detail::zigzag(time - last_time_));
+    last_time_ = time;
+    body_.push_back(static_cast<char>(lvl));
+    put_ref(source);
+  }
+
+  void put_fields(const field_view& fields) {
+    detail::put_varint(body_, fields.size());
+    for (const auto& f : fields) {
+      put_ref(f.key);
+      detail::put_field_value(body_, f.value);
+    }
+  }
+
+  void emit(level lvl) {
+    defines_.append(body_.view());
+    write_bytes(lvl, defines_.view());
+  }
+
+  // re-encode a binary_formatter entry against the session tables; encoder_mutex_ held
+  bool transcode(std::string_view bytes) {
+    detail::binary_cursor in{bytes};
+    in.byte();
+    std::int64_t time = detail::unzigzag(in.varint());
+    auto lvl = static_cast<level>(in.byte());
+    std::string_view source = in.string();
+    std::string_view message = in.string();
+    if (!in.ok) {
+      return false;
+    }
+
+    put_head(binary_format::text_tag, time, lvl, source);
+    detail::put_string(body_, message);
+    std::uint64_t count = in.varint();
+    detail::put_varint(body_, count);
+    for (std::uint64_t i = 0; i < count && in.ok; ++i) {
+      put_ref(in.string());
+      detail::put_value(body_, in.value());
+    }
+    if (!in.ok) {
+      return false;
+    }
+    emit(lvl);
+    return true;
+  }
+
+public:
+  explicit binary_sink(const std::string& filename, flush_policy policy = {})
+      : buffered_file_sink(filename, policy, "binary") {
+    detail::fmt_buffer header;
+    header.append(binary_format::magic);
+    header.push_back(static_cast<char>(binary_format::version));
+    write_bytes(level::info, header.view());
+  }
+
+  void write(std::string_view formatted) override { write_record(level::info, formatted); }
+
+  void write_record(level lvl, std::string_view formatted) override {
+    std::lock_guard<std::mutex> lock(encoder_mutex_);
+    if (binary_formatter::is_entry(formatted) && transcode(formatted)) {
+      return;
+    }
+    put_head(binary_format::text_tag, detail::to_nanoseconds(std::chrono::system_clock::now()), lvl, "");
+    detail::put_string(body_, formatted);
+    detail::put_varint(body_, 0);
+    emit(lvl);
+  }
+
+  // each record is transcoded; buffered_file_sink's batch path would copy the entries raw
+  void write_batch(std::span<const std::string_view> records, std::span<const level> levels) override {
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      write_record(detail::batch_level(levels, i), records[i]);
+    }
+  }
+
+  // printf-style calls are stored unformatted
+  bool accepts_deferred() const noexcept override { return true; }
+
+  void write_deferred(detail::deferred_record&& record) override {
+    std::string_view format;
+    std::array<detail::arg_value, max_arguments> args;
+    std::size_t count = record.arguments(format, args);
+    if (count > args.size()) {
+      write_record(record.level_val, record.materialize());
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(encoder_mutex_);
+    std::int64_t time = detail::to_nanoseconds(record.timestamp);
+    put_head(binary_format::format_tag, time, record.level_val, record.context->name);
+    put_ref(format);
+    detail::put_varint(body_, count);
+    for (std::size_t i = 0; i < count; ++i) {
+      detail::put_value(body_, args[i]);
+    }
+    put_fields(record.context->view());
+    emit(record.level_val);
+  }
+};
+
+/**
+ * Reads records back from a binary_sink stream held in memory.
+ */
+class binary_reader {
+  detail::binary_cursor in_;
+  std::vector<std::string> strings_;
+  std::int64_t last_time_ = 0;
+  std::string error_;
+
+  bool fail(std::string message) {
+    error_ = std::move(message) + " at offset " + std::to_string(in_.pos);
+    return false;
+  }
+
+  std::string_view ref() {
+    std::uint64_t id = in_.varint();
+    if (id == 0) {
+      return in_.string();
+    }
+    if (id > strings_.size()) {
+      in_.ok = false;
+      return {};
+    }
+    return strings_[static_cast<std::size_t>(id - 1)];
+  }
+
+  void read_fields(binary_record& out) {
+    std::uint64_t count = in_.varint();
+    for (std::uint64_t i = 0; i < count && in_.ok; ++i) {
+      std::string_view key = ref();
+      detail::arg_value value = in_.value();
+      out.fields.add(field(key, detail::decoded_field_value(value)));
+    }
+  }
+
+public:
+  explicit binary_reader(std::string_view data) : in_{data} {}
+
+  /**
+   * Decode the next record. Returns false at the end of the data or on a
+   * malformed stream, in which case error() says what went wrong.
+   */
+  bool next(binary_record& out) {
+    while (!in_.at_end()) {
+      std::uint8_t tag = in_.byte();
+
+      if (tag == static_cast<std::uint8_t>(binary_format::magic.front())) {
+        std::string_view rest = in_.raw(binary_format::magic.size());
+        if (!in_.ok || rest.substr(0, 3) != binary_format::magic.substr(1) ||
+            static_cast<std::uint8_t>(rest[3]) != binary_format::version) {
+          return fail("bad header");
+        }
+        strings_.clear();
+        last_time_ = 0;
+        continue;
+      }
+
+      if (tag == binary_format::define_tag) {
+        std::uint64_t id = in_.varint();
+        std::string_view text = in_.string();
+        if (!in_.ok || id != strings_.size() + 1) {
+          return fail("bad string definition");
+        }
+        strings_.emplace_back(text);
+        continue;
+      }
+
+      if (tag != binary_format::text_tag && tag != binary_format::format_tag) {
+        return fail("unknown record tag " + std::to_string(tag));
+      }
+
+      last_time_ += detail::unzigzag(in_.varint());
+      out.timestamp = detail::from_nanoseconds(last_time_);
+      out.level_val = static_cast<level>(in_.byte());
+      out.source = std::string(ref());
+      out.fields = field_set{};
+
+      if (tag == binary_format::text_tag) {
+        out.format.clear();
+        out.message = std::string(in_.string());
+      } else {
+        out.format = std::string(ref());
+        std::uint64_t count = in_.varint();
+        std::vector<detail::arg_value> args;
+        for (std::uint64_t i = 0; i < count && in_.ok; ++i) {
+          args.push_back(in_.value());
+        }
+        detail::fmt_buffer message;
+        detail::stream_printf_to(message, out.format, args);
+        out.message = message.str();
+      }
+
+      read_fields(out);
+      if (!in_.ok) {
+        return fail("truncated record");
+      }
+      return true;
+    }
+    return false;
+  }
+
+  const std::string& error() const noexcept { return error_; }
+};
+
+/**
+ * What an asynchronous sink does when its queue is full.
+ */
+enum class overflow_policy {
+  block,       // wait for the worker to free a slot
+  drop_newest, // discard the record being written
+  drop_oldest  // discard the oldest queued record to make room
+};
+
+namespace detail {
+
+/**
+ * Bounded lock-free multi-producer queue.
+ *
+ * Each cell carries a sequence number that tells producers and consumers
+ * whether it is free or filled for the current lap (vyukov-style), so pushes
+ * and pops never take a lock. Pops are safe from any thread, which lets
+ * producers evict the oldest record under overflow_policy::drop_oldest.
+ */
+template <typename T> class mpsc_ring {
+  struct cell {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  static std::size_t round_up_pow2(std::size_t n) {
+    std::size_t result = 2;
+    while (result < n) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  std::unique_ptr<cell[]> cells_;
+  std::size_t mask_;
+  alignas(64) std::atomic<std::size_t> enqueue_pos_{0};
+  alignas(64) std::atomic<std::size_t> dequeue_pos_{0};
+
+public:
+  explicit mpsc_ring(std::size_t capacity) {
+    std::size_t size = round_up_pow2(capacity);
+    cells_ = std::make_unique<cell[]>(size);
+    mask_ = size - 1;
+    for (std::size_t i = 0; i < size; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  mpsc_ring(const mpsc_ring&) = delete;
+  mpsc_ring& operator=(const mpsc_ring&) = delete;
+
+  std::size_t capacity() const noexcept { return mask_ + 1; }
+
+  bool try_push(T&& value) {
+    std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell& c = cells_[pos & mask_];
+      std::size_t seq = c.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          c.value = std::move(value);
+          c.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_pop(T& out) {
+    std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell& c = cells_[pos & mask_];
+      std::size_t seq = c.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          out = std::move(c.value);
+          c.sequence.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // empty
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool empty() const noexcept {
+    return enqueue_pos_.load(std::memory_order_acquire) == dequeue_pos_.load(std::memory_order_acquire);
+  }
+};
+
+// queue element: preformatted text, or a deferred record when render is set
+struct async_record {
+  level level_val = level::info;
+  std::string text;
+  deferred_record deferred;
+};
+
+} // namespace detail
+
+/**
+ * Asynchronous sink that hands records to a background worker thread.
+ *
+ * Producers copy the formatted record into a bounded lock-free queue and
+ * return immediately; the worker drains the queue into the wrapped sink, so
+ * slow disks or terminals no longer stall the logging thread. The wrapped
+ * sink is only ever touched by the worker and does not need to be thread-safe.
+ *
+ * flush() is a barrier: it returns once every record written before the call
+ * has reached the wrapped sink and that sink has been flushed. The destructor
+ * drains the queue, so nothing is lost at exit.
+ */
+class async_sink : public sink {
+  std::shared_ptr<sink> inner_;
+  overflow_policy policy_;
+  detail::mpsc_ring<detail::async_record> queue_;
+
+  std::atomic<std::uint64_t> pushed_{0};
+  std::atomic<std::uint64_t> processed_{0};
+  std::atomic<std::uint64_t> flush_target_{0};   // highest pushed_ count a flush waits for
+  std::atomic<std::uint64_t> flush_requests_{0}; // flush tickets handed out
+  std::atomic<std::uint64_t> flushes_done_{0};   // tickets the worker has completed
+  std::atomic<std::size_t> dropped_{0};
+  detail::queue_gauge gauge_;
+  std::atomic<bool> sleeping_{false};
+  std::atomic<bool> running_{true};
+
+  std::mutex mutex_;
+  std::condition_variable wake_cv_;
+  std::condition_variable done_cv_;
+  std::mutex inner_mutex_; // worker vs. synchronous writes after shutdown
+  std::thread worker_;
+
+  void wake_worker() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_seq_cst)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      wake_cv_.notify_one();
+    }
+  }
+
+  // records handed to the wrapped sink per write_batch call
+  static constexpr std::size_t batch_limit = 64;
+
+  void run() {
+    std::vector<detail::async_record> batch(batch_limit);
+    std::array<std::string_view, batch_limit> views;
+    std::array<level, batch_limit> levels;
+    std::uint64_t handled_flushes = 0;
+
+    for (;;) {
+      bool drained_any = false;
+      for (;;) {
+        std::size_t count = 0;
+        while (count < batch_limit && queue_.try_pop(batch[count])) {
+          count++;
+        }
+        if (count == 0) {
+          break;
+        }
+        gauge_.popped(count);
+        drained_any = true;
+        try {
+          // deferred records stay deferred for a sink that takes them, and are formatted here otherwise
+          bool forward = inner_->accepts_deferred();
+          if (!forward) {
+            for (std::size_t i = 0; i < count; ++i) {
+              detail::async_record& record = batch[i];
+              if (record.deferred.render) {
+                record.level_val = record.deferred.level_val;
+                record.text = record.deferred.materialize();
+                release(record.deferred);
+              }
+            }
+          }
+
+          std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+          std::size_t pending = 0;
+          for (std::size_t i = 0; i < count; ++i) {
+            detail::async_record& record = batch[i];
+            if (record.deferred.render) {
+              if (pending > 0) {
+                inner_->write_batch(std::span(views.data(), pending), std::span(levels.data(), pending));
+                pending = 0;
+              }
+              inner_->write_deferred(std::move(record.deferred));
+              release(record.deferred);
+              continue;
+            }
+            views[pending] = record.text;
+            levels[pending++] = record.level_val;
+          }
+          if (pending > 0) {
+            inner_->write_batch(std::span(views.data(), pending), std::span(levels.data(), pending));
+          }
+        } catch (...) {
+          // a failing sink must not kill the worker
+        }
+        processed_.fetch_add(count, std::memory_order_release);
+      }
+
+      std::uint64_t requests = flush_requests_.load(std::memory_order_acquire);
+      if (requests != handled_flushes) {
+        // every ticket up to requests raised flush_target_ before it was taken; records pushed
+        // after the drain above may still be below it, so drain again until they are processed
+        if (processed_.load(std::memory_order_acquire) < flush_target_.load(std::memory_order_acquire)) {
+          if (!drained_any) {
+            std::this_thread::yield(); // a drop_oldest producer between its pop and its count
+          }
+          continue;
+        }
+        handled_flushes = requests;
+        try {
+          std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+          inner_->flush();
+        } catch (...) {
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        flushes_done_.store(requests, std::memory_order_release);
+        done_cv_.notify_all();
+      }
+
+      if (drained_any) {
+        continue;
+      }
+      if (!running_.load(std::memory_order_acquire)) {
+        break;
+      }
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      sleeping_.store(true, std::memory_order_seq_cst);
+      wake_cv_.wait_for(lock, std::chrono::milliseconds(50), [this, handled_flushes] {
+        return !queue_.empty() || !running_.load(std::memory_order_acquire) ||
+               flush_requests_.load(std::memory_order_acquire) != handled_flushes;
+      });
+      sleeping_.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  void enqueue(detail::async_record&& record) {
+    while (!queue_.try_push(std::move(record))) {
+      switch (policy_) {
+      case overflow_policy::drop_newest:
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        detail::count_dropped(record_level(record));
+        return;
+      case overflow_policy::drop_oldest: {
+        detail::async_record evicted;
+        if (queue_.try_pop(evicted)) {
+          gauge_.popped(1);
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+          detail::count_dropped(record_level(evicted));
+          processed_.fetch_add(1, std::memory_order_release);
+        }
+        break;
+      }
+      case overflow_policy::block:
+      default:
+        wake_worker();
+        std::this_thread::yield();
+        break;
+      }
+    }
+    gauge_.pushed();
+    pushed_.fetch_add(1, std::memory_order_release);
+    wake_worker();
+  }
+
+  // raise flush_target_ to everything pushed so far, then take a ticket; returns the ticket
+  std::uint64_t request_flush() {
+    std::uint64_t target = pushed_.load(std::memory_order_acquire);
+    std::uint64_t current = flush_target_.load(std::memory_order_relaxed);
+    while (current < target) {
+      if (flush_target_.compare_exchange_weak(current, target, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    return flush_requests_.fetch_add(1, std::memory_order_acq_rel) + 1;
+  }
+
+  // drop what a handled deferred record still references
+  static void release(detail::deferred_record& deferred) noexcept {
+    deferred.render = nullptr;
+    deferred.context.reset();
+    deferred.fmt.reset();
+  }
+
+  static level record_level(const detail::async_record& record) noexcept {
+    return record.deferred.render ? record.deferred.level_val : record.level_val;
+  }
+
+public:
+  /**
+   * Wrap a sink. Capacity is rounded up to a power of two. The name labels
+   * the queue in redlog::stats(); give each queue its own to keep them apart.
+   */
+  explicit async_sink(
+      std::shared_ptr<sink> inner, std::size_t queue_capacity = 8192, overflow_policy policy = overflow_policy::block,
+      std::string_view name = "async"
+  )
+      : inner_(std::move(inner)), policy_(policy), queue_(queue_capacity) {
+    gauge_.capacity = queue_.capacity();
+    detail::stats_registry::instance().add_queue(&gauge_, name);
+    worker_ = std::thread([this] { run(); });
+  }
+
+  ~async_sink() override {
+    shutdown();
+    detail::stats_registry::instance().remove_queue(&gauge_);
+  }
+
+  async_sink(const async_sink&) = delete;
+  async_sink& operator=(const async_sink&) = delete;
+
+  void write(std::string_view formatted) override { write_record(level::info, formatted); }
+
+  void write_record(level lvl, std::string_view formatted) override {
+    if (!running_.load(std::memory_order_acquire)) {
+      // after shutdown, degrade to synchronous writes; the worker may still be draining
+      std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+      inner_->write_record(lvl, formatted);
+      return;
+    }
+    detail::async_record record;
+    record.level_val = lvl;
+    record.text.assign(formatted);
+    enqueue(std::move(record));
+  }
+
+  void write_batch(std::span<const std::string_view> records, std::span<const level> levels) override {
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      write_record(detail::batch_level(levels, i), records[i]);
+    }
+  }
+
+  // deferred records are formatted on the worker thread
+  bool accepts_deferred() const noexcept override { return running_.load(std::memory_order_acquire); }
+
+  void write_deferred(detail::deferred_record&& deferred) override {
+    if (!running_.load(std::memory_order_acquire)) {
+      std::string text = deferred.materialize();
+      std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+      inner_->write_record(deferred.level_val, text);
+      return;
+    }
+    detail::async_record record;
+    record.deferred = std::move(deferred);
+    enqueue(std::move(record));
+  }
+
+  /**
+   * Block until all previously written records reached the wrapped sink.
+   */
+  void flush() override {
+    if (!worker_.joinable()) {
+      std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+      inner_->flush();
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::uint64_t ticket = request_flush();
+    wake_cv_.notify_one();
+    done_cv_.wait(lock, [this, ticket] { return flushes_done_.load(std::memory_order_acquire) >= ticket; });
+  }
+
+  /**
+   * Drain the queue, flush the wrapped sink and stop the worker thread.
+   * Safe to call more than once.
+   */
+  void shutdown() {
+    if (!worker_.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_.store(false, std::memory_order_release);
+      request_flush();
+      wake_cv_.notify_one();
+    }
+    worker_.join();
+
+    // producers that saw running_ before it was cleared may have pushed after the worker's last drain
+    detail::async_record record;
+    std::lock_guard<std::mutex> inner_lock(inner_mutex_);
+    while (queue_.try_pop(record)) {
+      gauge_.popped(1);
+      try {
+        if (record.deferred.render && inner_->accepts_deferred()) {
+          inner_->write_deferred(std::move(record.deferred));
+        } else if (record.deferred.render) {
+          inner_->write_record(record.deferred.level_val, record.deferred.materialize());
+        } else {
+          inner_->write_record(record.level_val, record.text);
+        }
+      } catch (...) {
+      }
+      processed_.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+  // number of records discarded under a drop policy
+  std::size_t dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+  std::size_t capacity() const noexcept { return queue_.capacity(); }
+};
+
+/**
+ * Fan-out sink: sends each record to several sinks, each with its own
+ * minimum level and, optionally, its own formatter.
+ *
+ * A record is formatted once per distinct formatter rather than once per
+ * sink; routes without a formatter share the logger's. Routes added with
+ * add_queued_sink() write through a private async_sink, so a slow destination
+ * (network, disk) cannot stall the others.
+ *
+ * Routes can be added and removed while logging runs: the route list is an
+ * immutable snapshot swapped atomically. Each write holds a reference to the
+ * list it loaded, so a removed sink (and the queue and worker of a queued
+ * route) is released as soon as the last record writing to it is done.
+ */
+class dist_sink : public sink {
+  struct route {
+    std::shared_ptr<sink> origin; // the sink as added, used by remove_sink
+    std::shared_ptr<sink> target; // origin, or the async_sink wrapping it
+    level min_level;
+    std::shared_ptr<formatter> fmt; // null: the logger's formatter
+  };
+  using route_list = std::vector<route>;
+
+  std::mutex update_mutex_;
+  std::atomic<std::shared_ptr<const route_list>> routes_;
+
+  std::shared_ptr<const route_list> routes() const noexcept { return routes_.load(std::memory_order_acquire); }
+
+  template <typename Fn> void update(Fn&& edit) {
+    std::shared_ptr<const route_list> replaced; // released after the lock, in case a removed sink's destructor logs
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    replaced = routes();
+    route_list next = *replaced;
+    std::forward<Fn>(edit)(next);
+    publish(next);
+  }
+
+  // called with update_mutex_ held, or from the constructor
+  void publish(const route_list& next) {
+    // keep routes sharing a formatter adjacent, in order of first appearance
+    route_list grouped;
+    grouped.reserve(next.size());
+    for (std::size_t i = 0; i < next.size(); ++i) {
+      bool seen = false;
+      for (std::size_t j = 0; j < i && !seen; ++j) {
+        seen = next[j].fmt == next[i].fmt;
+      }
+      if (seen) {
+        continue;
+      }
+      for (std::size_t j = i; j < next.size(); ++j) {
+        if (next[j].fmt == next[i].fmt) {
+          grouped.push_back(next[j]);
+        }
+      }
+    }
+
+    routes_.store(std::make_shared<const route_list>(std::move(grouped)), std::memory_order_release);
+  }
+
+  static bool passes(const route& r, level lvl) noexcept {
+    return static_cast<int>(lvl) <= static_cast<int>(r.min_level);
+  }
+
+public:
+  dist_sink() { publish(route_list{}); }
+
+  dist_sink(const dist_sink&) = delete;
+  dist_sink& operator=(const dist_sink&) = delete;
+
+  /**
+   * Add a route receiving records at min_level and more severe. Without a
+   * formatter the records are formatted with the logger's formatter.
+   */
+  void
+  add_sink(std::shared_ptr<sink> target, level min_level = level::annoying, std::shared_ptr<formatter> fmt = nullptr) {
+    update([&](route_list& list) { list.push_back(route{target, target, min_level, std::move(fmt)}); });
+  }
+
+  /**
+   * Add a route that writes through its own queue and worker thread; name
+   * labels the queue in redlog::stats().
+   */
+  void add_queued_sink(
+      std::shared_ptr<sink> target, level min_level = level::annoying, std::shared_ptr<formatter> fmt = nullptr,
+      std::size_t queue_capacity = 8192, overflow_policy policy = overflow_policy::block,
+      std::string_view name = "dist"
+  ) {
+    auto queued = std::make_shared<async_sink>(target, queue_capacity, policy, name);
+    update([&](route_list& list) { list.push_back(route{target, std::move(queued), min_level, std::move(fmt)}); });
+  }
+
+  // remove every route added for target
+  void remove_sink(const std::shared_ptr<sink>& target) {
+    update([&](route_list& list) {
+      list.erase(
+          std::remove_if(list.begin(), list.end(), [&](const route& r) { return r.origin == target; }), list.end()
+      );
+    });
+  }
+
+  std::size_t size() const noexcept { return routes()->size(); }
+
+  void write(std::string_view formatted) override { write_record(level::info, formatted); }
+
+  // already formatted text goes to every route whose level admits it
+  void write_record(level lvl, std::string_view formatted) override {
+    std::shared_ptr<const route_list> list = routes();
+    for (const route& r : *list) {
+      if (passes(r, lvl)) {
+        r.target->write_record(lvl, formatted);
+      }
+    }
+  }
+
+  // routes that admit every record get the batch as a whole
+  void write_batch(std::span<const std::string_view> records, std::span<const level> levels) override {
+    std::shared_ptr<const route_list> list = routes();
+    for (const route& r : *list) {
+      bool all = true;
+      for (std::size_t i = 0; i < records.size() && all; ++i) {
+        all = passes(r, detail::batch_level(levels, i));
+      }
+      if (all) {
+        r.target->write_batch(records, levels);
+        continue;
+      }
+      for (std::size_t i = 0; i < records.size(); ++i) {
+        if (passes(r, detail::batch_level(levels, i))) {
+          r.target->write_record(detail::batch_level(levels, i), records[i]);
+        }
+      }
+    }
+  }
+
+  void write_entry(const log_entry& entry, const formatter& fmt) override {
+    std::shared_ptr<const route_list> list = routes();
+    detail::scratch_buffer formatted;
+    const formatter* rendered = nullptr; // formatter whose output the buffer holds
+    const bool timed = detail::measuring_latency();
+
+    for (const route& r : *list) {
+      if (!passes(r, entry.level_val)) {
+        continue;
+      }
+      std::int64_t start = timed ? detail::steady_ns() : 0;
+      const formatter* wanted = r.fmt ? r.fmt.get() : &fmt;
+      if (wanted != rendered) {
+        formatted.get().clear();
+        wanted->format_to(formatted.get(), entry);
+        rendered = wanted;
+      }
+      std::int64_t formatted_at = timed ? detail::steady_ns() : 0;
+      r.target->write_record(entry.level_val, formatted.view());
+      if (timed) {
+        detail::record_latency(start, formatted_at);
+      }
+    }
+  }
+
+  void flush() override {
+    std::shared_ptr<const route_list> list = routes();
+    for (const route& r : *list) {
+      r.target->flush();
+    }
+  }
+};
+
+#ifndef _WIN32
+
+/**
+ * How network sinks queue, send and retry.
+ *
+ * Records are encoded on the logging thread and sent in batches from a
+ * background thread. A slow or unreachable collector only fills the bounded
+ * queue, which then drops records instead of stalling producers. A batch
+ * that fails to send, or arrives while the sink waits to reconnect, is
+ * dropped as well; both kinds of loss show up in stats().
+ */
+struct network_policy {
+  std::size_t queue_size = 8192;                           // records held for the sender thread
+  overflow_policy overflow = overflow_policy::drop_oldest; // what a full queue gives up; block stalls producers
+  std::chrono::milliseconds timeout{5000};                 // connect, send and response timeout
+  std::chrono::milliseconds retry_min{100};                // wait before reconnecting after a failure
+  std::chrono::milliseconds retry_max{30000};              // the wait doubles per failure up to this
+};
+
+namespace detail {
+
+/**
+ * Client socket used by a single sender thread. Connects on first use; after
+ * a failure it stays closed for a backoff period that doubles with every
+ * failed attempt and resets once a connect succeeds.
+ */
+class network_connection {
+#ifdef MSG_NOSIGNAL
+  static constexpr int send_flags = MSG_NOSIGNAL;
+#else
+  static constexpr int send_flags = 0;
+#endif
+
+  std::string address_; // host name, or socket path when local_
+  std::uint16_t port_;
+  int type_; // SOCK_STREAM or SOCK_DGRAM
+  bool local_;
+  network_policy policy_;
+  int fd_ = -1;
+  std::uint64_t uses_ = 0; // exchanges since the socket was connected
+  std::chrono::milliseconds backoff_{0};
+  std::chrono::steady_clock::time_point retry_at_{};
+
+  void configure(int fd) const noexcept {
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    timeval timeout{};
+    timeout.tv_sec = static_cast<time_t>(policy_.timeout.count() / 1000);
+    timeout.tv_usec = static_cast<suseconds_t>(policy_.timeout.count() % 1000 * 1000);
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)); // also bounds connect() on linux
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+  }
+
+  int open_local() const noexcept {
+    sockaddr_un addr{};
+    if (address_.size() >= sizeof(addr.sun_path)) {
+      return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, address_.data(), address_.size());
+    int fd = ::socket(AF_UNIX, type_, 0);
+    if (fd < 0) {
+      return -1;
+    }
+    configure(fd);
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+      ::close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  int open_remote() const {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = type_;
+    addrinfo* found = nullptr;
+    if (::getaddrinfo(address_.c_str(), std::to_string(port_).c_str(), &hints, &found) != 0) {
+      return -1;
+    }
+    int fd = -1;
+    for (addrinfo* candidate = found; candidate && fd < 0; candidate = candidate->ai_next) {
+      fd = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+      if (fd < 0) {
+        continue;
+      }
+      configure(fd);
+      if (::connect(fd, candidate->ai_addr, candidate->ai_addrlen) != 0) {
+        ::close(fd);
+        fd = -1;
+      }
+    }
+    ::freeaddrinfo(found);
+    return fd;
+  }
+
+public:
+  network_connection(std::string address, std::uint16_t port, int type, bool local, const network_policy& policy)
+      : address_(std::move(address)), port_(port), type_(type), local_(local), policy_(policy) {}
+
+  ~network_connection() { reset(); }
+
+  network_connection(const network_connection&) = delete;
+  network_connection& operator=(const network_connection&) = delete;
+
+  // connected and usable; false while a backoff runs or when connecting failed
+  bool ready() {
+    if (fd_ >= 0) {
+      return true;
+    }
+    if (std::chrono::steady_clock::now() < retry_at_) {
+      return false;
+    }
+    fd_ = local_ ? open_local() : open_remote();
+    if (fd_ < 0) {
+      fail();
+      return false;
+    }
+    uses_ = 0;
+    backoff_ = std::chrono::milliseconds(0);
+    return true;
+  }
+
+  // a socket that has carried an exchange may have been closed by the peer while idle
+  bool reused() const noexcept { return uses_ > 0; }
+  void used() noexcept { uses_++; }
+
+  // close; the next ready() connects again straight away
+  void reset() noexcept {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  // close and hold off the next connect attempt
+  void fail() noexcept {
+    reset();
+    backoff_ = backoff_.count() == 0 ? policy_.retry_min : std::min(backoff_ * 2, policy_.retry_max);
+    retry_at_ = std::chrono::steady_clock::now() + backoff_;
+  }
+
+  bool send_all(std::string_view data) noexcept {
+    while (!data.empty()) {
+      ssize_t sent = ::send(fd_, data.data(), data.size(), send_flags);
+      if (sent < 0 && errno == EINTR) {
+        continue;
+      }
+      if (sent <= 0) {
+        return false;
+      }
+      data.remove_prefix(static_cast<std::size_t>(sent));
+    }
+    return true;
+  }
+
+  // one datagram; all or nothing
+  bool send_datagram(std::string_view data) noexcept {
+    ssize_t sent;
+    do {
+      sent = ::send(fd_, data.data(), data.size(), send_flags);
+    } while (sent < 0 && errno == EINTR);
+    return sent == static_cast<ssize_t>(data.size());
+  }
+
+  // bytes read, 0 at end of stream, negative on error or timeout
+  ssize_t receive(char* buffer, std::size_t size) noexcept {
+    ssize_t got;
+    do {
+      got = ::recv(fd_, buffer, size, 0);
+    } while (got < 0 && errno == EINTR);
+    return got;
+  }
+};
+
+inline void count_dropped(std::span<const level> levels, std::size_t first, std::size_t last) noexcept {
+  for (std::size_t i = first; i < last; ++i) {
+    count_dropped(batch_level(levels, i));
+  }
+}
+
+} // namespace detail
+
+/**
+ * Where a syslog_sink delivers messages.
+ */
+struct syslog_endpoint {
+  enum class transport { udp, tcp, unix_socket };
+
+  transport protocol = transport::unix_socket;
+  std::string address = "/dev/log"; // host name or address, or socket path for unix_socket
+  std::uint16_t port = 514;
+
+  static syslog_endpoint udp(std::string host, std::uint16_t port = 514) {
+    return syslog_endpoint{transport::udp, std::move(host), port};
+  }
+  // messages are framed by octet counting (rfc 6587)
+  static syslog_endpoint tcp(std::string host, std::uint16_t port = 514) {
+    return syslog_endpoint{transport::tcp, std::move(host), port};
+  }
+  static syslog_endpoint unix_socket(std::string path = "/dev/log") {
+    return syslog_endpoint{transport::unix_socket, std::move(path), 0};
+  }
+};
+
+struct syslog_options {
+  std::string app_name;               // APP-NAME; empty writes the nil value "-"
+  int facility = 1;                   // 1 is user-level messages, 16 to 23 are local0 to local7
+  std::string sd_id = "fields@32473"; // structured data element for fields; 32473 is the example enterprise number
+  std::size_t max_message = 8192;     // udp and unix datagrams are cut to this many bytes
+  network_policy network;
+};
+
+namespace detail {
+
+// sends queued syslog messages; runs on the async_sink worker only
+class syslog_transport : public sink {
+  network_connection connection_;
+  bool stream_;
+  std::size_t max_message_;
+  meter_lease meter_{"syslog"};
+
+public:
+  syslog_transport(const syslog_endpoint& endpoint, std::size_t max_message, const network_policy& policy)
+      : connection_(
+            endpoint.address, endpoint.port,
+            endpoint.protocol == syslog_endpoint::transport::tcp ? SOCK_STREAM : SOCK_DGRAM,
+            endpoint.protocol == syslog_endpoint::transport::unix_socket, policy
+        ),
+        stream_(endpoint.protocol == syslog_endpoint::transport::tcp), max_message_(max_message) {}
+
+  void write(std::string_view message) override { write_batch({&message, 1}, {}); }
+
+  void write_batch(std::span<const std::string_view> records, std::span<const level> levels) override {
+    if (!connection_.ready()) {
+      count_dropped(levels, 0, records.size());
+      return;
+    }
+    if (!stream_) {
+      for (std::size_t i = 0; i < records.size(); ++i) {
+        std::string_view message = records[i].substr(0, max_message_);
+        if (!connection_.send_datagram(message)) {
+          connection_.fail();
+          count_dropped(levels, i, records.size());
+          return;
+        }
+        meter_->wrote(message.size());
+      }
+      connection_.used();
+      return;
+    }
+
+    scratch_buffer framed;
+    for (std::string_view record : records) {
+      write_integer(framed.get(), record.size());
+      framed.get().push_back(' ');
+      framed.get().append(record);
+    }
+    bool sent = connection_.send_all(framed.view());
+    if (!sent && connection_.reused()) {
+      connection_.reset();
+      sent = connection_.ready() && connection_.send_all(framed.view());
+    }
+    if (!sent) {
+      connection_.fail();
+      count_dropped(levels, 0, records.size());
+      return;
+    }
+    connection_.used();
+    meter_->wrote(framed.view().size());
+  }
+
+  void flush() override { meter_->flushed(); }
+};
+
+} // namespace detail
+
+/**
+ * Sink that sends rfc 5424 syslog messages over udp, tcp or a unix socket:
+ *
+ *   <14>1 2024-01-02T03:04:05.123456Z host app 4242 db [fields@32473 user="alice" id="7"] login
+ *
+ * The logger name becomes the MSGID and fields become structured data; the
+ * logger's formatter is not used. Messages are sent from a background
+ * thread as described by network_policy, one datagram each or in one
+ * stream write per batch.
+ */
+class syslog_sink : public sink {
+  int facility_;
+  std::string sd_id_;
+  std::string header_; // " HOSTNAME APP-NAME PROCID " after the timestamp
+  async_sink queue_;
+
+  static int severity(level lvl) noexcept {
+    switch (lvl) {
+    case level::critical:
+      return 2;
+    case level::error:
+      return 3;
+    case level::warn:
+      return 4;
+    case level::info:
+      return 6;
+    default:
+      return 7;
+    }
+  }
+
+  // header fields and param names are printable ascii without spaces and, for names, '=', ']' and '"'
+  static void append_token(detail::fmt_buffer& out, std::string_view text, std::size_t max_length) {
+    if (text.empty()) {
+      out.push_back('-');
+      return;
+    }
+    for (char c : text.substr(0, max_length)) {
+      bool printable = c > 32 && c < 127 && c != '=' && c != ']' && c != '"';
+      out.push_back(printable ? c : '_');
+    }
+  }
+
+  static void append_param_value(detail::fmt_buffer& out, std::string_view text) {
+    for (char c : text) {
+      if (c == '"' || c == '\\' || c == ']') {
+        out.push_back('\\');
+      }
+      out.push_back(c);
+    }
+  }
+
+  void append_param(detail::fmt_buffer& out, std::string_view name, const field_value& value) const {
+    out.push_back(' ');
+    append_token(out, name, 32);
+    out.append("=\"");
+    if (value.is_text()) {
+      append_param_value(out, value.text());
+    } else {
+      detail::scratch_buffer text;
+      value.format_to(text.get());
+      append_param_value(out, text.view());
+    }
+    out.push_back('"');
+  }
+
+  void submit(const log_entry& entry) {
+    detail::scratch_buffer out;
+    detail::fmt_buffer& message = out.get();
+    message.push_back('<');
+    detail::write_integer(message, facility_ * 8 + severity(entry.level_val));
+    message.append(">1 ");
+    detail::append_timestamp(message, entry.timestamp, timestamp_format::rfc3339(6));
+    message.append(header_);
+    append_token(message, entry.source, 32);
+    message.push_back(' ');
+
+    if (entry.fields.empty() && !entry.where) {
+      message.push_back('-');
+    } else {
+      message.push_back('[');
+      message.append(sd_id_);
+      if (entry.where) {
+        append_param(message, "file", field_value::ref(entry.where->file));
+        append_param(message, "line", field_value(entry.where->line));
+        append_param(message, "function", field_value::ref(entry.where->function));
+      }
+      for (const auto& f : entry.fields.fields()) {
+        append_param(message, f.key, f.value);
+      }
+      message.push_back(']');
+    }
+    message.push_back(' ');
+    message.append(entry.message);
+    queue_.write_record(entry.level_val, out.view());
+  }
+
+public:
+  explicit syslog_sink(const syslog_endpoint& endpoint = syslog_endpoint{}, const syslog_options& options = {})
+      : facility_(std::clamp(options.facility, 0, 23)), sd_id_(options.sd_id),
+        queue_(
+            std::make_shared<detail::syslog_transport>(endpoint, options.max_message, options.network),
+            options.network.queue_size, options.network.overflow
+        ) {
+    char host[256] = {};
+    if (::gethostname(host, sizeof(host) - 1) != 0) {
+      host[0] = '\0';
+    }
+    detail::fmt_buffer header;
+    header.push_back(' ');
+    append_token(header, host, 255);
+    header.push_back(' ');
+    append_token(header, options.app_name, 48);
+    header.push_back(' ');
+    detail::write_integer(header, static_cast<long long>(::getpid()));
+    header.push_back(' ');
+    header_ = header.str();
+  }
+
+  void write_entry(const log_entry& entry, const formatter&) override { submit(entry); }
+
+  void write_record(level lvl, std::string_view text) override { submit(log_entry(lvl, text, "", field_view{})); }
+
+  void write(std::string_view text) override { write_record(level::info, text); }
+
+  // waits until every earlier message was handed to the socket
+  void flush() override { queue_.flush(); }
+};
+
+struct otlp_options {
+  std::string service_name = "unknown_service";                     // resource attribute service.name
+  std::vector<std::pair<std::string, std::string>> resource_attributes; // further resource attributes
+  std::vector<std::pair<std::string, std::string>> headers;             // extra http headers, e.g. authorization
+
+  // optional request body compression, e.g. gzip; return false to send that batch uncompressed
+  std::function<bool(std::string_view body, std::string& compressed)> compressor;
+  std::string content_encoding = "gzip";
+  network_policy network;
+};
+
+namespace detail {
+
+// http://host[:port][/path], as used for otlp collectors
+struct http_target {
+  std::string host;
+  std::uint16_t port = 80;
+  std::string path = "/";
+
+  static http_target parse(std::string_view url, std::uint16_t default_port, std::string_view default_path) {
+    constexpr std::string_view scheme = "http://";
+    if (url.substr(0, scheme.size()) != scheme) {
+      throw std::invalid_argument("redlog: expected an http:// url, got '" + std::string(url) + "'");
+    }
+    url.remove_prefix(scheme.size());
+    http_target target;
+    std::size_t slash = url.find('/');
+    std::string_view authority = url.substr(0, slash);
+    target.path = slash == std::string_view::npos ? std::string(default_path) : std::string(url.substr(slash));
+
+    std::size_t colon = authority.rfind(':');
+    if (!authority.empty() && authority.front() == '[') { // [v6 address]:port
+      std::size_t close = authority.find(']');
+      colon = close != std::string_view::npos && close + 1 < authority.size() ? close + 1 : std::string_view::npos;
+      target.host = std::string(authority.substr(1, close == std::string_view::npos ? close : close - 1));
+    } else {
+      target.host = std::string(authority.substr(0, colon));
+    }
+    target.port = default_port;
+    if (colon != std::string_view::npos) {
+      std::string_view digits = authority.substr(colon + 1);
+      auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), target.port);
+      if (error != std::errc() || end != digits.data() + digits.size()) {
+        throw std::invalid_argument("redlog: bad port in url '" + std::string(url) + "'");
+      }
+    }
+    if (target.host.empty()) {
+      throw std::invalid_argument("redlog: no host in url '" + std::string(url) + "'");
+    }
+    return target;
+  }
+};
+
+inline void append_otlp_value(fmt_buffer& out, const field_value& value) {
+  using kind = field_value::kind;
+  switch (value.type()) {
+  case kind::boolean:
+    out.append(value.as_bool() ? "{\"boolValue\":true}" : "{\"boolValue\":false}");
+    return;
+  case kind::int64:
+  case kind::uint64:
+    out.append("{\"intValue\":\""); // 64-bit integers are strings in the json encoding
+    value.format_to(out);
+    out.append("\"}");
+    return;
+  case kind::float64:
+    if (std::isfinite(value.as_double())) {
+      out.append("{\"doubleValue\":");
+      value.format_to(out);
+      out.push_back('}');
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+  out.append("{\"stringValue\":");
+  if (value.is_text()) {
+    append_json_string(out, value.text());
+  } else {
+    scratch_buffer text;
+    value.format_to(text.get());
+    append_json_string(out, text.view());
+  }
+  out.push_back('}');
+}
+
+inline void append_otlp_attribute(fmt_buffer& out, std::string_view key, const field_value& value) {
+  out.append("{\"key\":");
+  append_json_string(out, key);
+  out.append(",\"value\":");
+  append_otlp_value(out, value);
+  out.push_back('}');
+}
+
+// posts queued log records to an otlp/http collector; runs on the async_sink worker only
+class otlp_transport : public sink {
+  http_target target_;
+  network_connection connection_;
+  std::string request_head_; // request line and fixed headers
+  std::string body_prefix_;  // resourceLogs envelope up to the logRecords array
+  std::function<bool(std::string_view, std::string&)> compressor_;
+  std::string content_encoding_;
+  meter_lease meter_{"otlp"};
+
+  static std::string lowercase(std::string_view text) {
+    std::string out(text);
+    for (char& c : out) {
+      if (c >= 'A' && c <= 'Z') {
+        c = static_cast<char>(c - 'A' + 'a');
+      }
+    }
+    return out;
+  }
+
+  // send one request and read the response; returns the http status, or 0 when the exchange failed
+  int exchange(std::string_view head, std::string_view body) {
+    if (!connection_.send_all(head) || !connection_.send_all(body)) {
+      return 0;
+    }
+    std::string response;
+    char chunk[4096];
+    std::size_t header_end;
+    while ((header_end = response.find("\r\n\r\n")) == std::string::npos) {
+      ssize_t got = connection_.receive(chunk, sizeof(chunk));
+      if (got <= 0 || response.size() > 64 * 1024) {
+        return 0;
+      }
+      response.append(chunk, static_cast<std::size_t>(got));
+    }
+    if (response.size() < 12 || response.compare(0, 7, "HTTP/1.") != 0) {
+      return 0;
+    }
+    int status = 0;
+    std::from_chars(response.data() + 9, response.data() + 12, status);
+
+    // read the body to keep the connection usable; without a length the server closes it
+    std::string headers = lowercase(std::string_view(response).substr(0, header_end));
+    std::size_t length_at = headers.find("\r\ncontent-length:");
+    bool keep = length_at != std::string::npos && headers.find("\r\nconnection: close") == std::string::npos;
+    if (keep) {
+      const char* digits = headers.data() + length_at + 17;
+      while (*digits == ' ') {
+        digits++;
+      }
+      std::size_t length = 0;
+      std::from_chars(digits, headers.data() + headers.size(), length);
+      std::size_t buffered = response.size() - header_end - 4;
+      while (buffered < length) {
+        ssize_t got = connection_.receive(chunk, std::min(sizeof(chunk), length - buffered));
+        if (got <= 0) {
+          keep = false;
+          break;
+        }
+        buffered += static_cast<std::size_t>(got);
+      }
+    }
+    if (keep) {
+      connection_.used();
+    } else {
+      connection_.reset();
+    }
+    return status;
+  }
+
+public:
+  otlp_transport(std::string_view url, const otlp_options& options)
+      : target_(http_target::parse(url, 4318, "/v1/logs")),
+        connection_(target_.host, target_.port, SOCK_STREAM, false, options.network),
+        compressor_(options.compressor), content_encoding_(options.content_encoding) {
+    bool v6 = target_.host.find(':') != std::string::npos;
+    request_head_ = "POST " + target_.path + " HTTP/1.1\r\nHost: " + (v6 ? "[" + target_.host + "]" : target_.host) +
+                    ":" + std::to_string(target_.port) + "\r\nContent-Type: application/json\r\n";
+    for (const auto& [name, value] : options.headers) {
+      request_head_ += name + ": " + value + "\r\n";
+    }
+
+    fmt_buffer prefix;
+    prefix.append("{\"resourceLogs\":[{\"resource\":{\"attributes\":[");
+    append_otlp_attribute(prefix, "service.name", field_value::ref(options.service_name));
+    for (const auto& [key, value] : options.resource_attributes) {
+      prefix.push_back(',');
+      append_otlp_attribute(prefix, key, field_value::ref(value));
+    }
+    prefix.append("]},\"scopeLogs\":[{\"scope\":{\"name\":\"redlog\"},\"logRecords\":[");
+    body_prefix_ = prefix.str();
+  }
+
+  void write(std::string_view record) override { write_batch({&record, 1}, {}); }
+
+  void write_batch(std::span<const std::string_view> records, std::span<const level> levels) override {
+    if (!connection_.ready()) {
+      count_dropped(levels, 0, records.size());
+      return;
+    }
+    scratch_buffer body;
+    body.get().append(body_prefix_);
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      if (i > 0) {
+        body.get().push_back(',');
+      }
+      body.get().append(records[i]);
+    }
+    body.get().append("]}]}]}");
+
+    std::string compressed;
+    bool use_compression = compressor_ && compressor_(body.view(), compressed);
+    std::string_view payload = use_compression ? std::string_view(compressed) : body.view();
+
+    scratch_buffer head;
+    head.get().append(request_head_);
+    head.get().append("Content-Length: ");
+    write_integer(head.get(), payload.size());
+    head.get().append("\r\n");
+    if (use_compression) {
+      head.get().append("Content-Encoding: ");
+      head.get().append(content_encoding_);
+      head.get().append("\r\n");
+    }
+    head.get().append("\r\n");
+
+    bool reused = connection_.reused();
+    int status = exchange(head.view(), payload);
+    if (status == 0 && reused && connection_.ready()) {
+      status = exchange(head.view(), payload); // the collector closed the idle connection
+    }
+    if (status >= 200 && status < 300) {
+      meter_->wrote(head.view().size() + payload.size());
+      return;
+    }
+    count_dropped(levels, 0, records.size());
+    if (status == 0 || status == 429 || status >= 500) {
+      connection_.fail(); // unreachable or overloaded: back off
+    }
+  }
+
+  void flush() override { meter_->flushed(); }
+};
+
+} // namespace detail
+
+/**
+ * Sink that exports records to an OpenTelemetry collector with otlp/http
+ * and the json encoding (POST to http://host:4318/v1/logs by default).
+ *
+ * Records are encoded as logRecords on the logging thread: the message is
+ * the body, fields, the logger name and call sites become attributes, and
+ * levels map to severity numbers. The logger's formatter is not used.
+ * Batches are posted from a background thread over a kept-alive connection
+ * as described by network_policy. Only plain http is supported; put a local
+ * collector or proxy in front for tls.
+ */
+class otlp_sink : public sink {
+  async_sink queue_;
+
+  static int severity_number(level lvl) noexcept {
+    switch (lvl) {
+    case level::critical:
+      return 21; // FATAL
+    case level::error:
+      return 17; // ERROR
+    case level::warn:
+      return 13; // WARN
+    case level::info:
+      return 9; // INFO
+    case level::verbose:
+      return 8; // DEBUG4
+    case level::trace:
+      return 7; // DEBUG3
+    case level::debug:
+      return 5; // DEBUG
+    case level::pedantic:
+      return 4; // TRACE4
+    default:
+      return 1; // TRACE
+    }
+  }
+
+  void submit(const log_entry& entry) {
+    detail::scratch_buffer out;
+    detail::fmt_buffer& record = out.get();
+    record.append("{\"timeUnixNano\":\"");
+    detail::write_integer(record, detail::to_nanoseconds(entry.timestamp));
+    record.append("\",\"severityNumber\":");
+    detail::write_integer(record, severity_number(entry.level_val));
+    record.append(",\"severityText\":\"");
+    record.append(level_name(entry.level_val));
+    record.append("\",\"body\":{\"stringValue\":");
+    detail::append_json_string(record, entry.message);
+    record.append("},\"attributes\":[");
+    bool first = true;
+    auto attribute = [&](std::string_view key, const field_value& value) {
+      if (!first) {
+        record.push_back(',');
+      }
+      first = false;
+      detail::append_otlp_attribute(record, key, value);
+    };
+    if (!entry.source.empty()) {
+      attribute("logger.name", field_value::ref(entry.source));
+    }
+    if (entry.where) {
+      attribute("code.filepath", field_value::ref(entry.where->file));
+      attribute("code.lineno", field_value(entry.where->line));
+      attribute("code.function", field_value::ref(entry.where->function));
+    }
+    for (const auto& f : entry.fields.fields()) {
+      attribute(f.key, f.value);
+    }
+    record.append("]}");
+    queue_.write_record(entry.level_val, out.view());
+  }
+
+public:
+  explicit otlp_sink(std::string_view url = "http://localhost:4318/v1/logs", const otlp_options& options = {})
+      : queue_(
+            std::make_shared<detail::otlp_transport>(url, options), options.network.queue_size,
+            options.network.overflow
+        ) {}
+
+  void write_entry(const log_entry& entry, const formatter&) override { submit(entry); }
+
+  void write_record(level lvl, std::string_view text) override { submit(log_entry(lvl, text, "", field_view{})); }
+
+  void write(std::string_view text) override { write_record(level::info, text); }
+
+  // waits until every earlier record was posted (or dropped)
+  void flush() override { queue_.flush(); }
+};
+
+#endif // _WIN32
+
+namespace detail {
+
+/**
+ * Flight recorder: a fixed ring of the most recent records that were below
+ * the active level, kept so they can be written out when something goes
+ * wrong (see enable_backtrace()).
+ *
+ * One ring is shared by all threads. A slot holds the level, time, interned
+ * logger name and the message with its fields rendered as "key=value",
+ * truncated to slot_text bytes; nothing reaches a formatter or sink until a
+ * dump. Each slot has its own flag that writers and dumps take briefly, so a
+ * signal handler can read every slot that is not being written at that
+ * instant without waiting.
+ */
+class backtrace_ring {
+public:
+  static constexpr std::size_t slot_text = 240;
+
+  backtrace_ring(std::size_t capacity, level capture, level trigger)
+      : capacity_(capacity > 0 ? capacity : 1), capture_(capture), trigger_(trigger),
+        slots_(std::make_unique<slot[]>(capacity_)) {}
+
+  level capture_level() const noexcept { return capture_; }
+  level trigger_level() const noexcept { return trigger_; }
+  std::size_t capacity() const noexcept { return capacity_; }
+
+  // the active ring if it keeps records at this (filtered) level
+  static backtrace_ring* capturing(level lvl) noexcept {
+    backtrace_ring* ring = active().load(std::memory_order_acquire);
+    return ring && static_cast<int>(lvl) <= static_cast<int>(ring->capture_) ? ring : nullptr;
+  }
+
+  // the active ring if a written record at this level should dump it first
+  static backtrace_ring* triggered_by(level lvl) noexcept {
+    backtrace_ring* ring = active().load(std::memory_order_acquire);
+    return ring && static_cast<int>(lvl) <= static_cast<int>(ring->trigger_) ? ring : nullptr;
+  }
+
+  static std::atomic<backtrace_ring*>& active() noexcept {
+    static std::atomic<backtrace_ring*> ring{nullptr};
+    return ring;
+  }
+
+  // replace the active ring; null turns recording off. old rings stay allocated for threads still using them
+  static void publish(std::unique_ptr<backtrace_ring> next) {
+    static std::mutex mutex;
+    static std::vector<std::unique_ptr<backtrace_ring>> rings;
+    std::lock_guard<std::mutex> lock(mutex);
+    active().store(next.get(), std::memory_order_release);
+    if (next) {
+      rings.push_back(std::move(next));
+    }
+  }
+
+  void capture(level lvl, std::string_view source, std::string_view message, const field_view& fields) {
+    scratch_buffer text;
+    text.get().append(message);
+    for (const auto& f : fields.fields()) {
+      if (text.get().size() >= slot_text) {
+        break;
+      }
+      text.get().push_back(' ');
+      text.get().append(f.key);
+      text.get().push_back('=');
+      f.value.format_to(text.get());
+    }
+    std::string_view body = text.view().substr(0, slot_text);
+
+    std::uint64_t index = next_.fetch_add(1, std::memory_order_relaxed);
+    slot& target = slots_[index % capacity_];
+    while (target.busy.exchange(true, std::memory_order_acquire)) {
+      std::this_thread::yield(); // another writer lapped the ring onto this slot
+    }
+    target.index = index + 1;
+    target.lvl = lvl;
+    target.time = clock_now();
+    target.source = source;
+    target.length = body.size();
+    std::memcpy(target.text, body.data(), body.size());
+    target.busy.store(false, std::memory_order_release);
+  }
+
+  /**
+   * Write the records captured since the last dump, oldest first, through a
+   * formatter and sink, preceded by a header record at the given level.
+   */
+  void dump(sink& out, const formatter& fmt, level header_level);
+
+  /**
+   * Async-signal-safe dump of every readable slot as "[source] [lvl] text"
+   * lines to a file descriptor; slots being written are skipped.
+   */
+  void dump_raw(int fd) noexcept {
+    const std::uint64_t end = next_.load(std::memory_order_acquire);
+    const std::uint64_t begin = end > capacity_ ? end - capacity_ : 0;
+    char line[slot_text + 160];
+    for (std::uint64_t i = begin; i < end; ++i) {
+      slot& entry = slots_[i % capacity_];
+      if (entry.busy.exchange(true, std::memory_order_acquire)) {
+        continue;
+      }
+      std::size_t length = 0;
+      if (entry.index == i + 1) {
+        auto put = [&](std::string_view text) {
+          std::size_t n = std::min(text.size(), sizeof(line) - length);
+          std::memcpy(line + length, text.data(), n);
+          length += n;
+        };
+        put("[");
+        put(entry.source.substr(0, 64));
+        put("] [");
+        put(level_short_name(entry.lvl));
+        put("] ");
+        put(std::string_view(entry.text, entry.length));
+        put("\n");
+      }
+      entry.busy.store(false, std::memory_order_release);
+      write_fd(fd, line, length);
+    }
+  }
+
+private:
+  struct slot {
+    std::atomic<bool> busy{false};
+    std::uint64_t index = 0; // position in the record stream plus one; 0 while unused
+    level lvl = level::info;
+    std::chrono::system_clock::time_point time;
+    std::string_view source; // interned logger name
+    std::size_t length = 0;
+    char text[slot_text];
+  };
+
+  static void write_fd(int fd, const char* data, std::size_t size) noexcept {
+    while (size > 0) {
+#ifdef _WIN32
+      int written = _write(fd, data, static_cast<unsigned>(size));
+#else
+      ssize_t written = ::write(fd, data, size);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+#endif
+      if (written <= 0) {
+        return;
+      }
+      data += written;
+      size -= static_cast<std::size_t>(written);
+    }
+  }
+
+  const std::size_t capacity_;
+  const level capture_;
+  const level trigger_;
+  std::unique_ptr<slot[]> slots_;
+  std::atomic<std::uint64_t> next_{0};
+  std::mutex dump_mutex_;
+  std::uint64_t dumped_ = 0; // records before this index were already dumped
+};
+
+inline void backtrace_ring::dump(sink& out, const formatter& fmt, level header_level) {
+  std::lock_guard<std::mutex> lock(dump_mutex_);
+  const std::uint64_t end = next_.load(std::memory_order_acquire);
+  std::uint64_t begin = end > capacity_ ? end - capacity_ : 0;
+  begin = std::max(begin, dumped_);
+  dumped_ = end;
+  if (begin == end) {
+    return;
+  }
+
+  scratch_buffer header;
+  header.get().append("backtrace: ");
+  write_integer(header.get(), end - begin);
+  header.get().append(end - begin == 1 ? " earlier record" : " earlier records");
+  out.write_entry(log_entry(header_level, header.view(), "", field_view{}), fmt);
+
+  char text[slot_text];
+  for (std::uint64_t i = begin; i < end; ++i) {
+    slot& entry = slots_[i % capacity_];
+    while (entry.busy.exchange(true, std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    const bool current = entry.index == i + 1;
+    const level lvl = entry.lvl;
+    const auto time = entry.time;
+    const std::string_view source = entry.source;
+    const std::size_t length = entry.length;
+    std::memcpy(text, entry.text, length);
+    entry.busy.store(false, std::memory_order_release);
+
+    if (current) {
+      out.write_entry(log_entry(lvl, std::string_view(text, length), source, field_view{}, time), fmt);
+    }
+  }
+}
+
+// where the crash handler writes the ring
+inline std::atomic<int> crash_fd{2};
+
+inline void backtrace_signal_handler(int signal_number) {
+  if (backtrace_ring* ring = backtrace_ring::active().load(std::memory_order_acquire)) {
+    ring->dump_raw(crash_fd.load(std::memory_order_relaxed));
+  }
+  std::signal(signal_number, SIG_DFL);
+  std::raise(signal_number);
+}
+
+} // namespace detail
+
+class located_logger;
+
+/**
+ * Main logger class with immutable design for natural thread safety.
+ *
+ * Loggers are immutable - methods like with_name() and with_field() return
+ * new logger instances rather than modifying the original. This provides
+ * clean scoping semantics and thread safety.
+ */
+class logger {
+  friend class located_logger;
+
+  std::shared_ptr<const detail::logger_context> context_;
+  std::shared_ptr<formatter> formatter_;
+  std::shared_ptr<sink> sink_;
+
+  static std::shared_ptr<const detail::logger_context> make_context(std::string_view name) {
+    return detail::logger_context::root(name);
+  }
+
+  // derive a logger whose context extends ours
+  logger derive(std::string_view name, field_set local) const {
+    logger result = *this;
+    result.context_ = detail::logger_context::extend(context_, name, std::move(local));
+    return result;
+  }
+
+  logger derive(field_set local) const { return derive(context_->name, std::move(local)); }
+
+public:
+  /**
+   * Create a logger with the given name.
+   * Uses default console output and formatting.
+   */
+  explicit logger(std::string_view name = "")
+      : context_(make_context(name)), formatter_(std::make_shared<default_formatter>()),
+        sink_(std::make_shared<console_sink>()) {}
+
+  /**
+   * Create a logger with custom formatter and sink.
+   */
+  logger(std::string_view name, std::shared_ptr<formatter> fmt, std::shared_ptr<sink> sink_ptr)
+      : context_(make_context(name)), formatter_(std::move(fmt)), sink_(std::move(sink_ptr)) {}
+
+  /**
+   * Create a logger with custom formatter (uses default console sink).
+   */
+  logger(std::string_view name, std::shared_ptr<formatter> fmt)
+      : context_(make_context(name)), formatter_(std::move(fmt)), sink_(std::make_shared<console_sink>()) {}
+
+  /**
+   * Create a logger with custom sink (uses default formatter).
+   */
+  logger(std::string_view name, std::shared_ptr<sink> sink_ptr)
+      : context_(make_context(name)), formatter_(std::make_shared<default_formatter>()), sink_(std::move(sink_ptr)) {}
+
+  /**
+   * Create a scoped logger with additional name component.
+   *
+   * Example: logger("app").with_name("db") creates logger named "app.db"
+   */
+  logger with_name(std::string_view name) const {
+    std::string_view current = context_->name;
+    if (current.empty()) {
+      return derive(name, field_set{});
+    }
+    detail::scratch_buffer scoped;
+    scoped.get().append(current);
+    scoped.get().push_back('.');
+    scoped.get().append(name);
+    return derive(scoped.view(), field_set{});
+  }
+
+  /**
+   * Create a logger with additional field.
+   * The value keeps its type (see field_value) and renders like stringify.
+   */
+  template <typename K, typename T> logger with_field(K&& key, T&& value) const {
+    field_set local;
+    local.add(field(std::forward<K>(key), std::forward<T>(value)));
+    return derive(std::move(local));
+  }
+
+  /**
+   * Create a logger with additional fields.
+   */
+  logger with_fields(const field_set& new_fields) const { return derive(new_fields); }
+
+  /**
+   * Create a logger with additional fields rendered once ahead of time; see
+   * rendered_fields. Fields this logger already has are rendered with them.
+   */
+  logger with_fields(const rendered_fields& rendered) const {
+    logger result = *this;
+    result.context_ = detail::logger_context::extend(context_, context_->name, rendered);
+    return result;
+  }
+
+  /**
+   * Create a logger with multiple additional fields.
+   */
+  template <typename... Fields, typename = std::enable_if_t<(std::is_constructible_v<field, Fields> && ...)>>
+  logger with_fields(Fields&&... fields) const {
+    field_set local;
+    (local.add(field(std::forward<Fields>(fields))), ...);
+    return derive(std::move(local));
+  }
+
+  /**
+   * Whether a record at this level would be written or kept by the flight
+   * recorder. Cheap; used by the REDLOG_<LEVEL> macros to skip argument evaluation.
+   */
+  bool enabled(level l) const {
+    return should_log(l) || capturing(l) != nullptr;
+  }
+
+  /**
+   * Write the flight recorder's records through this logger's formatter and
+   * sink now, instead of waiting for a trigger record.
+   */
+  void dump_backtrace() const {
+    if (detail::backtrace_ring* ring = detail::backtrace_ring::active().load(std::memory_order_acquire)) {
+      ring->dump(*sink_, *formatter_, ring->trigger_level());
+    }
+  }
+
+  /**
+   * This logger with a call site attached: log.at(site).error("...").
+   * The site must outlive the records (the REDLOG_<LEVEL> macros pass a
+   * static one); it is recorded for levels in settings::source_levels.
+   */
+  located_logger at(const source_site& site) const;
+
+private:
+  // check if level should be logged
+  bool should_log(level l) const {
+    int msg_level = static_cast<int>(l);
+
+    // compile-time filtering: if message level is above compile-time limit, filter it
+    if (msg_level > REDLOG_MIN_LEVEL) {
+      return false;
+    }
+
+    // runtime filtering against the cached per-name level
+    return msg_level <= static_cast<int>(context_->threshold());
+  }
+
+  // flight recorder ring for a filtered record, if it keeps this level
+  static detail::backtrace_ring* capturing(level l) {
+    return static_cast<int>(l) <= REDLOG_MIN_LEVEL ? detail::backtrace_ring::capturing(l) : nullptr;
+  }
+
+  // a record at a trigger level writes out what the flight recorder kept before it
+  void dump_if_triggered(level lvl) const {
+    if (detail::backtrace_ring* ring = detail::backtrace_ring::triggered_by(lvl)) {
+      ring->dump(*sink_, *formatter_, lvl);
+    }
+  }
+
+  // core logging implementation
+  void log_impl(level lvl, std::string_view msg) const { log_impl_with_fields(lvl, msg); }
+
+  // core logging implementation with additional fields
+  template <typename... Fields> void log_impl_with_fields(level lvl, std::string_view msg, Fields&&... fields) const {
+    log_at(lvl, nullptr, msg, std::forward<Fields>(fields)...);
+  }
+
+  // as log_impl_with_fields, for a record that names its call site
+  template <typename... Fields>
+  void log_at(level lvl, const source_site* where, std::string_view msg, Fields&&... fields) const {
+    if (!should_log(lvl)) {
+      detail::count_filtered(lvl);
+      if (detail::backtrace_ring* ring = capturing(lvl)) {
+        try {
+          std::array<field, sizeof...(Fields)> local_fields{field(std::forward<Fields>(fields))...};
+          ring->capture(lvl, context_->name, msg, context_->view(local_fields));
+        } catch (...) {
+        }
+      }
+      return;
+    }
+
+    detail::count_emitted(lvl);
+    detail::config_pin pin; // one snapshot for the whole record
+    try {
+      dump_if_triggered(lvl);
+      // view context fields in place; call-site fields are moved next to each other
+      std::array<field, sizeof...(Fields)> local_fields{field(std::forward<Fields>(fields))...};
+      log_entry entry(lvl, msg, context_->name, context_->view(local_fields));
+      entry.where = where;
+      sink_->write_entry(entry, *formatter_);
+    } catch (...) {
+      // fallback error handling
+      std::fprintf(stderr, "[redlog-error] Failed to log: %.*s\n", static_cast<int>(msg.size()), msg.data());
+    }
+  }
+
+  // printf-style logging; plain arguments are handed over unformatted to sinks that accept deferred records
+  template <typename Format, typename... Args> void log_format_impl(level lvl, Format format, Args&&... args) const {
+    log_format_at(lvl, nullptr, format, std::forward<Args>(args)...);
+  }
+
+  template <typename Format, typename... Args>
+  void log_format_at(level lvl, const source_site* where, Format format, Args&&... args) const {
+    if (!should_log(lvl)) {
+      detail::count_filtered(lvl);
+      if (detail::backtrace_ring* ring = capturing(lvl)) {
+        detail::scratch_buffer msg;
+        format_string_to(msg.get(), format, args...);
+        try {
+          ring->capture(lvl, context_->name, msg.view(), context_->view());
+        } catch (...) {
+        }
+      }
+      return;
+    }
+
+    detail::config_pin pin;
+    if constexpr (sizeof...(Args) > 0 && (detail::is_deferrable_v<Args> && ...)) {
+      if (sink_->accepts_deferred()) {
+        detail::deferred_record record;
+        if (record.capture(format, args...)) {
+          detail::count_emitted(lvl);
+          dump_if_triggered(lvl);
+          record.level_val = lvl;
+          record.context = context_;
+          record.fmt = formatter_;
+          record.timestamp = detail::clock_now();
+          record.where = where;
+          try {
+            sink_->write_deferred(std::move(record));
+          } catch (...) {
+            std::string_view text = detail::format_text(format);
+            std::fprintf(stderr, "[redlog-error] Failed to log: %.*s\n", static_cast<int>(text.size()), text.data());
+          }
+          return;
+        }
+      }
+    }
+
+    detail::scratch_buffer msg;
+    format_string_to(msg.get(), format, args...);
+    log_at(lvl, where, msg.view());
+  }
+
+public:
+  // logging methods - full names
+
+  template <typename... Fields> void critical(std::string_view msg, Fields&&... fields) const {
+    log_impl_with_fields(level::critical, msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void error(std::string_view msg, Fields&&... fields) const {
+    log_impl_with_fields(level::error, msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void warn(std::string_view msg, Fields&&... fields) const {
+    log_impl_with_fields(level::warn, msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void info(std::string_view msg, Fields&&... fields) const {
+    log_impl_with_fields(level::info, msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void verbose(std::string_view msg, Fields&&... fields) const {
+    log_impl_with_fields(level::verbose, msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void trace(std::string_view msg, Fields&&... fields) const {
+    log_impl_with_fields(level::trace, msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void debug(std::string_view msg, Fields&&... fields) const {
+    log_impl_with_fields(level::debug, msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void pedantic(std::string_view msg, Fields&&... fields) const {
+    log_impl_with_fields(level::pedantic, msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void annoying(std::string_view msg, Fields&&... fields) const {
+    log_impl_with_fields(level::annoying, msg, std::forward<Fields>(fields)...);
+  }
+
+  // logging methods - short names
+  template <typename... Fields> void crt(std::string_view msg, Fields&&... fields) const {
+    critical(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void err(std::string_view msg, Fields&&... fields) const {
+    error(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void wrn(std::string_view msg, Fields&&... fields) const {
+    warn(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void inf(std::string_view msg, Fields&&... fields) const {
+    info(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void vrb(std::string_view msg, Fields&&... fields) const {
+    verbose(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void trc(std::string_view msg, Fields&&... fields) const {
+    trace(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void dbg(std::string_view msg, Fields&&... fields) const {
+    debug(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void ped(std::string_view msg, Fields&&... fields) const {
+    pedantic(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void ayg(std::string_view msg, Fields&&... fields) const {
+    annoying(msg, std::forward<Fields>(fields)...);
+  }
+
+  // logging at a level chosen at run time
+  template <typename... Fields> void log(level lvl, std::string_view msg, Fields&&... fields) const {
+    log_impl_with_fields(lvl, msg, std::forward<Fields>(fields)...);
+  }
+
+  /**
+   * Printf-style formatting with universal %s support.
+   *
+   * All arguments are converted to strings using the universal stringify
+   * function, then %s placeholders are replaced with the stringified values.
+   *
+   * This means %s works with:
+   * - Basic types (strings, numbers)
+   * - Any custom type that implements operator<< for streams
+   */
+  template <typename... Args> void critical_f(const char* format, Args&&... args) const {
+    log_format_impl(level::critical, format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void critical_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_format_impl(level::critical, format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void error_f(const char* format, Args&&... args) const {
+    log_format_impl(level::error, format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void error_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_format_impl(level::error, format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void warn_f(const char* format, Args&&... args) const {
+    log_format_impl(level::warn, format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void warn_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_format_impl(level::warn, format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void info_f(const char* format, Args&&... args) const {
+    log_format_impl(level::info, format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void info_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_format_impl(level::info, format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void verbose_f(const char* format, Args&&... args) const {
+    log_format_impl(level::verbose, format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void verbose_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_format_impl(level::verbose, format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void trace_f(const char* format, Args&&... args) const {
+    log_format_impl(level::trace, format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void trace_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_format_impl(level::trace, format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void debug_f(const char* format, Args&&... args) const {
+    log_format_impl(level::debug, format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void debug_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_format_impl(level::debug, format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void pedantic_f(const char* format, Args&&... args) const {
+    log_format_impl(level::pedantic, format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void pedantic_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_format_impl(level::pedantic, format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void annoying_f(const char* format, Args&&... args) const {
+    log_format_impl(level::annoying, format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void annoying_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_format_impl(level::annoying, format, std::forward<Args>(args)...);
+  }
+
+  // short form printf methods
+  template <typename Format, typename... Args> void crt_f(Format&& format, Args&&... args) const {
+    critical_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void err_f(Format&& format, Args&&... args) const {
+    error_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void wrn_f(Format&& format, Args&&... args) const {
+    warn_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void inf_f(Format&& format, Args&&... args) const {
+    info_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void vrb_f(Format&& format, Args&&... args) const {
+    verbose_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void trc_f(Format&& format, Args&&... args) const {
+    trace_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void dbg_f(Format&& format, Args&&... args) const {
+    debug_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void ped_f(Format&& format, Args&&... args) const {
+    pedantic_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void ayg_f(Format&& format, Args&&... args) const {
+    annoying_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+
+private:
+  /**
+   * Stream-based printf-style formatting.
+   *
+   * Supports standard format specifiers (%d, %f, %s, %x, etc.) using stringstream
+   * formatting. Custom types work via operator<< just like stringify().
+   *
+   * Format specifiers supported:
+   * - %d, %i: integers
+   * - %f, %F: floating point (default precision)
+   * - %.nf: floating point with n decimal places
+   * - %x, %X: hexadecimal (lowercase/uppercase)
+   * - %o: octal
+   * - %s: strings and any type with operator<<
+   * - %c: characters
+   */
+  template <typename Format, typename... Args>
+  void format_string_to(detail::fmt_buffer& out, Format format, const Args&... args) const {
+    try {
+      detail::stream_printf_to(out, format, args...);
+    } catch (...) {
+      out.clear();
+      out.append("[printf_format_error]");
+    }
+  }
+};
+
+/**
+ * A logger together with a call site, returned by logger::at(). Records at
+ * levels in settings::source_levels carry the site; others are unchanged.
+ */
+class located_logger {
+  const logger* log_;
+  const source_site* site_;
+
+  const source_site* site(level lvl) const noexcept {
+    detail::config_pin pin;
+    return (detail::current_config().values.source_levels & level_mask(lvl)) ? site_ : nullptr;
+  }
+
+public:
+  located_logger(const logger& log, const source_site& site) : log_(&log), site_(&site) {}
+
+  template <typename... Fields> void critical(std::string_view msg, Fields&&... fields) const {
+    log_->log_at(level::critical, site(level::critical), msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void error(std::string_view msg, Fields&&... fields) const {
+    log_->log_at(level::error, site(level::error), msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void warn(std::string_view msg, Fields&&... fields) const {
+    log_->log_at(level::warn, site(level::warn), msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void info(std::string_view msg, Fields&&... fields) const {
+    log_->log_at(level::info, site(level::info), msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void verbose(std::string_view msg, Fields&&... fields) const {
+    log_->log_at(level::verbose, site(level::verbose), msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void trace(std::string_view msg, Fields&&... fields) const {
+    log_->log_at(level::trace, site(level::trace), msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void debug(std::string_view msg, Fields&&... fields) const {
+    log_->log_at(level::debug, site(level::debug), msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void pedantic(std::string_view msg, Fields&&... fields) const {
+    log_->log_at(level::pedantic, site(level::pedantic), msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void annoying(std::string_view msg, Fields&&... fields) const {
+    log_->log_at(level::annoying, site(level::annoying), msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Fields> void crt(std::string_view msg, Fields&&... fields) const {
+    critical(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void err(std::string_view msg, Fields&&... fields) const {
+    error(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void wrn(std::string_view msg, Fields&&... fields) const {
+    warn(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void inf(std::string_view msg, Fields&&... fields) const {
+    info(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void vrb(std::string_view msg, Fields&&... fields) const {
+    verbose(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void trc(std::string_view msg, Fields&&... fields) const {
+    trace(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void dbg(std::string_view msg, Fields&&... fields) const {
+    debug(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void ped(std::string_view msg, Fields&&... fields) const {
+    pedantic(msg, std::forward<Fields>(fields)...);
+  }
+  template <typename... Fields> void ayg(std::string_view msg, Fields&&... fields) const {
+    annoying(msg, std::forward<Fields>(fields)...);
+  }
+
+  template <typename... Args> void critical_f(const char* format, Args&&... args) const {
+    log_->log_format_at(level::critical, site(level::critical), format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void critical_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_->log_format_at(level::critical, site(level::critical), format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void error_f(const char* format, Args&&... args) const {
+    log_->log_format_at(level::error, site(level::error), format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void error_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_->log_format_at(level::error, site(level::error), format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void warn_f(const char* format, Args&&... args) const {
+    log_->log_format_at(level::warn, site(level::warn), format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void warn_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_->log_format_at(level::warn, site(level::warn), format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void info_f(const char* format, Args&&... args) const {
+    log_->log_format_at(level::info, site(level::info), format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void info_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_->log_format_at(level::info, site(level::info), format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void verbose_f(const char* format, Args&&... args) const {
+    log_->log_format_at(level::verbose, site(level::verbose), format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void verbose_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_->log_format_at(level::verbose, site(level::verbose), format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void trace_f(const char* format, Args&&... args) const {
+    log_->log_format_at(level::trace, site(level::trace), format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void trace_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_->log_format_at(level::trace, site(level::trace), format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void debug_f(const char* format, Args&&... args) const {
+    log_->log_format_at(level::debug, site(level::debug), format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void debug_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_->log_format_at(level::debug, site(level::debug), format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void pedantic_f(const char* format, Args&&... args) const {
+    log_->log_format_at(level::pedantic, site(level::pedantic), format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void pedantic_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_->log_format_at(level::pedantic, site(level::pedantic), format, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args> void annoying_f(const char* format, Args&&... args) const {
+    log_->log_format_at(level::annoying, site(level::annoying), format, std::forward<Args>(args)...);
+  }
+
+  template <detail::fixed_string Format, typename... Args>
+  void annoying_f(detail::compiled_format<Format> format, Args&&... args) const {
+    static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+    log_->log_format_at(level::annoying, site(level::annoying), format, std::forward<Args>(args)...);
+  }
+
+  template <typename Format, typename... Args> void crt_f(Format&& format, Args&&... args) const {
+    critical_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void err_f(Format&& format, Args&&... args) const {
+    error_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void wrn_f(Format&& format, Args&&... args) const {
+    warn_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void inf_f(Format&& format, Args&&... args) const {
+    info_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void vrb_f(Format&& format, Args&&... args) const {
+    verbose_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void trc_f(Format&& format, Args&&... args) const {
+    trace_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void dbg_f(Format&& format, Args&&... args) const {
+    debug_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void ped_f(Format&& format, Args&&... args) const {
+    pedantic_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+  template <typename Format, typename... Args> void ayg_f(Format&& format, Args&&... args) const {
+    annoying_f(std::forward<Format>(format), std::forward<Args>(args)...);
+  }
+};
+
+inline located_logger logger::at(const source_site& site) const { return located_logger(*this, site); }
+
+namespace detail {
+
+/**
+ * Admission state for one rate-limited call site (see REDLOG_EVERY_N and friends).
+ *
+ * every_n admits the first of every n calls. interval is a token bucket kept as
+ * a single atomic "theoretical arrival time": a call is admitted while the
+ * bucket holds a token, and `burst` calls may pass back to back. sample admits
+ * each call with a fixed probability. rejections cost one or two relaxed atomic
+ * operations and are counted so they can be reported later.
+ */
+class rate_site {
+public:
+  enum class mode { every_n, interval, sample };
+
+  // how often a pending suppressed count is reported
+  static constexpr int64_t summary_period_ns = 1000000000;
+
+  static rate_site every(uint64_t n) { return rate_site(mode::every_n, n > 0 ? n : 1, 1); }
+
+  static rate_site every_interval(std::chrono::nanoseconds period, uint64_t burst = 1) {
+    uint64_t ns = period.count() > 0 ? static_cast<uint64_t>(period.count()) : 0;
+    return rate_site(mode::interval, ns, burst > 0 ? burst : 1);
+  }
+
+  static rate_site per_second(double rate, uint64_t burst = 1) {
+    double ns = rate > 0.0 ? 1e9 / rate : 1e18;
+    return every_interval(std::chrono::nanoseconds(static_cast<int64_t>(ns)), burst);
+  }
+
+  static rate_site sampled(double probability) {
+    const double scaled = probability * 18446744073709551616.0; // 2^64
+    uint64_t threshold = 0;
+    if (scaled >= 18446744073709551616.0) {
+      threshold = UINT64_MAX;
+    } else if (scaled > 0.0) {
+      threshold = static_cast<uint64_t>(scaled);
+    }
+    return rate_site(mode::sample, threshold, 1);
+  }
+
+  rate_site(const rate_site&) = delete;
+  rate_site& operator=(const rate_site&) = delete;
+
+  // whether this call may be logged; rejected calls are counted as suppressed
+  bool admit() {
+    if (try_admit()) {
+      return true;
+    }
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
   }
 
-  /**
-   * Create a logger with multiple additional fields.
-   */
-  template <typename... Fields> logger with_fields(Fields&&... fields) const {
-    logger result = *this;
-    (result.fields_.add(std::forward<Fields>(fields)), ...);
-    return result;
+  // take the suppressed count if one is due for reporting, else 0
+  uint64_t take_suppressed() {
+    if (suppressed_.load(std::memory_order_relaxed) == 0) {
+      return 0;
+    }
+    int64_t now = steady_ns();
+    int64_t last = last_summary_.load(std::memory_order_relaxed);
+    if (last != 0 && now - last < summary_period_ns) {
+      return 0;
+    }
+    if (!last_summary_.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+      return 0; // another thread is reporting
+    }
+    return suppressed_.exchange(0, std::memory_order_relaxed);
   }
 
+  uint64_t suppressed() const { return suppressed_.load(std::memory_order_relaxed); }
+
 private:
-  // check if level should be logged
-  bool should_log(level l) const {
-    int msg_level = static_cast<int>(l);
-    int runtime_level = static_cast<int>(detail::config::instance().min_level());
+  rate_site(mode m, uint64_t param, uint64_t burst) : mode_(m), param_(param), burst_(burst) {}
+
+  // splitmix64 over a per-thread counter
+  static uint64_t next_random() {
+    thread_local uint64_t state = static_cast<uint64_t>(steady_ns()) ^ reinterpret_cast<uintptr_t>(&state);
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
 
-    // compile-time filtering: if message level is above compile-time limit, filter it
-    if (msg_level > REDLOG_MIN_LEVEL) {
-      return false;
+  bool try_admit() {
+    switch (mode_) {
+    case mode::every_n:
+      return counter_.fetch_add(1, std::memory_order_relaxed) % param_ == 0;
+    case mode::sample:
+      return param_ == UINT64_MAX || next_random() < param_;
+    case mode::interval:
+      break;
     }
 
-    // runtime filtering: if message level is above runtime limit, filter it
-    return msg_level <= runtime_level;
+    // the bucket is empty while the next arrival time is more than burst - 1 periods ahead
+    const uint64_t now = static_cast<uint64_t>(steady_ns());
+    const uint64_t tolerance = (burst_ - 1) * param_;
+    uint64_t arrival = counter_.load(std::memory_order_relaxed);
+    for (;;) {
+      uint64_t base = arrival > now ? arrival : now;
+      if (base - now > tolerance) {
+        return false;
+      }
+      if (counter_.compare_exchange_weak(arrival, base + param_, std::memory_order_relaxed)) {
+        return true;
+      }
+    }
   }
 
-  // core logging implementation
-  void log_impl(level lvl, std::string_view msg) const { log_impl_with_fields(lvl, msg); }
+  const mode mode_;
+  const uint64_t param_; // n, period in nanoseconds, or sampling threshold
+  const uint64_t burst_;
+  std::atomic<uint64_t> counter_{0}; // calls seen, or the bucket's next arrival time
+  std::atomic<uint64_t> suppressed_{0};
+  std::atomic<int64_t> last_summary_{0};
+};
 
-  // core logging implementation with additional fields
-  template <typename... Fields> void log_impl_with_fields(level lvl, std::string_view msg, Fields&&... fields) const {
-    if (!should_log(lvl)) {
-      return;
-    }
+} // namespace detail
 
-    try {
-      // create merged field set without copying the logger
-      field_set entry_fields = fields_;
-      (entry_fields.add(std::forward<Fields>(fields)), ...);
+/**
+ * A logger seen through a rate-limited call site; returned by REDLOG_EVERY_N,
+ * REDLOG_EVERY_MS, REDLOG_RATE_LIMIT and REDLOG_SAMPLE.
+ *
+ * Disabled levels are rejected first, without touching the site. Rejected
+ * calls do no formatting and are counted; the next admitted record is preceded
+ * by a "suppressed N messages" record at its level, at most once per second.
+ */
+class limited_logger {
+  const logger* log_;
+  detail::rate_site* site_;
 
-      log_entry entry(lvl, std::string(msg), name_, std::move(entry_fields));
-      std::string formatted = formatter_->format(entry);
-      sink_->write(formatted);
-    } catch (...) {
-      // fallback error handling
-      std::fprintf(stderr, "[redlog-error] Failed to log: %.*s\n", static_cast<int>(msg.size()), msg.data());
+  bool admit(level lvl) const {
+    if (!log_->enabled(lvl) || !site_->admit()) {
+      return false;
     }
+    if (uint64_t suppressed = site_->take_suppressed()) {
+      detail::scratch_buffer summary;
+      summary.get().append("suppressed ");
+      detail::write_integer(summary.get(), suppressed);
+      summary.get().append(suppressed == 1 ? " message" : " messages");
+      log_->log(lvl, summary.view());
+    }
+    return true;
   }
 
 public:
-  // logging methods - full names
+  limited_logger(const logger& log, detail::rate_site& site) : log_(&log), site_(&site) {}
+
+  // number of calls rejected since the last summary
+  uint64_t suppressed() const { return site_->suppressed(); }
 
   template <typename... Fields> void critical(std::string_view msg, Fields&&... fields) const {
-    log_impl_with_fields(level::critical, msg, std::forward<Fields>(fields)...);
+    if (admit(level::critical)) {
+      log_->critical(msg, std::forward<Fields>(fields)...);
+    }
   }
 
   template <typename... Fields> void error(std::string_view msg, Fields&&... fields) const {
-    log_impl_with_fields(level::error, msg, std::forward<Fields>(fields)...);
+    if (admit(level::error)) {
+      log_->error(msg, std::forward<Fields>(fields)...);
+    }
   }
 
   template <typename... Fields> void warn(std::string_view msg, Fields&&... fields) const {
-    log_impl_with_fields(level::warn, msg, std::forward<Fields>(fields)...);
+    if (admit(level::warn)) {
+      log_->warn(msg, std::forward<Fields>(fields)...);
+    }
   }
 
   template <typename... Fields> void info(std::string_view msg, Fields&&... fields) const {
-    log_impl_with_fields(level::info, msg, std::forward<Fields>(fields)...);
+    if (admit(level::info)) {
+      log_->info(msg, std::forward<Fields>(fields)...);
+    }
   }
 
   template <typename... Fields> void verbose(std::string_view msg, Fields&&... fields) const {
-    log_impl_with_fields(level::verbose, msg, std::forward<Fields>(fields)...);
+    if (admit(level::verbose)) {
+      log_->verbose(msg, std::forward<Fields>(fields)...);
+    }
   }
 
   template <typename... Fields> void trace(std::string_view msg, Fields&&... fields) const {
-    log_impl_with_fields(level::trace, msg, std::forward<Fields>(fields)...);
+    if (admit(level::trace)) {
+      log_->trace(msg, std::forward<Fields>(fields)...);
+    }
   }
 
   template <typename... Fields> void debug(std::string_view msg, Fields&&... fields) const {
-    log_impl_with_fields(level::debug, msg, std::forward<Fields>(fields)...);
+    if (admit(level::debug)) {
+      log_->debug(msg, std::forward<Fields>(fields)...);
+    }
   }
 
   template <typename... Fields> void pedantic(std::string_view msg, Fields&&... fields) const {
-    log_impl_with_fields(level::pedantic, msg, std::forward<Fields>(fields)...);
+    if (admit(level::pedantic)) {
+      log_->pedantic(msg, std::forward<Fields>(fields)...);
+    }
   }
 
   template <typename... Fields> void annoying(std::string_view msg, Fields&&... fields) const {
-    log_impl_with_fields(level::annoying, msg, std::forward<Fields>(fields)...);
+    if (admit(level::annoying)) {
+      log_->annoying(msg, std::forward<Fields>(fields)...);
+    }
   }
 
-  // logging methods - short names
   template <typename... Fields> void crt(std::string_view msg, Fields&&... fields) const {
     critical(msg, std::forward<Fields>(fields)...);
   }
@@ -1076,139 +7677,86 @@ public:
     annoying(msg, std::forward<Fields>(fields)...);
   }
 
-  /**
-   * Printf-style formatting with universal %s support.
-   *
-   * All arguments are converted to strings using the universal stringify
-   * function, then %s placeholders are replaced with the stringified values.
-   *
-   * This means %s works with:
-   * - Basic types (strings, numbers)
-   * - Any custom type that implements operator<< for streams
-   */
-  template <typename... Args> void critical_f(const char* format, Args&&... args) const {
-    if (!should_log(level::critical)) {
-      return;
+  template <typename Format, typename... Args> void critical_f(Format&& format, Args&&... args) const {
+    if (admit(level::critical)) {
+      log_->critical_f(std::forward<Format>(format), std::forward<Args>(args)...);
     }
-    std::string msg = format_string(format, std::forward<Args>(args)...);
-    critical(msg);
   }
 
-  template <typename... Args> void error_f(const char* format, Args&&... args) const {
-    if (!should_log(level::error)) {
-      return;
+  template <typename Format, typename... Args> void error_f(Format&& format, Args&&... args) const {
+    if (admit(level::error)) {
+      log_->error_f(std::forward<Format>(format), std::forward<Args>(args)...);
     }
-    std::string msg = format_string(format, std::forward<Args>(args)...);
-    error(msg);
   }
 
-  template <typename... Args> void warn_f(const char* format, Args&&... args) const {
-    if (!should_log(level::warn)) {
-      return;
+  template <typename Format, typename... Args> void warn_f(Format&& format, Args&&... args) const {
+    if (admit(level::warn)) {
+      log_->warn_f(std::forward<Format>(format), std::forward<Args>(args)...);
     }
-    std::string msg = format_string(format, std::forward<Args>(args)...);
-    warn(msg);
   }
 
-  template <typename... Args> void info_f(const char* format, Args&&... args) const {
-    if (!should_log(level::info)) {
-      return;
+  template <typename Format, typename... Args> void info_f(Format&& format, Args&&... args) const {
+    if (admit(level::info)) {
+      log_->info_f(std::forward<Format>(format), std::forward<Args>(args)...);
     }
-    std::string msg = format_string(format, std::forward<Args>(args)...);
-    info(msg);
   }
 
-  template <typename... Args> void verbose_f(const char* format, Args&&... args) const {
-    if (!should_log(level::verbose)) {
-      return;
+  template <typename Format, typename... Args> void verbose_f(Format&& format, Args&&... args) const {
+    if (admit(level::verbose)) {
+      log_->verbose_f(std::forward<Format>(format), std::forward<Args>(args)...);
     }
-    std::string msg = format_string(format, std::forward<Args>(args)...);
-    verbose(msg);
   }
 
-  template <typename... Args> void trace_f(const char* format, Args&&... args) const {
-    if (!should_log(level::trace)) {
-      return;
+  template <typename Format, typename... Args> void trace_f(Format&& format, Args&&... args) const {
+    if (admit(level::trace)) {
+      log_->trace_f(std::forward<Format>(format), std::forward<Args>(args)...);
     }
-    std::string msg = format_string(format, std::forward<Args>(args)...);
-    trace(msg);
   }
 
-  template <typename... Args> void debug_f(const char* format, Args&&... args) const {
-    if (!should_log(level::debug)) {
-      return;
+  template <typename Format, typename... Args> void debug_f(Format&& format, Args&&... args) const {
+    if (admit(level::debug)) {
+      log_->debug_f(std::forward<Format>(format), std::forward<Args>(args)...);
     }
-    std::string msg = format_string(format, std::forward<Args>(args)...);
-    debug(msg);
   }
 
-  template <typename... Args> void pedantic_f(const char* format, Args&&... args) const {
-    if (!should_log(level::pedantic)) {
-      return;
+  template <typename Format, typename... Args> void pedantic_f(Format&& format, Args&&... args) const {
+    if (admit(level::pedantic)) {
+      log_->pedantic_f(std::forward<Format>(format), std::forward<Args>(args)...);
     }
-    std::string msg = format_string(format, std::forward<Args>(args)...);
-    pedantic(msg);
   }
 
-  template <typename... Args> void annoying_f(const char* format, Args&&... args) const {
-    if (!should_log(level::annoying)) {
-      return;
+  template <typename Format, typename... Args> void annoying_f(Format&& format, Args&&... args) const {
+    if (admit(level::annoying)) {
+      log_->annoying_f(std::forward<Format>(format), std::forward<Args>(args)...);
     }
-    std::string msg = format_string(format, std::forward<Args>(args)...);
-    annoying(msg);
   }
 
-  // short form printf methods
-  template <typename... Args> void crt_f(const char* format, Args&&... args) const {
-    critical_f(format, std::forward<Args>(args)...);
-  }
-  template <typename... Args> void err_f(const char* format, Args&&... args) const {
-    error_f(format, std::forward<Args>(args)...);
+  template <typename Format, typename... Args> void crt_f(Format&& format, Args&&... args) const {
+    critical_f(std::forward<Format>(format), std::forward<Args>(args)...);
   }
-  template <typename... Args> void wrn_f(const char* format, Args&&... args) const {
-    warn_f(format, std::forward<Args>(args)...);
+  template <typename Format, typename... Args> void err_f(Format&& format, Args&&... args) const {
+    error_f(std::forward<Format>(format), std::forward<Args>(args)...);
   }
-  template <typename... Args> void inf_f(const char* format, Args&&... args) const {
-    info_f(format, std::forward<Args>(args)...);
+  template <typename Format, typename... Args> void wrn_f(Format&& format, Args&&... args) const {
+    warn_f(std::forward<Format>(format), std::forward<Args>(args)...);
   }
-  template <typename... Args> void vrb_f(const char* format, Args&&... args) const {
-    verbose_f(format, std::forward<Args>(args)...);
+  template <typename Format, typename... Args> void inf_f(Format&& format, Args&&... args) const {
+    info_f(std::forward<Format>(format), std::forward<Args>(args)...);
   }
-  template <typename... Args> void trc_f(const char* format, Args&&... args) const {
-    trace_f(format, std::forward<Args>(args)...);
+  template <typename Format, typename... Args> void vrb_f(Format&& format, Args&&... args) const {
+    verbose_f(std::forward<Format>(format), std::forward<Args>(args)...);
   }
-  template <typename... Args> void dbg_f(const char* format, Args&&... args) const {
-    debug_f(format, std::forward<Args>(args)...);
+  template <typename Format, typename... Args> void trc_f(Format&& format, Args&&... args) const {
+    trace_f(std::forward<Format>(format), std::forward<Args>(args)...);
   }
-  template <typename... Args> void ped_f(const char* format, Args&&... args) const {
-    pedantic_f(format, std::forward<Args>(args)...);
+  template <typename Format, typename... Args> void dbg_f(Format&& format, Args&&... args) const {
+    debug_f(std::forward<Format>(format), std::forward<Args>(args)...);
   }
-  template <typename... Args> void ayg_f(const char* format, Args&&... args) const {
-    annoying_f(format, std::forward<Args>(args)...);
+  template <typename Format, typename... Args> void ped_f(Format&& format, Args&&... args) const {
+    pedantic_f(std::forward<Format>(format), std::forward<Args>(args)...);
   }
-
-private:
-  /**
-   * Stream-based printf-style formatting.
-   *
-   * Supports standard format specifiers (%d, %f, %s, %x, etc.) using stringstream
-   * formatting. Custom types work via operator<< just like stringify().
-   *
-   * Format specifiers supported:
-   * - %d, %i: integers
-   * - %f, %F: floating point (default precision)
-   * - %.nf: floating point with n decimal places
-   * - %x, %X: hexadecimal (lowercase/uppercase)
-   * - %o: octal
-   * - %s: strings and any type with operator<<
-   * - %c: characters
-   */
-  template <typename... Args> std::string format_string(const char* format, Args&&... args) const {
-    try {
-      return detail::stream_printf(format, std::forward<Args>(args)...);
-    } catch (...) {
-      return "[printf_format_error]";
-    }
+  template <typename Format, typename... Args> void ayg_f(Format&& format, Args&&... args) const {
+    annoying_f(std::forward<Format>(format), std::forward<Args>(args)...);
   }
 };
 
@@ -1217,6 +7765,9 @@ private:
 /**
  * Set the global minimum log level.
  * Messages below this level will be filtered out.
+ *
+ * One atomic store; unlike the other settings it publishes no snapshot, so
+ * it is fine to call as often as needed.
  */
 inline void set_level(level l) { detail::config::instance().set_level(l); }
 
@@ -1225,6 +7776,27 @@ inline void set_level(level l) { detail::config::instance().set_level(l); }
  */
 inline level get_level() { return detail::config::instance().min_level(); }
 
+/**
+ * Set the level for one logger name and the names below it.
+ *
+ * Example: set_level("app.db", level::debug) enables debug output for
+ * "app.db" and "app.db.pool" but not for "app" or "app.http".
+ *
+ * Like configure(), each call that changes something publishes a new
+ * settings snapshot.
+ */
+inline void set_level(std::string_view name, level l) { detail::config::instance().set_level(name, l); }
+
+/**
+ * Remove a per-name override; the name falls back to its parent or the global level.
+ */
+inline void clear_level(std::string_view name) { detail::config::instance().clear_level(name); }
+
+/**
+ * Get the effective level for a logger name.
+ */
+inline level get_level(std::string_view name) { return detail::config::instance().resolve_level(name); }
+
 /**
  * Set the global theme for colors and formatting.
  */
@@ -1236,12 +7808,281 @@ inline void set_theme(const theme& t) { detail::config::instance().set_theme(t);
 inline theme get_theme() { return detail::config::instance().get_theme(); }
 
 /**
- * Create a logger with the given name.
+ * Change several settings in one step.
+ *
+ * The edit runs on a copy of the current settings; loggers switch to the
+ * result atomically, without pausing logging threads.
+ * Example: configure([](settings& s) { s.min_level = level::debug; s.active_theme = themes::plain; });
+ *
+ * Every call that changes anything besides min_level publishes a snapshot;
+ * the one it replaces, with the sinks and formatters it references, is freed
+ * by that call, or by a later one if a record in flight still uses it. Meant for
+ * occasional reconfiguration; use set_level(level) for frequent level toggles.
+ */
+template <typename Fn> void configure(Fn&& edit) { detail::config::instance().update(std::forward<Fn>(edit)); }
+
+/**
+ * Get a copy of the current settings.
+ */
+inline settings get_settings() { return detail::config::instance().values(); }
+
+/**
+ * Snapshot of redlog's own counters: records emitted, filtered and dropped
+ * per level, bytes, writes and flushes per sink, async queue depths
+ * and, while settings::measure_latency is on, formatting and sink write
+ * latency histograms. statistics::prometheus() renders it for scraping.
+ *
+ * Counters are per thread and summed here, so the snapshot is not an atomic
+ * cut across threads. With REDLOG_STATS=0 all counters stay zero.
+ */
+inline statistics stats() { return detail::stats_registry::instance().snapshot(); }
+
+/**
+ * Keep the last `records` filtered records at levels up to `capture` in a
+ * flight recorder. Before a record at `trigger` or more severe is written,
+ * the kept records are written through the same logger, oldest first.
+ *
+ * Kept records skip the sink and formatter; their message and fields are
+ * rendered into a fixed slot (truncated past detail::backtrace_ring::slot_text
+ * bytes). Calling this again replaces the recorder and its contents.
+ */
+inline void enable_backtrace(std::size_t records, level capture = level::debug, level trigger = level::critical) {
+  detail::backtrace_ring::publish(std::make_unique<detail::backtrace_ring>(records, capture, trigger));
+}
+
+/**
+ * Stop keeping filtered records.
+ */
+inline void disable_backtrace() { detail::backtrace_ring::publish(nullptr); }
+
+/**
+ * Write the flight recorder to a file descriptor (stderr by default) when
+ * the process dies from SIGSEGV, SIGABRT, SIGBUS, SIGFPE or SIGILL, then die
+ * as before. The handler only copies slots without locks or allocation.
+ */
+inline void install_crash_handler(int fd = 2) {
+  detail::crash_fd.store(fd, std::memory_order_relaxed);
+  for (int signal_number : {SIGSEGV, SIGABRT, SIGFPE, SIGILL}) {
+    std::signal(signal_number, detail::backtrace_signal_handler);
+  }
+#ifdef SIGBUS
+  std::signal(SIGBUS, detail::backtrace_signal_handler);
+#endif
+}
+
+namespace detail {
+
+// what registry loggers use when settings name no sink or formatter; never destroyed, like the registry
+inline sink& fallback_sink() {
+  static sink* shared = new console_sink();
+  return *shared;
+}
+
+inline const formatter& fallback_formatter() {
+  static const formatter* shared = new default_formatter();
+  return *shared;
+}
+
+/**
+ * The sink behind every get_logger() logger. Each call forwards to the sink
+ * the current settings pick for the record's logger name (sink_routes, then
+ * output_sink), so configure() redirects all of those loggers at once.
+ */
+class routed_sink : public sink {
+  static sink& target(std::string_view name) {
+    sink* routed = current_config().resolve_sink(name);
+    return routed ? *routed : fallback_sink();
+  }
+
+public:
+  // each call pins the settings, so a sink replaced meanwhile outlives the write
+  void write(std::string_view formatted) override {
+    config_pin pin;
+    target({}).write(formatted);
+  }
+
+  void write_record(level lvl, std::string_view formatted) override {
+    config_pin pin;
+    target({}).write_record(lvl, formatted);
+  }
+
+  void write_batch(std::span<const std::string_view> records, std::span<const level> levels) override {
+    config_pin pin;
+    target({}).write_batch(records, levels);
+  }
+
+  void write_entry(const log_entry& entry, const formatter& fmt) override {
+    config_pin pin;
+    target(entry.source).write_entry(entry, fmt);
+  }
+
+  // deferred if any destination takes them; write_deferred formats for the ones that do not
+  bool accepts_deferred() const noexcept override {
+    config_pin pin;
+    const config_snapshot& current = current_config();
+    if (target({}).accepts_deferred()) {
+      return true;
+    }
+    for (const auto& [name, routed] : current.values.sink_routes) {
+      if (routed && routed->accepts_deferred()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void write_deferred(deferred_record&& record) override {
+    config_pin pin;
+    sink& routed = target(record.context ? record.context->name : std::string_view());
+    if (routed.accepts_deferred() || !record.context) {
+      routed.write_deferred(std::move(record));
+      return;
+    }
+    // give a synchronous route the entry the logger would have built, so write_entry sees its fields
+    std::string message = record.message();
+    log_entry entry(record.level_val, message, record.context->name, record.context->view(), record.timestamp);
+    entry.where = record.where;
+    routed.write_entry(entry, *record.fmt);
+  }
+
+  void flush() override {
+    config_pin pin;
+    const config_snapshot& current = current_config();
+    target({}).flush();
+    for (const auto& [name, routed] : current.values.sink_routes) {
+      if (routed) {
+        routed->flush();
+      }
+    }
+  }
+};
+
+// the formatter behind every get_logger() logger: settings::output_formatter at the time of each record
+class routed_formatter : public formatter {
+  static const formatter& target() {
+    const formatter* configured = current_config().values.output_formatter.get();
+    return configured ? *configured : fallback_formatter();
+  }
+
+public:
+  std::string format(const log_entry& entry) const override {
+    config_pin pin;
+    return target().format(entry);
+  }
+
+  void format_to(fmt_buffer& out, const log_entry& entry) const override {
+    config_pin pin;
+    target().format_to(out, entry);
+  }
+};
+
+/**
+ * Loggers handed out by get_logger(): one per name, all sharing a single
+ * routed_sink and routed_formatter. Lookups walk a fixed array of bucket
+ * lists whose entries never change once published, without locking; new
+ * names are added under a mutex. Entries are never removed, like interned
+ * names, so keep logger names to a fixed vocabulary.
+ */
+class logger_registry {
+  struct entry {
+    std::string name;
+    logger prototype;
+    const entry* next;
+  };
+
+  static constexpr std::size_t bucket_count = 256;
+
+  std::array<std::atomic<const entry*>, bucket_count> buckets_{};
+  std::mutex insert_mutex_;
+  std::deque<entry> entries_; // deque: elements never move
+  std::shared_ptr<formatter> formatter_ = std::make_shared<routed_formatter>();
+  std::shared_ptr<sink> sink_ = std::make_shared<routed_sink>();
+
+  static const entry* find(const entry* first, std::string_view name) noexcept {
+    for (const entry* e = first; e; e = e->next) {
+      if (e->name == name) {
+        return e;
+      }
+    }
+    return nullptr;
+  }
+
+public:
+  static logger_registry& instance() {
+    static logger_registry* registry = new logger_registry(); // never destroyed: loggers may be fetched during exit
+    return *registry;
+  }
+
+  const logger& get(std::string_view name) {
+    std::atomic<const entry*>& bucket = buckets_[std::hash<std::string_view>{}(name) % bucket_count];
+    if (const entry* found = find(bucket.load(std::memory_order_acquire), name)) {
+      return found->prototype;
+    }
+
+    std::lock_guard<std::mutex> lock(insert_mutex_);
+    const entry* head = bucket.load(std::memory_order_relaxed);
+    if (const entry* found = find(head, name)) {
+      return found->prototype;
+    }
+    const entry& added = entries_.emplace_back(entry{std::string(name), logger(name, formatter_, sink_), head});
+    bucket.store(&added, std::memory_order_release);
+    return added.prototype;
+  }
+};
+
+} // namespace detail
+
+/**
+ * Get the logger for a name.
  *
- * This is the main entry point for creating loggers.
+ * This is the main entry point for creating loggers. Loggers for the same
+ * name share everything, so after the first call for a name this is a
+ * lock-free lookup and a copy, without allocating. They write through the
+ * sink and formatter chosen by settings (set_default_sink(), set_sink(),
+ * set_default_formatter()), which can be changed while they run.
  * Example: auto log = redlog::get_logger("app");
  */
-inline logger get_logger(std::string_view name = "") { return logger(name); }
+inline logger get_logger(std::string_view name = "") { return detail::logger_registry::instance().get(name); }
+
+/**
+ * Where get_logger() loggers write; null restores the shared console_sink.
+ *
+ * The replaced sink is released by this call, or by a later configure() if
+ * a record in flight still writes to it; flush one before replacing it if
+ * it buffers.
+ */
+inline void set_default_sink(std::shared_ptr<sink> sink_ptr) {
+  configure([&sink_ptr](settings& s) { s.output_sink = std::move(sink_ptr); });
+}
+
+/**
+ * How get_logger() loggers format records; null restores the shared default_formatter.
+ */
+inline void set_default_formatter(std::shared_ptr<formatter> fmt) {
+  configure([&fmt](settings& s) { s.output_formatter = std::move(fmt); });
+}
+
+/**
+ * Send records of get_logger() loggers named `name`, or below it, to their own sink.
+ *
+ * Example: set_sink("app.audit", audit_file) routes "app.audit" and
+ * "app.audit.login" but leaves "app" on the default sink.
+ */
+inline void set_sink(std::string_view name, std::shared_ptr<sink> sink_ptr) {
+  configure([name, &sink_ptr](settings& s) { s.sink_routes.insert_or_assign(std::string(name), std::move(sink_ptr)); });
+}
+
+/**
+ * Remove a route; the name falls back to its parent's route or the default sink.
+ */
+inline void clear_sink(std::string_view name) {
+  configure([name](settings& s) {
+    auto found = s.sink_routes.find(name);
+    if (found != s.sink_routes.end()) {
+      s.sink_routes.erase(found);
+    }
+  });
+}
 
 /**
  * general-purpose string formatting using stream-based printf.
@@ -1268,7 +8109,95 @@ template <typename... Args> std::string fmt(const char* format, Args&&... args)
   }
 }
 
+/**
+ * compile-time checked variant: redlog::fmt(REDLOG_FMT("%s: %d"), name, count).
+ * the format is parsed during compilation and argument count and types are verified.
+ */
+template <detail::fixed_string Format, typename... Args>
+std::string fmt(detail::compiled_format<Format> format, Args&&... args) {
+  static_assert(detail::compiled_format<Format>::template check<std::decay_t<Args>...>());
+  try {
+    return detail::stream_printf(format, std::forward<Args>(args)...);
+  } catch (...) {
+    return "[format_error]";
+  }
+}
+
 } // namespace redlog
 
+/**
+ * Level-checked logging: arguments are not evaluated when the level is disabled.
+ *
+ *   REDLOG_DEBUG(log, "cache state", redlog::field("entries", cache.dump()));
+ *   REDLOG_DEBUG_F(log, "took %.2f ms", timer.elapsed_ms());
+ *
+ * Levels above REDLOG_MIN_LEVEL are removed at compile time: the call sits
+ * in a discarded if constexpr branch, so it is type-checked but generates no
+ * code and instantiates nothing. REDLOG_MIN_LEVEL is read where the macro
+ * expands.
+ *
+ * Each expansion also defines its call site at compile time; records carry
+ * it for the levels in settings::source_levels.
+ */
+#define REDLOG_LOG_IF_(logger_expr, lvl, method, ...)                                                                  \
+  do {                                                                                                                 \
+    if constexpr (static_cast<int>(::redlog::level::lvl) <= REDLOG_MIN_LEVEL) {                                        \
+      const ::redlog::logger& redlog_logger_ = (logger_expr);                                                          \
+      if (redlog_logger_.enabled(::redlog::level::lvl)) {                                                              \
+        static constexpr ::redlog::source_site redlog_site_{                                                           \
+            ::redlog::detail::source_path(__FILE__), __LINE__, __func__                                                \
+        };                                                                                                             \
+        redlog_logger_.at(redlog_site_).method(__VA_ARGS__);                                                           \
+      }                                                                                                                \
+    }                                                                                                                  \
+  } while (0)
+
+#define REDLOG_CRITICAL(log, ...) REDLOG_LOG_IF_(log, critical, critical, __VA_ARGS__)
+#define REDLOG_ERROR(log, ...) REDLOG_LOG_IF_(log, error, error, __VA_ARGS__)
+#define REDLOG_WARN(log, ...) REDLOG_LOG_IF_(log, warn, warn, __VA_ARGS__)
+#define REDLOG_INFO(log, ...) REDLOG_LOG_IF_(log, info, info, __VA_ARGS__)
+#define REDLOG_VERBOSE(log, ...) REDLOG_LOG_IF_(log, verbose, verbose, __VA_ARGS__)
+#define REDLOG_TRACE(log, ...) REDLOG_LOG_IF_(log, trace, trace, __VA_ARGS__)
+#define REDLOG_DEBUG(log, ...) REDLOG_LOG_IF_(log, debug, debug, __VA_ARGS__)
+#define REDLOG_PEDANTIC(log, ...) REDLOG_LOG_IF_(log, pedantic, pedantic, __VA_ARGS__)
+#define REDLOG_ANNOYING(log, ...) REDLOG_LOG_IF_(log, annoying, annoying, __VA_ARGS__)
+
+#define REDLOG_CRITICAL_F(log, ...) REDLOG_LOG_IF_(log, critical, critical_f, __VA_ARGS__)
+#define REDLOG_ERROR_F(log, ...) REDLOG_LOG_IF_(log, error, error_f, __VA_ARGS__)
+#define REDLOG_WARN_F(log, ...) REDLOG_LOG_IF_(log, warn, warn_f, __VA_ARGS__)
+#define REDLOG_INFO_F(log, ...) REDLOG_LOG_IF_(log, info, info_f, __VA_ARGS__)
+#define REDLOG_VERBOSE_F(log, ...) REDLOG_LOG_IF_(log, verbose, verbose_f, __VA_ARGS__)
+#define REDLOG_TRACE_F(log, ...) REDLOG_LOG_IF_(log, trace, trace_f, __VA_ARGS__)
+#define REDLOG_DEBUG_F(log, ...) REDLOG_LOG_IF_(log, debug, debug_f, __VA_ARGS__)
+#define REDLOG_PEDANTIC_F(log, ...) REDLOG_LOG_IF_(log, pedantic, pedantic_f, __VA_ARGS__)
+#define REDLOG_ANNOYING_F(log, ...) REDLOG_LOG_IF_(log, annoying, annoying_f, __VA_ARGS__)
+
+/**
+ * Rate-limited logging: each expansion is its own call site with its own
+ * limit, fixed on first use.
+ *
+ *   REDLOG_EVERY_N(log, 1000).warn("retrying", redlog::field("attempt", n));  // 1st, 1001st, ...
+ *   REDLOG_EVERY_MS(log, 100).warn_f("queue full (%zu)", depth);            // at most 10 per second
+ *   REDLOG_RATE_LIMIT(log, 50, 10).info("request");                          // 50 per second, bursts of 10
+ *   REDLOG_SAMPLE(log, 0.01).debug("packet", redlog::field("len", len));     // about 1 in 100
+ *
+ * arguments are still evaluated for rejected calls; only formatting and output
+ * are skipped. use redlog::field::lazy for expensive values.
+ */
+#define REDLOG_RATE_SITE_(...)                                                                                         \
+  ([&]() -> ::redlog::detail::rate_site& {                                                                             \
+    static ::redlog::detail::rate_site redlog_site_ = ::redlog::detail::rate_site::__VA_ARGS__;                        \
+    return redlog_site_;                                                                                               \
+  }())
+
+#define REDLOG_EVERY_N(log, n) ::redlog::limited_logger((log), REDLOG_RATE_SITE_(every(n)))
+#define REDLOG_EVERY_MS(log, ms)                                                                                       \
+  ::redlog::limited_logger((log), REDLOG_RATE_SITE_(every_interval(::std::chrono::milliseconds(ms))))
+#define REDLOG_RATE_LIMIT(log, rate, burst) ::redlog::limited_logger((log), REDLOG_RATE_SITE_(per_second(rate, burst)))
+#define REDLOG_SAMPLE(log, probability) ::redlog::limited_logger((log), REDLOG_RATE_SITE_(sampled(probability)))
+
 // cleanup
-#undef REDLOG_IS_TTY
\ No newline at end of file
+#undef REDLOG_IS_TTY
+#undef REDLOG_HAS_TSC
+#undef REDLOG_HAS_SSE2
+#undef REDLOG_HAS_NEON
\ No newline at end of file
@@ -1,28 +1,67 @@
 #include <cassert>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <redlog.hpp>
 #include <sstream>
 #include <thread>
 #include <vector>
 
-// String sink for capturing output in tests
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Global allocation counter, enabled per thread by allocation tests
+namespace alloc_tracking {
+thread_local bool enabled = false;
+thread_local size_t count = 0;
+} // namespace alloc_tracking
+
+void* operator new(std::size_t size) {
+  if (alloc_tracking::enabled) {
+    alloc_tracking::count++;
+  }
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// String sink for capturing output in tests; locked, since several tests write from many threads
 class string_sink : public redlog::sink {
+  mutable std::mutex mutex_;
   std::ostringstream buffer_;
 
 public:
-  void write(std::string_view formatted) override { buffer_ << formatted << "\n"; }
+  void write(std::string_view formatted) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer_ << formatted << "\n";
+  }
 
   void flush() override {
     // No-op for string sink
   }
 
-  std::string get_output() const { return buffer_.str(); }
+  std::string get_output() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return buffer_.str();
+  }
 
   void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
     buffer_.str("");
     buffer_.clear();
   }
@@ -71,7 +110,7 @@ public:
 
     // Source component
     if (!entry.source.empty()) {
-      std::string source_part = entry.source;
+      std::string source_part(entry.source);
       oss << redlog::detail::colorize(source_part, theme_.source_color) << " ";
     }
 
@@ -92,7 +131,7 @@ public:
         }
         first = false;
         oss << redlog::detail::colorize(f.key, theme_.field_key_color) << "="
-            << redlog::detail::colorize(f.value, theme_.field_value_color);
+            << redlog::detail::colorize(f.value.str(), theme_.field_value_color);
       }
       oss << "]";
     }
@@ -183,6 +222,23 @@ struct test_object {
   }
 };
 
+// small trivially copyable type with operator<<
+struct test_point {
+  int x;
+  int y;
+
+  friend std::ostream& operator<<(std::ostream& os, const test_point& p) { return os << p.x << "," << p.y; }
+};
+
+template <> struct redlog::inline_field_value<test_point> : std::true_type {};
+
+// trivially copyable, but streams data it only points at
+struct test_label {
+  const char* text;
+
+  friend std::ostream& operator<<(std::ostream& os, const test_label& l) { return os << l.text; }
+};
+
 // helper function to strip ansi color codes for testing
 std::string strip_ansi_colors(const std::string& input) {
   std::string result;
@@ -246,7 +302,7 @@ void test_field_system() {
   field f_bool("bool", true);
 
   assert(f_int.value == "42");
-  assert(f_float.value.find("3.14") != std::string::npos);
+  assert(f_float.value.str().find("3.14") != std::string::npos);
   assert(f_bool.value == "1" || f_bool.value == "true");
 
   // Test logging with fields
@@ -1175,23 +1231,23 @@ void test_field_formatting_edge_cases() {
   // Test field with special characters
   {
     field special_field("special", "!@#$%^&*()+={}[]|\\:;\"'<>,.?/");
-    assert(special_field.value.find("!@#$") != std::string::npos);
+    assert(special_field.value.str().find("!@#$") != std::string::npos);
   }
 
   // Test field with unicode characters
   {
     field unicode_field("unicode", "Hello 世界 🌍");
-    assert(unicode_field.value.find("世界") != std::string::npos);
-    assert(unicode_field.value.find("🌍") != std::string::npos);
+    assert(unicode_field.value.str().find("世界") != std::string::npos);
+    assert(unicode_field.value.str().find("🌍") != std::string::npos);
   }
 
   // Test field with moderately long values
   {
     std::string long_value(100, 'x');
     field long_field("long", long_value);
-    assert(long_field.value.length() == 100);
-    assert(long_field.value.front() == 'x');
-    assert(long_field.value.back() == 'x');
+    assert(long_field.value.str().length() == 100);
+    assert(long_field.value.str().front() == 'x');
+    assert(long_field.value.str().back() == 'x');
   }
 
   // Test numeric field precision
@@ -1201,10 +1257,10 @@ void test_field_formatting_edge_cases() {
     field int_field("int", 2147483647);
     field long_field("long", -1234567890L);
 
-    assert(!float_field.value.empty());
-    assert(!double_field.value.empty());
-    assert(int_field.value.find("2147483647") != std::string::npos);
-    assert(!long_field.value.empty());
+    assert(!float_field.value.str().empty());
+    assert(!double_field.value.str().empty());
+    assert(int_field.value.str().find("2147483647") != std::string::npos);
+    assert(!long_field.value.str().empty());
   }
 
   // Test field with custom object
@@ -1212,9 +1268,9 @@ void test_field_formatting_edge_cases() {
     test_object obj{-42, "test with spaces and symbols !@#"};
     field obj_field("object", obj);
 
-    assert(obj_field.value.find("TestObject") != std::string::npos);
-    assert(obj_field.value.find("-42") != std::string::npos);
-    assert(obj_field.value.find("test with spaces") != std::string::npos);
+    assert(obj_field.value.str().find("TestObject") != std::string::npos);
+    assert(obj_field.value.str().find("-42") != std::string::npos);
+    assert(obj_field.value.str().find("test with spaces") != std::string::npos);
   }
 
   // Test boolean field representation
@@ -1298,7 +1354,7 @@ void test_field_set_advanced_operations() {
     auto fields = mixed_fs.fields();
     std::vector<std::string> values;
     for (const auto& f : fields) {
-      values.push_back(f.value);
+      values.push_back(f.value.str());
     }
 
     // Check that all different types are properly converted
@@ -1380,6 +1436,2109 @@ void test_custom_components() {
   assert(clean_output.find("key2=42") != std::string::npos);
 }
 
+void test_async_sink() {
+  using namespace redlog;
+
+  // records from several threads all arrive after flush()
+  {
+    auto inner = std::make_shared<test_sink>();
+    auto async = std::make_shared<async_sink>(inner, 64, overflow_policy::block);
+    logger async_log("async", async);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&async_log, t]() {
+        for (int i = 0; i < 250; ++i) {
+          async_log.info("async message", field("thread", t), field("i", i));
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+
+    async->flush();
+    std::string output = inner->get_output();
+    assert(std::count(output.begin(), output.end(), '\n') == 1000);
+    assert(async->dropped() == 0);
+  }
+
+  // drop policies never block and account for every record
+  {
+    struct gated_sink : redlog::sink {
+      std::atomic<bool> open{false};
+      std::atomic<int> lines{0};
+      void write(std::string_view) override {
+        while (!open.load()) {
+          std::this_thread::yield();
+        }
+        lines++;
+      }
+      void flush() override {}
+    };
+
+    for (auto policy : {overflow_policy::drop_newest, overflow_policy::drop_oldest}) {
+      auto inner = std::make_shared<gated_sink>();
+      auto async = std::make_shared<async_sink>(inner, 8, policy);
+      for (int i = 0; i < 100; ++i) {
+        async->write("record");
+      }
+      inner->open = true;
+      async->flush();
+      assert(async->dropped() > 0);
+      assert(inner->lines + static_cast<int>(async->dropped()) == 100);
+    }
+  }
+
+  // flushes racing with writes return, and cover the caller's own records
+  {
+    struct counting_sink : redlog::sink {
+      std::array<std::atomic<int>, 4> lines{};
+      void write(std::string_view formatted) override { lines[static_cast<std::size_t>(formatted[0] - '0')]++; }
+      void flush() override {}
+    };
+
+    auto inner = std::make_shared<counting_sink>();
+    auto async = std::make_shared<async_sink>(inner, 16);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&inner, &async, t]() {
+        const std::string text(1, static_cast<char>('0' + t));
+        for (int i = 1; i <= 200; ++i) {
+          async->write(text);
+          async->flush();
+          assert(inner->lines[static_cast<std::size_t>(t)] == i);
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+
+  // destruction drains the queue
+  {
+    auto inner = std::make_shared<test_sink>();
+    {
+      async_sink async(inner, 16);
+      for (int i = 0; i < 50; ++i) {
+        async.write("drained");
+      }
+    }
+    std::string output = inner->get_output();
+    assert(std::count(output.begin(), output.end(), '\n') == 50);
+  }
+}
+
+void test_deferred_formatting() {
+  using namespace redlog;
+
+  // sink that keeps deferred records and formats them only when asked
+  struct deferring_sink : redlog::sink {
+    std::vector<detail::deferred_record> records;
+    std::vector<std::string> lines;
+    void write(std::string_view formatted) override { lines.emplace_back(formatted); }
+    void flush() override {}
+    bool accepts_deferred() const noexcept override { return true; }
+    void write_deferred(detail::deferred_record&& record) override { records.push_back(std::move(record)); }
+  };
+
+  auto capture = std::make_shared<deferring_sink>();
+  auto direct = std::make_shared<string_sink>();
+  logger deferred_log("deferred", capture);
+  logger direct_log("deferred", direct);
+
+  {
+    std::string temporary = "short-lived";
+    deferred_log.info_f("user %s took %.2f ms (%d, 0x%04x) %s", temporary, 12.345, -7, 255, "literal");
+    direct_log.info_f("user %s took %.2f ms (%d, 0x%04x) %s", temporary, 12.345, -7, 255, "literal");
+    temporary.assign(temporary.size(), '#'); // arguments are copied, not referenced
+  }
+
+  // only plain arguments are deferred; custom types format eagerly
+  deferred_log.info_f("object %s", test_object{1, "x"});
+  const char* null_str = nullptr;
+  deferred_log.info_f("null %s", null_str);
+  direct_log.info_f("null %s", null_str);
+
+  assert(capture->records.size() == 2);
+  assert(capture->lines.size() == 1);
+  assert(capture->records[0].materialize() + "\n" + capture->records[1].materialize() + "\n" == direct->get_output());
+  assert(capture->lines[0].find("TestObject{1, x}") != std::string::npos);
+
+  // async sinks format deferred records on their worker thread
+  auto inner = std::make_shared<test_sink>();
+  auto async = std::make_shared<async_sink>(inner);
+  logger async_log("deferred", async);
+  async_log.with_field("ctx", 1).warn_f("count=%d ratio=%.1f", 42, 0.5);
+  async->flush();
+  std::string output = strip_ansi_colors(inner->get_output());
+  assert(output.find("count=42 ratio=0.5") != std::string::npos);
+  assert(output.find("ctx=1") != std::string::npos);
+}
+
+void test_compiled_format() {
+  using namespace redlog;
+
+  // compiled formats produce the same text as the runtime parser
+  assert(fmt(REDLOG_FMT("Value: %d"), 42) == fmt("Value: %d", 42));
+  assert(fmt(REDLOG_FMT("%5d|%-5d|%05d"), 123, 123, 123) == "  123|123  |00123");
+  assert(fmt(REDLOG_FMT("%.2f %8.2f %-8.2f|"), 3.14159, 3.14159, 3.14159) == "3.14     3.14 3.14    |");
+  assert(fmt(REDLOG_FMT("%x %X %o %08x"), 255, 255, 64, 255) == "ff FF 100 000000ff");
+  assert(fmt(REDLOG_FMT("%c%s"), 65, "bc") == "Abc");
+  assert(fmt(REDLOG_FMT("%s and %s"), std::string("std"), test_object{7, "obj"}) == "std and TestObject{7, obj}");
+  assert(fmt(REDLOG_FMT("Progress: %d%% of %d"), 50, 100) == "Progress: 50% of 100");
+  assert(fmt(REDLOG_FMT("%%%%")) == "%%");
+  assert(fmt(REDLOG_FMT("")) == "");
+  assert(fmt(REDLOG_FMT("%ld %lx"), 456L, 456L) == "456 1c8");
+
+  // layout is computed during compilation
+  constexpr auto layout = detail::compiled_format<"a%db%%c%.3f">::layout;
+  static_assert(layout.spec_count == 2);
+  static_assert(layout.specs[1].format_char == 'f' && layout.specs[1].precision == 3);
+  static_assert(std::string_view(layout.literals, layout.literal_size) == "ab%c");
+
+  // logger integration, including the short forms
+  auto sink_ptr = std::make_shared<string_sink>();
+  logger log("compiled", sink_ptr);
+  log.info_f(REDLOG_FMT("user %s took %.2f ms"), "alice", 1.5);
+  log.wrn_f(REDLOG_FMT("retry %d"), 3);
+  std::string output = sink_ptr->get_output();
+  assert(output.find("user alice took 1.50 ms") != std::string::npos);
+  assert(output.find("retry 3") != std::string::npos);
+
+  // compiled formats can be deferred too
+  auto inner = std::make_shared<test_sink>();
+  auto async = std::make_shared<async_sink>(inner);
+  logger async_log("compiled", async);
+  async_log.info_f(REDLOG_FMT("id=%04x name=%s"), 10, std::string("bob"));
+  async->flush();
+  assert(inner->get_output().find("id=000a name=bob") != std::string::npos);
+}
+
+void test_fmt_buffer() {
+  using namespace redlog;
+
+  // inline storage grows on demand
+  detail::fmt_buffer buffer;
+  std::size_t inline_capacity = buffer.capacity();
+  buffer.append("abc");
+  buffer.push_back('d');
+  buffer.append(3, '-');
+  assert(buffer.view() == "abcd---");
+  std::string big(inline_capacity * 3, 'z');
+  buffer.append(big);
+  assert(buffer.size() == 7 + big.size());
+  assert(buffer.view().substr(0, 7) == "abcd---");
+  assert(buffer.capacity() >= buffer.size());
+  buffer.clear();
+  assert(buffer.empty());
+
+  // appending formats directly into a buffer
+  detail::stream_printf_to(buffer, "%s=%05.1f;", "load", 2.25);
+  detail::stream_printf_to(buffer, REDLOG_FMT("%-4x|"), 171);
+  assert(buffer.view() == "load=002.2;ab  |");
+
+  // numeric output matches the stream-based implementation, including
+  // precision and uppercase carried across specifiers
+  assert(fmt("%.2f %f", 1.0, 3.14159) == "1.00 3.1");
+  assert(fmt("%X %e", 255, 1234.5) == "FF 1.234500E+03");
+  assert(fmt("%06d", -42) == "000-42");
+  assert(fmt("%f", 1e20) == "1e+20");
+  assert(fmt("%12.3e|", 1234.5) == "   1.234e+03|");
+  assert(fmt("%-6.1f|", -0.25) == "-0.2  |");
+  assert(fmt("%.400f", 1.0).size() == 402);
+
+  // stringify matches std::to_string for arithmetic types
+  assert(detail::stringify(-1.5f) == std::to_string(-1.5f));
+  assert(detail::stringify(1e300) == std::to_string(1e300));
+  assert(detail::stringify('x') == std::to_string('x'));
+  assert(detail::stringify(18446744073709551615ULL) == "18446744073709551615");
+  const char* null_str = nullptr;
+  assert(detail::stringify(null_str) == "null");
+}
+
+void test_allocation_free_logging() {
+  using namespace redlog;
+
+  // discards output so only the logging path itself is measured
+  class null_sink : public sink {
+  public:
+    size_t writes = 0;
+    void write(std::string_view formatted) override { writes += formatted.empty() ? 0 : 1; }
+    void flush() override {}
+  };
+
+  auto sink_ptr = std::make_shared<null_sink>();
+  auto log = logger("alloc", std::make_shared<default_formatter>(), sink_ptr);
+  auto scoped = log.with_field("request_id", 12345).with_field("user", "alice");
+
+  const auto run = [&] {
+    log.info("msg", field("k", 42));
+    scoped.info("scoped", field("attempt", 3));
+    log.info_f("value %d of %s", 7, "seven");
+  };
+
+  // warm up thread-local scratch buffers
+  run();
+
+  alloc_tracking::count = 0;
+  alloc_tracking::enabled = true;
+  for (int i = 0; i < 100; ++i) {
+    run();
+  }
+  alloc_tracking::enabled = false;
+
+  assert(alloc_tracking::count == 0);
+  assert(sink_ptr->writes == 303);
+}
+
+void test_ansi_styles() {
+  using namespace redlog;
+
+  // precomputed sequences match the on-the-fly encoding
+  detail::ansi_style both(color::red, color::on_blue, true);
+  assert(both.active());
+  assert(both.open() == "\033[31;44m");
+  assert(both.close() == "\033[0m");
+  assert(both.overhead() == both.open().size() + 4);
+
+  detail::fmt_buffer out;
+  both.wrap(out, "text");
+  assert(out.view() == "\033[31;44mtext\033[0m");
+
+  assert(detail::ansi_style(color::none, color::on_red, true).open() == "\033[41m");
+  assert(detail::ansi_style(color::bright_white, color::none, true).open() == "\033[97m");
+
+  // no colors or disabled output wrap nothing
+  detail::ansi_style plain(color::none, color::none, true);
+  detail::ansi_style disabled(color::red, color::none, false);
+  assert(!plain.active() && plain.open().empty() && plain.close().empty());
+  assert(!disabled.active() && disabled.overhead() == 0);
+
+  out.clear();
+  disabled.wrap(out, "text");
+  assert(out.view() == "text");
+
+  // out-of-range levels still get a label
+  default_formatter formatter(themes::plain);
+  log_entry entry(static_cast<level>(42), "msg", "", field_set{});
+  std::string line = formatter.format(entry);
+  assert(line.find("[unk]") == 0);
+}
+
+void test_context_chains() {
+  using namespace redlog;
+
+  auto sink_ptr = std::make_shared<string_sink>();
+  auto base = logger("chain", std::make_shared<default_formatter>(themes::plain), sink_ptr);
+
+  // deep chains get flattened but keep every field in order
+  logger deep = base;
+  for (int i = 0; i < 20; ++i) {
+    deep = deep.with_field("k" + std::to_string(i), i);
+    if (i % 5 == 0) {
+      deep = deep.with_name("n" + std::to_string(i));
+    }
+  }
+  deep.info("deep", field("local", "yes"));
+  std::string output = sink_ptr->get_output();
+  std::size_t pos = 0;
+  for (int i = 0; i < 20; ++i) {
+    std::string expected = "k" + std::to_string(i) + "=" + std::to_string(i);
+    std::size_t found = output.find(expected, pos);
+    assert(found != std::string::npos);
+    pos = found + expected.size();
+  }
+  assert(output.find("local=yes", pos) != std::string::npos);
+  assert(output.find("[chain.n0.n5.n10.n15]") != std::string::npos);
+
+  // siblings share a parent without seeing each other's fields
+  sink_ptr->clear();
+  auto parent = base.with_fields(field("shared", 1), field("scope", "req"));
+  auto left = parent.with_field("side", "left");
+  auto right = parent.with_field("side", "right");
+  left.info("left");
+  right.info("right");
+  parent.info("parent");
+  output = sink_ptr->get_output();
+  assert(output.find("shared=1 scope=req side=left") != std::string::npos);
+  assert(output.find("shared=1 scope=req side=right") != std::string::npos);
+  assert(output.find("side=left side=right") == std::string::npos);
+  std::string parent_line = output.substr(output.find("parent"));
+  assert(parent_line.find("side=") == std::string::npos);
+
+  // empty field sets and renames keep inherited fields
+  sink_ptr->clear();
+  const field_set no_fields;
+  parent.with_fields(no_fields).with_name("sub").info("renamed");
+  output = sink_ptr->get_output();
+  assert(output.find("[chain.sub]") != std::string::npos);
+  assert(output.find("shared=1 scope=req") != std::string::npos);
+}
+
+std::string read_file(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void test_buffered_file_sink() {
+  using namespace redlog;
+
+  const std::string path = "redlog_test_buffered.log";
+  std::remove(path.c_str());
+
+  {
+    flush_policy policy;
+    policy.buffer_size = 64;
+    policy.interval = std::chrono::milliseconds(0);
+
+    buffered_file_sink sink(path, policy);
+
+    // info records stay in the buffer
+    sink.write_record(level::info, "one");
+    sink.write_record(level::info, "two");
+    assert(read_file(path).empty());
+    assert(sink.buffered() == 8);
+    assert(sink.write_calls() == 0);
+
+    // severe records push everything out
+    sink.write_record(level::error, "three");
+    assert(read_file(path) == "one\ntwo\nthree\n");
+    assert(sink.buffered() == 0);
+    assert(sink.write_calls() == 1);
+
+    // a full buffer is written before new data is added
+    std::string chunk(40, 'a');
+    sink.write(chunk);
+    sink.write(chunk);
+    assert(sink.write_calls() == 2);
+    assert(sink.buffered() == 41);
+
+    // oversized records go out together with the pending buffer
+    std::string large(100, 'b');
+    sink.write(large);
+    assert(sink.write_calls() == 3);
+    assert(sink.buffered() == 0);
+    assert(read_file(path) == "one\ntwo\nthree\n" + chunk + "\n" + chunk + "\n" + large + "\n");
+  }
+  std::remove(path.c_str());
+
+  // record count trigger, through a logger
+  {
+    flush_policy policy;
+    policy.max_records = 3;
+    policy.flush_level.reset();
+    policy.sync = true;
+
+    auto sink_ptr = std::make_shared<buffered_file_sink>(path, policy);
+    auto log = logger("buffered", std::make_shared<default_formatter>(themes::plain), sink_ptr);
+    log.critical("first");
+    log.info("second");
+    assert(sink_ptr->write_calls() == 0);
+    log.info("third");
+    assert(sink_ptr->write_calls() == 1);
+
+    std::string contents = read_file(path);
+    assert(contents.find("first") < contents.find("second"));
+    assert(contents.find("third") != std::string::npos);
+
+    // destruction writes whatever is left
+    log.info("fourth");
+  }
+  assert(read_file(path).find("fourth") != std::string::npos);
+  std::remove(path.c_str());
+}
+
+void test_rotating_file_sink() {
+  using namespace redlog;
+
+  const std::string path = "redlog_test_rotating.log";
+  const auto cleanup = [&] {
+    for (const char* suffix : {"", ".1", ".2", ".3", ".1.z", ".2.z", ".3.z"}) {
+      std::remove((path + suffix).c_str());
+    }
+  };
+  cleanup();
+
+  std::atomic<int> compressed{0};
+  rotation_policy policy;
+  policy.max_size = 50;
+  policy.max_files = 2;
+  policy.compressed_extension = ".z";
+  policy.compressor = [&compressed](const std::string& from, const std::string& to) {
+    std::ofstream(to, std::ios::binary) << read_file(from);
+    compressed++;
+    return true;
+  };
+
+  {
+    rotating_file_sink sink(path, policy);
+    for (int i = 0; i < 23; ++i) {
+      sink.write_record(level::info, "record-" + std::string(i < 10 ? "0" : "") + std::to_string(i));
+    }
+    assert(sink.rotations() == 4);
+
+    sink.flush();
+    sink.wait_for_archives();
+    assert(compressed == 4);
+
+    // newest archive first, older ones beyond max_files are gone
+    assert(read_file(path + ".1.z").find("record-15\nrecord-16") == 0);
+    assert(read_file(path + ".2.z").find("record-10") == 0);
+    assert(read_file(path + ".3.z").empty());
+    assert(read_file(path + ".1").empty());
+    assert(read_file(path) == "record-20\nrecord-21\nrecord-22\n");
+  }
+
+  // with the next segment prepared in the background, rotating only swaps it in
+  {
+    rotation_policy small;
+    small.max_size = 20;
+    small.max_files = 1;
+    rotating_file_sink sink(path, small);
+    sink.wait_for_archives();
+    sink.write_record(level::info, "first-segment");
+    sink.write_record(level::info, "second-segment");
+    sink.flush();
+    sink.wait_for_archives();
+    assert(sink.rotations() == 2);
+    assert(read_file(path + ".1") == "first-segment\n");
+    assert(read_file(path) == "second-segment\n");
+  }
+
+  // staging files for segments never swapped in are removed
+  for (int i = 1; i <= 64; ++i) {
+    assert(!std::ifstream(path + ".next." + std::to_string(i)).good());
+  }
+
+  cleanup();
+}
+
+void test_mmap_file_sink() {
+#ifndef _WIN32
+  using namespace redlog;
+
+  const std::string path = "redlog_test_mmap.log";
+  std::remove(path.c_str());
+
+  constexpr int thread_count = 4;
+  constexpr int records_per_thread = 500;
+
+  {
+    // one-page segments force many rolls, including records split across them
+    mmap_policy policy;
+    policy.segment_size = 1;
+    policy.sync_interval = std::chrono::milliseconds(1);
+    mmap_file_sink sink(path, policy);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+      threads.emplace_back([&sink, t] {
+        for (int i = 0; i < records_per_thread; ++i) {
+          sink.write("thread " + std::to_string(t) + " record " + std::to_string(i));
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    sink.flush();
+  }
+
+  std::string contents = read_file(path);
+  assert(contents.find('\0') == std::string::npos);
+  std::size_t lines = 0;
+  for (char c : contents) {
+    lines += c == '\n' ? 1 : 0;
+  }
+  assert(lines == thread_count * records_per_thread);
+  for (int t = 0; t < thread_count; ++t) {
+    assert(contents.find("thread " + std::to_string(t) + " record 499\n") != std::string::npos);
+  }
+
+  // reopening appends after the trimmed end
+  {
+    mmap_file_sink sink(path);
+    sink.write("appended");
+    assert(sink.bytes_written() == contents.size() + 9);
+  }
+  assert(read_file(path) == contents + "appended\n");
+
+  // after a crash the mapped tail is still zero-filled; reopening continues after the last record
+  {
+    std::ofstream(path, std::ios::binary | std::ios::app) << std::string(10000, '\0');
+  }
+  {
+    mmap_file_sink sink(path);
+    sink.write("after crash");
+    sink.flush();
+  }
+  assert(read_file(path) == contents + "appended\nafter crash\n");
+  std::remove(path.c_str());
+#endif
+}
+
+void test_binary_log() {
+  using namespace redlog;
+
+  const std::string path = "redlog_test_binary.rlog";
+  std::remove(path.c_str());
+
+  struct scoped_level {
+    level previous = get_level();
+    scoped_level() { set_level(level::debug); }
+    ~scoped_level() { set_level(previous); }
+  } debug_level;
+
+  {
+    auto sink_ptr = std::make_shared<binary_sink>(path);
+    auto log = logger("bin", std::make_shared<binary_formatter>(), sink_ptr).with_field("request", 42);
+
+    log.info("started", field("user", "alice"), field("count", 7), field("zero", "007"));
+    log.warn_f("value %d of %s, ratio %.2f, char %c", -5, "ten", 0.25, 'x'); // stored unformatted
+    log.debug_f(REDLOG_FMT("%08x|%-6s|"), 255u, std::string("pad"));
+    log.with_name("child").error_f("%s then %p", static_cast<const char*>(nullptr), static_cast<void*>(nullptr));
+    log.info_f("no args %d");
+    sink_ptr->write("plain text");
+  }
+
+  std::string data = read_file(path);
+  assert(data.substr(0, 4) == "RLOG");
+
+  binary_reader reader(data);
+  binary_record record;
+  std::vector<binary_record> records;
+  while (reader.next(record)) {
+    records.push_back(std::move(record));
+    record = binary_record{};
+  }
+  assert(reader.error().empty());
+  assert(records.size() == 6);
+
+  assert(records[0].level_val == level::info);
+  assert(records[0].source == "bin");
+  assert(records[0].message == "started");
+  assert(records[0].format.empty());
+  std::vector<std::pair<std::string, std::string>> expected_fields = {
+      {"request", "42"}, {"user", "alice"}, {"count", "7"}, {"zero", "007"}
+  };
+  assert(records[0].fields.size() == expected_fields.size());
+  for (std::size_t i = 0; i < expected_fields.size(); ++i) {
+    assert(records[0].fields.fields()[i].key == expected_fields[i].first);
+    assert(records[0].fields.fields()[i].value == expected_fields[i].second);
+  }
+
+  assert(records[1].level_val == level::warn);
+  assert(records[1].format == "value %d of %s, ratio %.2f, char %c");
+  assert(records[1].message == fmt("value %d of %s, ratio %.2f, char %c", -5, "ten", 0.25, 'x'));
+  assert(records[1].fields.size() == 1);
+
+  assert(records[2].message == fmt("%08x|%-6s|", 255u, std::string("pad")));
+  assert(records[3].source == "bin.child");
+  assert(records[3].message == fmt("%s then %p", static_cast<const char*>(nullptr), static_cast<void*>(nullptr)));
+  assert(records[4].message == "no args %d");
+  assert(records[5].message == "plain text" && records[5].source.empty());
+
+  // timestamps survive delta encoding
+  for (std::size_t i = 1; i < 5; ++i) {
+    assert(records[i].timestamp >= records[i - 1].timestamp);
+  }
+
+  // decoded records render like live ones
+  default_formatter formatter(themes::plain);
+  std::string line = formatter.format(records[0].entry());
+  assert(line.find("[bin]") == 0 && line.find("request=42 user=alice count=7 zero=007") != std::string::npos);
+
+  // truncated streams decode up to the damage and report it
+  binary_reader truncated(std::string_view(data).substr(0, data.size() - 3));
+  std::size_t decoded = 0;
+  while (truncated.next(record)) {
+    decoded++;
+  }
+  assert(decoded == 5 && !truncated.error().empty());
+
+  // through an async_sink: batches are transcoded and printf calls still arrive unformatted
+  std::remove(path.c_str());
+  {
+    auto async = std::make_shared<async_sink>(std::make_shared<binary_sink>(path));
+    auto log = logger("queued", std::make_shared<binary_formatter>(), async);
+    log.info("entry", field("n", 1));
+    log.info_f("call %d", 2);
+    log.info("after", field("n", 3));
+  }
+  std::string queued_data = read_file(path);
+  binary_reader queued(queued_data);
+  records.clear();
+  while (queued.next(record)) {
+    records.push_back(std::move(record));
+    record = binary_record{};
+  }
+  assert(queued.error().empty());
+  assert(records.size() == 3);
+  assert(records[0].message == "entry" && records[0].source == "queued");
+  assert(records[1].format == "call %d" && records[1].message == "call 2");
+  assert(records[2].message == "after" && records[2].fields.size() == 1);
+
+  std::remove(path.c_str());
+}
+
+void test_lazy_fields_and_macros() {
+  using namespace redlog;
+
+  auto sink_ptr = std::make_shared<string_sink>();
+  auto log = logger("lazy", std::make_shared<default_formatter>(themes::plain), sink_ptr);
+  level previous = get_level();
+  set_level(level::info);
+
+  int calls = 0;
+  const auto dump = [&calls] {
+    calls++;
+    return std::string("expensive");
+  };
+
+  // lazy values run only for records that pass the level check
+  log.debug("filtered", field::lazy("state", dump));
+  assert(calls == 0);
+  assert(sink_ptr->get_output().empty());
+
+  log.info("kept", field("plain", 1), field::lazy("state", dump));
+  assert(calls == 1);
+  assert(sink_ptr->get_output().find("plain=1 state=expensive") != std::string::npos);
+
+  // any stringifiable result works
+  log.info("number", field::lazy("answer", [] { return 42; }));
+  assert(sink_ptr->get_output().find("answer=42") != std::string::npos);
+
+  // macros skip argument evaluation entirely
+  int evaluated = 0;
+  const auto expensive = [&evaluated] { return ++evaluated; };
+  REDLOG_DEBUG(log, "skipped", field("value", expensive()));
+  REDLOG_DEBUG_F(log, "skipped %d", expensive());
+  assert(evaluated == 0);
+
+  REDLOG_INFO(log, "macro", field("value", expensive()));
+  REDLOG_WARN_F(log, "macro %d", expensive());
+  assert(evaluated == 2);
+  assert(sink_ptr->get_output().find("macro 2") != std::string::npos);
+
+  assert(log.enabled(level::info) && !log.enabled(level::debug));
+  set_level(previous);
+}
+
+void test_hierarchical_levels() {
+  using namespace redlog;
+
+  level previous = get_level();
+  set_level(level::info);
+
+  auto sink_ptr = std::make_shared<string_sink>();
+  auto app = logger("app", std::make_shared<default_formatter>(themes::plain), sink_ptr);
+  auto db = app.with_name("db");
+  auto pool = db.with_name("pool").with_field("size", 4);
+  auto http = app.with_name("http");
+  auto apple = logger("apple", std::make_shared<default_formatter>(themes::plain), sink_ptr);
+
+  // warm the per-logger caches before changing anything
+  assert(!db.enabled(level::debug) && !pool.enabled(level::debug));
+
+  set_level("app.db", level::debug);
+  assert(db.enabled(level::debug));
+  assert(pool.enabled(level::debug));
+  assert(!app.enabled(level::debug));
+  assert(!http.enabled(level::debug));
+  assert(!apple.enabled(level::debug));
+  assert(get_level("app.db.pool.conn") == level::debug);
+  assert(get_level("app.dbx") == level::info);
+
+  pool.debug("visible");
+  http.debug("hidden");
+  assert(sink_ptr->get_output().find("visible") != std::string::npos);
+  assert(sink_ptr->get_output().find("hidden") == std::string::npos);
+
+  // the closest override wins, in either direction
+  set_level("app", level::error);
+  set_level("app.db.pool", level::warn);
+  assert(!http.enabled(level::warn) && http.enabled(level::error));
+  assert(pool.enabled(level::warn) && !pool.enabled(level::info));
+  assert(db.enabled(level::debug));
+
+  // clearing falls back to the parent, then the global level
+  clear_level("app.db.pool");
+  assert(pool.enabled(level::debug));
+  clear_level("app.db");
+  clear_level("app");
+  assert(!pool.enabled(level::debug) && pool.enabled(level::info));
+
+  // global changes still reach cached loggers
+  set_level(level::trace);
+  assert(pool.enabled(level::trace) && app.enabled(level::trace));
+
+  set_level(previous);
+}
+
+void test_runtime_config_updates() {
+  using namespace redlog;
+
+  settings previous = get_settings();
+
+  // a formatter without an explicit theme follows the global one, even after construction
+  configure([](settings& s) {
+    s.min_level = level::info;
+    s.active_theme = themes::plain;
+  });
+  auto sink_ptr = std::make_shared<string_sink>();
+  auto log = logger("cfg", std::make_shared<default_formatter>(), sink_ptr);
+  log.info("before");
+  assert(sink_ptr->get_output().find("[cfg]" + std::string(7, ' ') + "[inf]") == 0);
+
+  theme wide = themes::plain;
+  wide.source_width = 20;
+  set_theme(wide);
+  sink_ptr->clear();
+  log.info("after");
+  assert(sink_ptr->get_output().find("[cfg]" + std::string(15, ' ') + "[inf]") == 0);
+  assert(get_theme().source_width == 20);
+
+  // one edit changes several settings at once
+  configure([](settings& s) {
+    s.min_level = level::warn;
+    s.level_overrides["cfg.db"] = level::debug;
+  });
+  assert(!log.enabled(level::info));
+  assert(log.with_name("db").enabled(level::debug));
+  assert(get_settings().level_overrides.size() == previous.level_overrides.size() + 1);
+
+  // level-only changes and no-op edits publish no new snapshot
+  const detail::config_snapshot* published = &detail::current_config();
+  set_level(level::debug);
+  configure([](settings& s) { s.min_level = level::trace; });
+  configure([](settings&) {});
+  assert(&detail::current_config() == published);
+  assert(get_level() == level::trace && get_settings().min_level == level::trace);
+  assert(log.enabled(level::trace));
+  set_level(level::warn);
+  assert(!log.enabled(level::info));
+
+  // loggers keep running while another thread swaps level and theme
+  struct counting_sink : sink {
+    std::atomic<int> records{0};
+    std::atomic<int> malformed{0};
+    void write(std::string_view formatted) override {
+      if (formatted.find("[cfg]") != 0 || formatted.find("tick") == std::string_view::npos) {
+        malformed.fetch_add(1);
+      }
+      records.fetch_add(1);
+    }
+    void flush() override {}
+  };
+  auto counter = std::make_shared<counting_sink>();
+  auto shared_log = logger("cfg", std::make_shared<default_formatter>(), counter);
+
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 4; ++t) {
+    writers.emplace_back([&] {
+      for (int i = 0; !stop.load() || i < 1000; ++i) {
+        shared_log.error("tick", field("i", i));
+      }
+    });
+  }
+  for (int i = 0; i < 200; ++i) {
+    configure([i](settings& s) {
+      s.min_level = i % 2 ? level::debug : level::warn;
+      s.active_theme = i % 2 ? themes::default_theme : themes::plain;
+    });
+  }
+  stop.store(true);
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  assert(counter->records.load() >= 4000);
+  assert(counter->malformed.load() == 0);
+
+  configure([&previous](settings& s) { s = previous; });
+  assert(get_level() == previous.min_level);
+}
+
+void test_dist_sink() {
+  using namespace redlog;
+
+  level previous = get_level();
+  set_level(level::debug);
+
+  // counts how often a record is rendered
+  struct counting_formatter : default_formatter {
+    mutable std::atomic<int> calls{0};
+    counting_formatter() : default_formatter(themes::plain) {}
+    void format_to(detail::fmt_buffer& out, const log_entry& entry) const override {
+      calls.fetch_add(1);
+      default_formatter::format_to(out, entry);
+    }
+  };
+
+  auto shared_fmt = std::make_shared<counting_formatter>();
+  auto logger_fmt = std::make_shared<counting_formatter>();
+  auto everything = std::make_shared<string_sink>();
+  auto errors = std::make_shared<string_sink>();
+  auto mirror = std::make_shared<string_sink>();
+  auto queued = std::make_shared<string_sink>();
+
+  auto dist = std::make_shared<dist_sink>();
+  dist->add_sink(everything, level::annoying, shared_fmt);
+  dist->add_sink(errors, level::error);
+  dist->add_sink(mirror, level::annoying, shared_fmt);
+  dist->add_queued_sink(queued, level::warn);
+  assert(dist->size() == 4);
+
+  auto log = logger("dist", logger_fmt, dist);
+  log.info("routine");
+  log.error("broken", field("code", 7));
+  dist->flush();
+
+  // one rendering per distinct formatter and record, however many sinks share it
+  assert(shared_fmt->calls.load() == 2);
+  assert(logger_fmt->calls.load() == 1);
+
+  assert(everything->get_output().find("routine") != std::string::npos);
+  assert(everything->get_output().find("broken") != std::string::npos);
+  assert(mirror->get_output() == everything->get_output());
+  assert(errors->get_output().find("routine") == std::string::npos);
+  assert(errors->get_output().find("code=7") != std::string::npos);
+  assert(queued->get_output() == errors->get_output());
+
+  // printf records and preformatted writes take the same routes
+  log.debug_f("value %d", 42);
+  dist->write_record(level::critical, "direct");
+  dist->flush();
+  assert(everything->get_output().find("value 42") != std::string::npos);
+  assert(errors->get_output().find("value 42") == std::string::npos);
+  assert(errors->get_output().find("direct") != std::string::npos);
+
+  // removing a route leaves the others untouched
+  dist->remove_sink(errors);
+  assert(dist->size() == 3);
+  errors->clear();
+  log.critical("after removal");
+  dist->flush();
+  assert(errors->get_output().empty());
+  assert(queued->get_output().find("after removal") != std::string::npos);
+
+  // a removed sink is released, and so is the queue and worker of a queued route
+  std::weak_ptr<string_sink> released = queued;
+  dist->remove_sink(queued);
+  queued.reset();
+  assert(released.expired());
+  assert(dist->size() == 2);
+
+  set_level(previous);
+}
+
+void test_batched_writes() {
+  using namespace redlog;
+
+  // the default write_batch falls back to one write() per record
+  auto plain = std::make_shared<string_sink>();
+  std::string_view records[] = {"alpha", "beta", "gamma"};
+  level levels[] = {level::info, level::error, level::debug};
+  plain->write_batch(records, levels);
+  assert(plain->get_output() == "alpha\nbeta\ngamma\n");
+
+  // file_sink coalesces the batch into one write
+  const std::string path = "redlog_test_batch.log";
+  std::remove(path.c_str());
+  {
+    file_sink file(path);
+    file.write_batch(records, levels);
+    file.flush();
+    assert(read_file(path) == "alpha\nbeta\ngamma\n");
+  }
+  std::remove(path.c_str());
+
+  // buffered_file_sink still honours flush_level inside a batch
+  {
+    flush_policy policy;
+    policy.interval = std::chrono::milliseconds(0);
+    buffered_file_sink buffered(path, policy);
+    std::string_view quiet[] = {"one", "two"};
+    level infos[] = {level::info, level::info};
+    buffered.write_batch(quiet, infos);
+    assert(buffered.write_calls() == 0);
+    buffered.write_batch(records, levels);
+    assert(buffered.write_calls() == 1);
+    assert(read_file(path) == "one\ntwo\nalpha\nbeta\n");
+  }
+  std::remove(path.c_str());
+
+  // the async worker drains its queue in batches and keeps levels
+  struct batch_sink : sink {
+    std::mutex mutex;
+    std::size_t batches = 0;
+    std::size_t records = 0;
+    std::size_t errors = 0;
+    void write(std::string_view) override { assert(false); }
+    void write_batch(std::span<const std::string_view> batch, std::span<const level> batch_levels) override {
+      std::lock_guard<std::mutex> lock(mutex);
+      assert(batch.size() == batch_levels.size());
+      batches++;
+      records += batch.size();
+      for (std::size_t i = 0; i < batch.size(); ++i) {
+        assert(batch[i].find(batch_levels[i] == level::error ? "[err]" : "[inf]") != std::string_view::npos);
+        errors += batch_levels[i] == level::error ? 1 : 0;
+      }
+    }
+    void flush() override {}
+  };
+  auto inner = std::make_shared<batch_sink>();
+  {
+    auto async = std::make_shared<async_sink>(inner, 1024);
+    auto log = logger("batch", std::make_shared<default_formatter>(themes::plain), async);
+    for (int i = 0; i < 500; ++i) {
+      if (i % 10 == 0) {
+        log.error("disk", field("i", i));
+      } else {
+        log.info_f("tick %d", i);
+      }
+    }
+    async->flush();
+  }
+  assert(inner->records == 500);
+  assert(inner->errors == 50);
+  assert(inner->batches < inner->records);
+}
+
+void test_timestamps_and_clocks() {
+  using namespace redlog;
+
+  // 2024-01-02 03:04:05.123456789 utc
+  auto at = [](std::int64_t nanoseconds) { return detail::from_nanoseconds(nanoseconds); };
+  const std::int64_t base = 1704164645LL * 1000000000 + 123456789;
+
+  auto render = [](std::chrono::system_clock::time_point time, const timestamp_format& fmt) {
+    detail::fmt_buffer out;
+    detail::append_timestamp(out, time, fmt);
+    return out.str();
+  };
+
+  timestamp_format utc;
+  utc.utc = true;
+  assert(render(at(base), utc) == "2024-01-02 03:04:05.123");
+
+  // the cached prefix is reused within the second and refreshed for the next one
+  timestamp_format micros = utc;
+  micros.fraction_digits = 6;
+  assert(render(at(base + 1000), micros) == "2024-01-02 03:04:05.123457");
+  assert(render(at(base + 900000000), micros) == "2024-01-02 03:04:06.023456");
+  assert(render(at(base), utc) == "2024-01-02 03:04:05.123");
+
+  timestamp_format clock_only{.pattern = "%H:%M:%S", .fraction_digits = 9, .utc = true};
+  assert(render(at(base), clock_only) == "03:04:05.123456789");
+  timestamp_format seconds_only{.pattern = "%H:%M:%S", .fraction_digits = 0, .utc = true};
+  assert(render(at(base), seconds_only) == "03:04:05");
+  assert(render(at(-1), seconds_only) == "23:59:59");
+
+  // default_formatter can lead with the timestamp
+  auto sink_ptr = std::make_shared<string_sink>();
+  auto log = logger("time", std::make_shared<default_formatter>(themes::plain, utc), sink_ptr);
+  log.info("stamped");
+  std::string line = sink_ptr->get_output();
+  assert(line.size() > 24 && line[4] == '-' && line[10] == ' ' && line[19] == '.' && line[23] == ' ');
+  assert(line.find("[time]") == 24);
+
+  // clock sources
+  struct time_sink : sink {
+    std::chrono::system_clock::time_point last;
+    void write(std::string_view) override {}
+    void write_entry(const log_entry& entry, const formatter&) override { last = entry.timestamp; }
+    void flush() override {}
+  };
+  auto clock_sink = std::make_shared<time_sink>();
+  auto clocked = logger("clock", clock_sink);
+  settings previous = get_settings();
+  auto near_now = [&] {
+    auto delta = clock_sink->last - std::chrono::system_clock::now();
+    return delta < std::chrono::milliseconds(100) && delta > -std::chrono::milliseconds(100);
+  };
+
+  configure([](settings& s) { s.clock = clock_source::none; });
+  clocked.info("untimed");
+  assert(clock_sink->last == std::chrono::system_clock::time_point{});
+
+  configure([](settings& s) { s.clock = clock_source::coarse; });
+  clocked.info("coarse");
+  assert(near_now());
+
+  configure([](settings& s) { s.clock = clock_source::tsc; });
+  for (int i = 0; i < 3; ++i) {
+    clocked.info("tsc");
+    assert(near_now());
+    std::this_thread::sleep_for(std::chrono::milliseconds(15));
+  }
+
+  configure([&previous](settings& s) { s = previous; });
+}
+
+void test_interning() {
+  using namespace redlog;
+
+  // literal keys share one stored copy; copies of a field share its key
+  field literal("attempt", 1);
+  field again("attempt", 2);
+  assert(literal.key == "attempt");
+  assert(literal.key.data() == again.key.data());
+  field copy = literal;
+  assert(copy.key.data() == literal.key.data());
+
+  // keys built at run time are kept by the field and never reach the shared table
+  std::size_t interned = detail::intern_table::instance().size();
+  field dynamic(std::string("att") + "empt", 2);
+  assert(dynamic.key == "attempt");
+  field dynamic_copy = dynamic;
+  assert(dynamic_copy.key.data() == dynamic.key.data());
+  for (int i = 0; i < 100; ++i) {
+    field repeated("attempt", i);
+    field generated("key_" + std::to_string(i), i);
+    assert(generated.key == "key_" + std::to_string(i));
+  }
+  assert(detail::intern_table::instance().size() == interned);
+
+  // keys outlive the buffer they came from, and a reused buffer is not mistaken for the old key
+  char buffer[16];
+  std::snprintf(buffer, sizeof(buffer), "slot_%d", 1);
+  field first(buffer, "a");
+  std::snprintf(buffer, sizeof(buffer), "slot_%d", 2);
+  field second(buffer, "b");
+  std::snprintf(buffer, sizeof(buffer), "overwrite");
+  assert(first.key == "slot_1");
+  assert(second.key == "slot_2");
+  assert(detail::intern_table::instance().size() == interned);
+
+  // intern_key() opts a run-time key into the table
+  std::string configured = "region";
+  field opted(intern_key(configured), "eu");
+  assert(opted.key.data() == field("region", "us").key.data());
+
+  // logger names are interned too: the entry source points into the shared table
+  struct source_sink : sink {
+    std::vector<const char*> sources;
+    void write(std::string_view) override {}
+    void write_entry(const log_entry& entry, const formatter&) override { sources.push_back(entry.source.data()); }
+    void flush() override {}
+  };
+  auto sink_ptr = std::make_shared<source_sink>();
+  auto derived = logger("svc", sink_ptr).with_name("db");
+  auto direct = logger("svc.db", sink_ptr);
+  auto fielded = derived.with_field("shard", 3);
+  derived.info("a");
+  direct.info("b");
+  fielded.info("c");
+  assert(sink_ptr->sources.size() == 3);
+  assert(sink_ptr->sources[0] == sink_ptr->sources[1]);
+  assert(sink_ptr->sources[0] == sink_ptr->sources[2]);
+  assert(detail::intern("svc.db").data() == sink_ptr->sources[0]);
+}
+
+void test_typed_field_values() {
+  using namespace redlog;
+  using kind = field_value::kind;
+
+  // numbers stay numbers and render as before
+  field count("bytes", std::uint64_t(1) << 40);
+  field delta("delta", -7);
+  field ratio("ratio", 0.25);
+  field flag("ok", true);
+  field letter("grade", 'A');
+  field name("name", "alice");
+  assert(count.value.type() == kind::uint64 && count.value.as_uint64() == (std::uint64_t(1) << 40));
+  assert(delta.value.type() == kind::int64 && delta.value.as_int64() == -7);
+  assert(ratio.value.type() == kind::float64 && ratio.value.as_double() == 0.25);
+  assert(flag.value.type() == kind::boolean && flag.value.as_bool());
+  assert(name.value.type() == kind::string && name.value.text() == "alice");
+  assert(count.value == "1099511627776");
+  assert(delta.value == "-7");
+  assert(ratio.value == "0.250000");
+  assert(flag.value == "1");
+  assert(letter.value == "65");
+
+  // opted-in types are kept inline and rendered on demand
+  field where("at", test_point{3, 4});
+  assert(where.value.type() == kind::custom);
+  assert(where.value == "3,4");
+
+  // other types are rendered when the field is built, so what they point at may change or go away
+  char label_text[] = "first";
+  field label("label", test_label{label_text});
+  label_text[0] = 'F';
+  assert(label.value.type() == kind::string && label.value == "first");
+  field object("object", test_object{5, "five"});
+  assert(object.value.type() == kind::string && object.value == "TestObject{5, five}");
+
+  // ref views its text without copying
+  std::string owner = "borrowed";
+  field_value viewed = field_value::ref(owner);
+  assert(viewed.type() == kind::view && viewed.text().data() == owner.data());
+
+  // numeric fields are built and formatted without touching the heap
+  detail::fmt_buffer out;
+  field warm("n", 0); // interns the key
+  alloc_tracking::count = 0;
+  alloc_tracking::enabled = true;
+  field number("n", 123456789012345LL);
+  number.value.format_to(out);
+  alloc_tracking::enabled = false;
+  assert(alloc_tracking::count == 0);
+  assert(out.view() == "123456789012345");
+
+  // binary logs keep the types
+  const std::string path = "redlog_test_typed.rlog";
+  std::remove(path.c_str());
+  {
+    auto sink_ptr = std::make_shared<binary_sink>(path);
+    auto log = logger("typed", std::make_shared<binary_formatter>(), sink_ptr);
+    log.info("typed", count, delta, ratio, flag, name, where);
+  }
+  std::string data = read_file(path);
+  binary_reader reader(data);
+  binary_record record;
+  bool decoded = reader.next(record);
+  assert(decoded);
+  (void) decoded;
+  auto fields = record.fields.fields();
+  assert(fields.size() == 6);
+  assert(fields[0].value.type() == kind::uint64 && fields[0].value == "1099511627776");
+  assert(fields[1].value.type() == kind::int64 && fields[1].value.as_int64() == -7);
+  assert(fields[2].value.type() == kind::float64 && fields[2].value.as_double() == 0.25);
+  assert(fields[3].value.type() == kind::boolean && fields[3].value.as_bool());
+  assert(fields[4].value.type() == kind::string && fields[4].value == "alice");
+  assert(fields[5].value.type() == kind::string && fields[5].value == "3,4");
+  std::remove(path.c_str());
+}
+
+void test_rate_limiting() {
+  using namespace redlog;
+
+  auto sink_ptr = std::make_shared<string_sink>();
+  auto log = logger("hot", std::make_shared<default_formatter>(themes::plain), sink_ptr);
+  auto count = [](const std::string& text, std::string_view needle) {
+    size_t n = 0;
+    for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) {
+      ++n;
+    }
+    return n;
+  };
+
+  // every n-th call, with the suppressed count reported before the next admitted record
+  for (int i = 0; i < 10; ++i) {
+    REDLOG_EVERY_N(log, 3).warn("retrying", field("attempt", i));
+  }
+  std::string out = sink_ptr->get_output();
+  assert(count(out, "retrying") == 4);
+  assert(out.find("attempt=0") != std::string::npos && out.find("attempt=9") != std::string::npos);
+  assert(count(out, "suppressed 2 messages") == 1);
+  assert(out.find("suppressed 2 messages") < out.find("attempt=3"));
+
+  // disabled levels never reach the site
+  sink_ptr->clear();
+  for (int i = 0; i < 10; ++i) {
+    auto limited = REDLOG_EVERY_N(log, 2);
+    limited.pedantic("quiet");
+    assert(limited.suppressed() == 0);
+  }
+  assert(sink_ptr->get_output().empty());
+
+  // time based limits; the bucket allows a burst, then nothing until it refills
+  sink_ptr->clear();
+  for (int i = 0; i < 5; ++i) {
+    REDLOG_EVERY_MS(log, 60000).info_f("queue full (%d)", i);
+    REDLOG_RATE_LIMIT(log, 0.001, 3).err("burst");
+  }
+  out = sink_ptr->get_output();
+  assert(count(out, "queue full") == 1 && out.find("queue full (0)") != std::string::npos);
+  assert(count(out, "burst") == 3);
+
+  // sampling
+  sink_ptr->clear();
+  for (int i = 0; i < 100; ++i) {
+    REDLOG_SAMPLE(log, 0.0).info("never");
+    REDLOG_SAMPLE(log, 1.0).info("always");
+  }
+  out = sink_ptr->get_output();
+  assert(count(out, "never") == 0 && count(out, "always") == 100);
+
+  // admission stays exact under contention
+  class counting_sink : public sink {
+  public:
+    std::atomic<int> admitted{0};
+    std::atomic<int> summaries{0};
+    void write(std::string_view formatted) override {
+      (formatted.find("suppressed") != std::string_view::npos ? summaries : admitted).fetch_add(1);
+    }
+    void flush() override {}
+  };
+  auto counter = std::make_shared<counting_sink>();
+  auto shared = logger("hot", counter);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&shared] {
+      for (int i = 0; i < 1000; ++i) {
+        REDLOG_EVERY_N(shared, 100).warn("contended");
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  assert(counter->admitted.load() == 40);
+  assert(counter->summaries.load() <= 1);
+}
+
+void test_structured_formatters() {
+  using namespace redlog;
+
+  auto entry_fields = field_set{};
+  entry_fields.add(field("user", "alice \"a\""));
+  entry_fields.add(field("id", 7));
+  entry_fields.add(field("ratio", 0.5));
+  entry_fields.add(field("ok", true));
+  entry_fields.add(field("where", test_point{3, 4}));
+  log_entry entry(level::warn, "line one\nline\ttwo", "app.db", std::move(entry_fields));
+
+  json_formatter json(std::nullopt);
+  assert(json.format(entry) == "{\"level\":\"warn\",\"source\":\"app.db\",\"message\":\"line one\\nline\\ttwo\","
+                               "\"user\":\"alice \\\"a\\\"\",\"id\":7,\"ratio\":0.500000,"
+                               "\"ok\":true,\"where\":\"3,4\"}");
+
+  logfmt_formatter logfmt(std::nullopt);
+  assert(logfmt.format(entry) ==
+         "level=warn source=app.db msg=\"line one\\nline\\ttwo\" user=\"alice \\\"a\\\"\" id=7 ratio=0.500000 ok=true "
+         "where=3,4");
+
+  // default timestamps are rfc 3339 utc
+  log_entry dated(level::info, "hi", "", field_set{});
+  dated.timestamp = std::chrono::system_clock::time_point(std::chrono::milliseconds(86400123));
+  assert(json_formatter().format(dated) ==
+         "{\"time\":\"1970-01-02T00:00:00.123Z\",\"level\":\"info\",\"message\":\"hi\"}");
+  assert(logfmt_formatter().format(dated) == "time=1970-01-02T00:00:00.123Z level=info msg=hi");
+  assert(logfmt.format(log_entry(level::info, "", "", field_set{})) == "level=info msg=\"\"");
+
+  // keys that logfmt cannot represent have the offending characters replaced
+  field_set odd_keys;
+  odd_keys.add(field("user name", "a"));
+  odd_keys.add(field("a=b", 1));
+  odd_keys.add(field("say \"hi\"", true));
+  assert(logfmt.format(log_entry(level::info, "m", "", std::move(odd_keys))) ==
+         "level=info msg=m user_name=a a_b=1 say__hi_=true");
+
+  // the vector scan agrees with a byte-by-byte scan at every position and block boundary
+  for (std::size_t length : {1, 15, 16, 17, 31, 32, 33, 70}) {
+    for (std::size_t at = 0; at < length; ++at) {
+      for (char special : {'"', '\\', '\n', '\x01', '\x1f', ' ', '='}) {
+        std::string text(length, 'x');
+        text[at] = special;
+        const bool logfmt_only = special == ' ' || special == '=';
+        assert(detail::clean_prefix<true>(text.data(), text.size()) == at);
+        assert(detail::clean_prefix<false>(text.data(), text.size()) == (logfmt_only ? length : at));
+      }
+    }
+    std::string high(length, '\xe9'); // bytes above 0x7f are not control characters
+    assert(detail::clean_prefix<false>(high.data(), high.size()) == length);
+  }
+
+  std::string escaped;
+  detail::append_json_escaped(escaped, std::string_view("a\x01z\x7f\xc3\xa9", 6));
+  assert(escaped == "a\\u0001z\x7f\xc3\xa9");
+
+  // through a logger
+  auto sink_ptr = std::make_shared<string_sink>();
+  auto log = logger("svc", std::make_shared<json_formatter>(std::nullopt), sink_ptr);
+  log.with_field("request", 12).info_f("took %d ms", 5);
+  assert(sink_ptr->get_output() ==
+         "{\"level\":\"info\",\"source\":\"svc\",\"message\":\"took 5 ms\",\"request\":12}\n");
+}
+
+void test_source_locations() {
+  using namespace redlog;
+
+  static_assert(detail::source_path("/home/build/src/db/pool.cpp") == "pool.cpp");
+  static_assert(detail::source_path("C:\\src\\main.cpp") == "main.cpp");
+  static_assert(detail::source_path("plain.cpp") == "plain.cpp");
+  static_assert(levels_up_to(level::error) == (level_mask(level::critical) | level_mask(level::error)));
+
+  auto sink_ptr = std::make_shared<string_sink>();
+  auto log = logger("site", std::make_shared<default_formatter>(themes::plain), sink_ptr);
+
+  // off by default
+  REDLOG_ERROR(log, "no site");
+  assert(sink_ptr->get_output().find("test_main.cpp") == std::string::npos);
+
+  // per level
+  configure([](settings& s) { s.source_levels = levels_up_to(level::error); });
+  sink_ptr->clear();
+  const int line = __LINE__ + 1;
+  REDLOG_ERROR(log, "failed", field("code", 3));
+  REDLOG_INFO(log, "fine");
+  std::string expected = " [test_main.cpp:" + std::to_string(line) + " test_source_locations]";
+  std::string out = sink_ptr->get_output();
+  assert(out.find("code=3" + expected + "\n") != std::string::npos);
+  assert(out.find("fine") != std::string::npos && out.find("test_main.cpp", out.find("fine")) == std::string::npos);
+
+  // structured formatters
+  auto json_sink = std::make_shared<string_sink>();
+  auto json_log = logger("site", std::make_shared<json_formatter>(std::nullopt), json_sink);
+  REDLOG_CRITICAL_F(json_log, "code %d", 9);
+  out = json_sink->get_output();
+  assert(out.find("\"message\":\"code 9\",\"file\":\"test_main.cpp\",\"line\":") != std::string::npos);
+  assert(out.find("\"function\":\"test_source_locations\"}") != std::string::npos);
+
+  // deferred records keep their site until the worker formats them
+  auto queued_sink = std::make_shared<string_sink>();
+  {
+    auto async = std::make_shared<async_sink>(queued_sink);
+    auto queued = logger("site", std::make_shared<default_formatter>(themes::plain), async);
+    REDLOG_ERROR_F(queued, "queued %d", 1);
+    async->flush();
+  }
+  out = queued_sink->get_output();
+  assert(out.find("queued 1") != std::string::npos);
+  assert(out.find("[test_main.cpp:", out.find("queued 1")) != std::string::npos);
+
+  // explicit sites
+  static constexpr source_site handler{"handler.cpp", 7, "handle"};
+  sink_ptr->clear();
+  log.at(handler).err("via at");
+  out = sink_ptr->get_output();
+  assert(out.find("via at") != std::string::npos && out.find("  [handler.cpp:7 handle]\n") != std::string::npos);
+
+  configure([](settings& s) { s.source_levels = 0; });
+}
+
+void test_flight_recorder() {
+  using namespace redlog;
+
+  set_level(level::info);
+  enable_backtrace(4, level::debug, level::error);
+
+  auto sink_ptr = std::make_shared<string_sink>();
+  auto log = logger("fr", std::make_shared<default_formatter>(themes::plain), sink_ptr);
+  for (int i = 0; i < 6; ++i) {
+    log.debug("step", field("i", i));
+  }
+  log.pedantic("too detailed"); // below the capture level
+  assert(sink_ptr->get_output().empty());
+
+  // macros evaluate their arguments while the recorder keeps the level
+  bool evaluated = false;
+  REDLOG_TRACE_F(log, "traced %d", (evaluated = true, 7));
+  assert(evaluated);
+
+  // warnings are written normally; an error dumps the ring first
+  log.warn("warned");
+  assert(sink_ptr->get_output().find("backtrace") == std::string::npos);
+  log.error("failed");
+  std::string out = sink_ptr->get_output();
+  auto at = [&](std::string_view text) { return out.find(text); };
+  assert(at("backtrace: 4 earlier records") != std::string::npos);
+  assert(at("step") != std::string::npos && at("i=2") == std::string::npos);
+  assert(at("i=3") < at("i=4") && at("i=4") < at("i=5") && at("i=5") < at("traced 7"));
+  assert(at("traced 7") < at("failed"));
+  assert(at("too detailed") == std::string::npos);
+  assert(out.find("[fr]") != std::string::npos && out.find("[dbg]") != std::string::npos);
+
+  // records are dumped once
+  sink_ptr->clear();
+  log.error("again");
+  assert(sink_ptr->get_output().find("backtrace") == std::string::npos);
+
+  // long records are truncated to a slot; manual dumps
+  sink_ptr->clear();
+  log.debug(std::string(1000, 'x'));
+  log.dump_backtrace();
+  out = sink_ptr->get_output();
+  assert(out.find(std::string(detail::backtrace_ring::slot_text, 'x')) != std::string::npos);
+  assert(out.find(std::string(detail::backtrace_ring::slot_text + 1, 'x')) == std::string::npos);
+
+  // concurrent writers keep the newest records
+  enable_backtrace(64);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&log] {
+      for (int i = 0; i < 1000; ++i) {
+        log.debug("busy", field("i", i));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  sink_ptr->clear();
+  log.critical("after");
+  assert(sink_ptr->get_output().find("backtrace: 64 earlier records") != std::string::npos);
+
+#ifndef _WIN32
+  // the crash handler writes the ring before the process dies
+  int pipe_fds[2];
+  int piped = pipe(pipe_fds);
+  assert(piped == 0);
+  (void) piped;
+  pid_t child = fork();
+  if (child == 0) {
+    close(pipe_fds[0]);
+    auto crash_log = logger("crash", std::make_shared<string_sink>());
+    crash_log.debug("before the crash", field("state", "bad"));
+    install_crash_handler(pipe_fds[1]);
+    std::abort();
+  }
+  close(pipe_fds[1]);
+  std::string crash_output;
+  char chunk[512];
+  for (ssize_t n; (n = read(pipe_fds[0], chunk, sizeof(chunk))) > 0;) {
+    crash_output.append(chunk, static_cast<size_t>(n));
+  }
+  close(pipe_fds[0]);
+  int status = 0;
+  waitpid(child, &status, 0);
+  assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+  assert(crash_output.find("[crash] [dbg] before the crash state=bad\n") != std::string::npos);
+#endif
+
+  disable_backtrace();
+  sink_ptr->clear();
+  log.debug("not kept");
+  log.critical("no dump");
+  assert(sink_ptr->get_output().find("backtrace") == std::string::npos);
+}
+
+void test_statistics() {
+  using namespace redlog;
+
+  set_level(level::info);
+  const statistics before = stats();
+  auto sink_ptr = std::make_shared<string_sink>();
+  auto log = logger("stats", std::make_shared<default_formatter>(themes::plain), sink_ptr);
+  log.info("one");
+  log.info_f("two %d", 2);
+  log.error("three");
+  log.debug("filtered");
+  log.debug_f("filtered %d", 1);
+
+  // threads that have exited still count
+  std::thread([&log] {
+    for (int i = 0; i < 10; ++i) {
+      log.warn("from a thread");
+    }
+  }).join();
+
+  statistics after = stats();
+  auto delta = [&](const std::array<std::uint64_t, 9>& a, const std::array<std::uint64_t, 9>& b, level l) {
+    return a[static_cast<int>(l)] - b[static_cast<int>(l)];
+  };
+  assert(delta(after.emitted, before.emitted, level::info) == 2);
+  assert(delta(after.emitted, before.emitted, level::error) == 1);
+  assert(delta(after.emitted, before.emitted, level::warn) == 10);
+  assert(delta(after.filtered, before.filtered, level::debug) == 2);
+  assert(after.format_time.count == before.format_time.count); // latency is opt-in
+
+  // latency histograms
+  configure([](settings& st) { st.measure_latency = true; });
+  for (int i = 0; i < 5; ++i) {
+    log.info("timed");
+  }
+  configure([](settings& st) { st.measure_latency = false; });
+  statistics timed = stats();
+  assert(timed.format_time.count - after.format_time.count == 5);
+  assert(timed.write_time.count - after.write_time.count == 5);
+  std::uint64_t bucketed = 0;
+  for (std::uint64_t n : timed.write_time.counts) {
+    bucketed += n;
+  }
+  assert(bucketed == timed.write_time.count);
+
+  // bytes, writes and flushes per sink name
+  const std::string path = "redlog_test_stats.log";
+  std::remove(path.c_str());
+  auto find_sink = [](const statistics& st, std::string_view name) {
+    for (const auto& entry : st.sinks) {
+      if (entry.name == name) {
+        return entry;
+      }
+    }
+    return sink_statistics{};
+  };
+  {
+    auto named = std::make_shared<buffered_file_sink>(path, flush_policy{}, "audit");
+    logger audit("audit", std::make_shared<default_formatter>(themes::plain), named);
+    audit.info("abc");
+    named->flush();
+  }
+  sink_statistics audit_stats = find_sink(stats(), "audit");
+  assert(audit_stats.bytes == read_file(path).size());
+  assert(audit_stats.writes == 1 && audit_stats.flushes >= 1);
+  std::remove(path.c_str());
+
+  // live sinks of one kind get meters of their own; a released meter goes to the next sink of its kind
+  {
+    auto first = std::make_shared<buffered_file_sink>(path, flush_policy{}, "twin");
+    auto second = std::make_shared<buffered_file_sink>(path, flush_policy{}, "twin");
+    first->write("a");
+    second->write("bcd");
+    first->flush();
+    second->flush();
+    statistics twins = stats();
+    assert(find_sink(twins, "twin").bytes == 2);
+    assert(find_sink(twins, "twin.2").bytes == 4);
+  }
+  {
+    buffered_file_sink reused(path, flush_policy{}, "twin");
+    reused.write("e");
+    reused.flush();
+    assert(find_sink(stats(), "twin").bytes == 4);
+    assert(find_sink(stats(), "twin.3").name.empty());
+  }
+  std::remove(path.c_str());
+
+  // async queues: depth, high-water mark and drops per level
+  class gated_sink : public sink {
+  public:
+    std::atomic<bool> open{false};
+    void write(std::string_view) override {
+      while (!open.load()) {
+        std::this_thread::yield();
+      }
+    }
+    void flush() override {}
+  };
+  auto gate = std::make_shared<gated_sink>();
+  {
+    auto queued = std::make_shared<async_sink>(gate, 4, overflow_policy::drop_newest, "burst");
+    logger producer("queued", queued);
+    for (int i = 0; i < 20; ++i) {
+      producer.warn("burst");
+    }
+    statistics busy = stats();
+    bool found = false;
+    for (const auto& queue : busy.queues) {
+      if (queue.capacity == 4) {
+        found = true;
+        assert(queue.name == "burst");
+        assert(queue.high_water >= 1 && queue.high_water <= 4 && queue.depth <= 4);
+      }
+    }
+    assert(found);
+    assert(delta(busy.dropped, timed.dropped, level::warn) == queued->dropped());
+    assert(queued->dropped() > 0);
+    gate->open = true;
+  }
+  for (const auto& queue : stats().queues) {
+    assert(queue.capacity != 4); // unregistered with its sink
+  }
+
+  std::string text = stats().prometheus();
+  assert(text.find("# TYPE redlog_records_emitted_total counter\n") != std::string::npos);
+  assert(text.find("redlog_records_emitted_total{level=\"info\"} ") != std::string::npos);
+  assert(text.find("redlog_records_dropped_total{level=\"warn\"} ") != std::string::npos);
+  assert(text.find("# TYPE redlog_format_seconds histogram\n") != std::string::npos);
+  assert(text.find("redlog_sink_write_seconds_bucket{le=\"+Inf\"} ") != std::string::npos);
+  assert(text.find("redlog_sink_bytes_total{sink=\"audit\"} ") != std::string::npos);
+
+  // queues are labelled by name, repeats numbered; label values use prometheus escapes, not json ones
+  {
+    auto quiet = std::make_shared<string_sink>();
+    async_sink first(quiet, 8, overflow_policy::block, "net \"east\"\\\t");
+    async_sink second(quiet, 8, overflow_policy::block, "net \"east\"\\\t");
+    std::string labelled = stats().prometheus();
+    assert(labelled.find("redlog_async_queue_capacity{queue=\"net \\\"east\\\"\\\\\t\"} 8\n") != std::string::npos);
+    assert(labelled.find("redlog_async_queue_capacity{queue=\"net \\\"east\\\"\\\\\t.2\"} 8\n") != std::string::npos);
+  }
+}
+
+void test_console_sink() {
+  using namespace redlog;
+
+#ifndef _WIN32
+  // point fd 2 at a file, as a redirected service would
+  std::FILE* capture = std::tmpfile();
+  assert(capture != nullptr);
+  std::fflush(stderr);
+  int saved_stderr = dup(2);
+  dup2(fileno(capture), 2);
+
+  constexpr int thread_count = 8;
+  constexpr int per_thread = 200;
+  const std::string padding(100, 'x');
+  for (console_mode mode : {console_mode::direct, console_mode::combining}) {
+    auto sink_ptr = std::make_shared<console_sink>(mode);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+      threads.emplace_back([&, t] {
+        for (int i = 0; i < per_thread; ++i) {
+          sink_ptr->write("thread " + std::to_string(t) + " record " + std::to_string(i) + " " + padding);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    const std::string_view batch[] = {"batch one", "batch two"};
+    sink_ptr->write_batch(batch, {});
+    sink_ptr->flush();
+  }
+
+  dup2(saved_stderr, 2);
+  close(saved_stderr);
+
+  std::string output;
+  std::rewind(capture);
+  char chunk[4096];
+  for (std::size_t n; (n = std::fread(chunk, 1, sizeof(chunk), capture)) > 0;) {
+    output.append(chunk, n);
+  }
+  std::fclose(capture);
+
+  // every record arrives whole, on its own line, and each thread's records stay in order
+  std::istringstream lines(output);
+  std::string line;
+  int records = 0;
+  int batches = 0;
+  std::vector<int> next(thread_count, 0);
+  while (std::getline(lines, line)) {
+    if (line.rfind("batch ", 0) == 0) {
+      assert(line == (batches % 2 == 0 ? "batch one" : "batch two"));
+      batches++;
+      std::fill(next.begin(), next.end(), 0);
+      continue;
+    }
+    int t = -1;
+    int i = -1;
+    char rest[128] = {};
+    int scanned = std::sscanf(line.c_str(), "thread %d record %d %127s", &t, &i, rest);
+    assert(scanned == 3);
+    (void) scanned;
+    assert(t >= 0 && t < thread_count && i == next[t]);
+    assert(rest == padding);
+    next[t]++;
+    records++;
+  }
+  assert(records == 2 * thread_count * per_thread);
+  assert(batches == 4);
+#endif
+}
+
+#ifndef _WIN32
+// a loopback socket for network sink tests; returns the fd and sets port
+int open_loopback(int type, uint16_t& port) {
+  int fd = socket(AF_INET, type, 0);
+  assert(fd >= 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int bound = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  assert(bound == 0);
+  socklen_t length = sizeof(addr);
+  int named = getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length);
+  assert(named == 0);
+  (void) bound;
+  (void) named;
+  port = ntohs(addr.sin_port);
+  if (type == SOCK_STREAM) {
+    int listening = listen(fd, 4);
+    assert(listening == 0);
+    (void) listening;
+  }
+  timeval timeout{2, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return fd;
+}
+
+// read from a stream socket until `done` accepts what arrived or the peer stops sending
+template <typename Done> std::string read_until(int fd, Done done) {
+  timeval timeout{2, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  std::string data;
+  char chunk[4096];
+  while (!done(data)) {
+    ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+    if (got <= 0) {
+      break;
+    }
+    data.append(chunk, static_cast<size_t>(got));
+  }
+  return data;
+}
+#endif
+
+void test_network_sinks() {
+  using namespace redlog;
+
+#ifndef _WIN32
+  set_level(level::info);
+
+  // udp: one rfc 5424 datagram per record, fields as structured data
+  {
+    uint16_t port = 0;
+    int server = open_loopback(SOCK_DGRAM, port);
+    syslog_options options;
+    options.app_name = "tests";
+    options.facility = 16;
+    auto sink_ptr = std::make_shared<syslog_sink>(syslog_endpoint::udp("127.0.0.1", port), options);
+    auto log = logger("syslog", sink_ptr);
+    log.info("login", field("user", "alice"), field("note", "say \"hi\"]"), field("id", 7));
+    log.error("plain");
+    sink_ptr->flush();
+
+    char datagram[2048];
+    ssize_t n = recv(server, datagram, sizeof(datagram), 0);
+    assert(n > 0);
+    std::string first(datagram, static_cast<size_t>(n));
+    assert(first.rfind("<134>1 ", 0) == 0);
+    assert(first.find("Z ") == 33); // "<134>1 " plus a microsecond rfc 3339 time
+    assert(first.find(" tests " + std::to_string(getpid()) + " syslog ") != std::string::npos);
+    assert(first.find(" [fields@32473 user=\"alice\" note=\"say \\\"hi\\\"\\]\" id=\"7\"] login") != std::string::npos);
+    n = recv(server, datagram, sizeof(datagram), 0);
+    assert(n > 0);
+    std::string second(datagram, static_cast<size_t>(n));
+    assert(second.rfind("<131>1 ", 0) == 0);
+    assert(second.find(" syslog - plain") == second.size() - 15);
+    close(server);
+  }
+
+  // tcp: octet-counted frames
+  {
+    uint16_t port = 0;
+    int server = open_loopback(SOCK_STREAM, port);
+    auto sink_ptr = std::make_shared<syslog_sink>(syslog_endpoint::tcp("127.0.0.1", port));
+    auto log = logger("tcp", sink_ptr);
+    log.warn("one");
+    log.warn("two words");
+    log.info("three");
+    sink_ptr->flush();
+
+    int client = accept(server, nullptr, nullptr);
+    assert(client >= 0);
+    std::vector<std::string> frames;
+    read_until(client, [&](const std::string& data) {
+      frames.clear();
+      size_t at = 0;
+      while (at < data.size()) {
+        size_t space = data.find(' ', at);
+        if (space == std::string::npos) {
+          break;
+        }
+        size_t length = std::stoul(data.substr(at, space - at));
+        if (space + 1 + length > data.size()) {
+          break;
+        }
+        frames.push_back(data.substr(space + 1, length));
+        at = space + 1 + length;
+      }
+      return frames.size() == 3;
+    });
+    assert(frames.size() == 3);
+    assert(frames[0].rfind("<12>1 ", 0) == 0);
+    assert(frames[0].find(" - " + std::to_string(getpid()) + " tcp - one") != std::string::npos);
+    assert(frames[1].find(" tcp - two words") == frames[1].size() - 16);
+    assert(frames[2].rfind("<14>1 ", 0) == 0);
+    close(client);
+    close(server);
+  }
+
+  // otlp/http: one json post per batch
+  {
+    uint16_t port = 0;
+    int server = open_loopback(SOCK_STREAM, port);
+    std::string request;
+    std::thread collector([&] {
+      int client = accept(server, nullptr, nullptr);
+      assert(client >= 0);
+      request = read_until(client, [](const std::string& data) {
+        size_t end = data.find("\r\n\r\n");
+        size_t at = data.find("Content-Length: ");
+        return end != std::string::npos && at != std::string::npos &&
+               data.size() >= end + 4 + std::stoul(data.substr(at + 16));
+      });
+      const char response[] = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 2\r\n\r\n{}";
+      send(client, response, sizeof(response) - 1, 0);
+      close(client);
+    });
+
+    otlp_options options;
+    options.service_name = "tests";
+    options.headers.push_back({"X-Test", "1"});
+    auto sink_ptr = std::make_shared<otlp_sink>("http://127.0.0.1:" + std::to_string(port), options);
+    auto log = logger("otlp", sink_ptr);
+    log.warn("disk low", field("free", 12), field("ratio", 0.5), field("ok", false), field("path", "/var"));
+    sink_ptr->flush();
+    collector.join();
+    close(server);
+
+    assert(request.rfind("POST /v1/logs HTTP/1.1\r\n", 0) == 0);
+    assert(request.find("\r\nHost: 127.0.0.1:" + std::to_string(port) + "\r\n") != std::string::npos);
+    assert(request.find("\r\nContent-Type: application/json\r\n") != std::string::npos);
+    assert(request.find("\r\nX-Test: 1\r\n") != std::string::npos);
+    std::string body = request.substr(request.find("\r\n\r\n") + 4);
+    assert(
+        body.rfind("{\"resourceLogs\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\",\"value\":"
+                   "{\"stringValue\":\"tests\"}}]},\"scopeLogs\":[{\"scope\":{\"name\":\"redlog\"},\"logRecords\":[{",
+                   0) == 0
+    );
+    assert(body.find("\"severityNumber\":13,\"severityText\":\"warn\",\"body\":{\"stringValue\":\"disk low\"}") !=
+           std::string::npos);
+    assert(body.find("{\"key\":\"logger.name\",\"value\":{\"stringValue\":\"otlp\"}}") != std::string::npos);
+    assert(body.find("{\"key\":\"free\",\"value\":{\"intValue\":\"12\"}}") != std::string::npos);
+    assert(body.find("{\"key\":\"ratio\",\"value\":{\"doubleValue\":0.500000}}") != std::string::npos);
+    assert(body.find("{\"key\":\"ok\",\"value\":{\"boolValue\":false}}") != std::string::npos);
+    assert(body.find("{\"key\":\"path\",\"value\":{\"stringValue\":\"/var\"}}") != std::string::npos);
+    assert(body.substr(body.size() - 6) == "]}]}]}");
+
+    bool threw = false;
+    try {
+      otlp_sink("https://collector:4318");
+    } catch (const std::invalid_argument&) {
+      threw = true;
+    }
+    assert(threw);
+  }
+
+  // a collector that never reads: producers keep going and records are dropped
+  {
+    uint16_t port = 0;
+    int server = open_loopback(SOCK_STREAM, port);
+    syslog_options options;
+    options.network.queue_size = 16;
+    options.network.timeout = std::chrono::milliseconds(100);
+    const uint64_t dropped_before = stats().dropped[static_cast<int>(level::info)];
+    auto start = std::chrono::steady_clock::now();
+    {
+      auto log = logger("slow", std::make_shared<syslog_sink>(syslog_endpoint::tcp("127.0.0.1", port), options));
+      const std::string payload(1024, 'p');
+      for (int i = 0; i < 20000; ++i) {
+        log.info(payload);
+      }
+      assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+    }
+    assert(stats().dropped[static_cast<int>(level::info)] > dropped_before);
+    close(server);
+  }
+#endif
+}
+
+// compiled as if the build set REDLOG_MIN_LEVEL=2 (warn); the level macros read it where they expand
+#pragma push_macro("REDLOG_MIN_LEVEL")
+#undef REDLOG_MIN_LEVEL
+#define REDLOG_MIN_LEVEL 2
+void log_with_warn_minimum(const redlog::logger& log, int& evaluated) {
+  using namespace redlog;
+  const auto expensive = [&evaluated] { return ++evaluated; };
+  REDLOG_CRITICAL(log, "kept", field("value", expensive()));
+  REDLOG_WARN_F(log, "kept %d", expensive());
+  REDLOG_INFO(log, "removed", field("value", expensive()));
+  REDLOG_DEBUG(log, "removed", field("value", expensive()), field::lazy("state", expensive));
+  REDLOG_ANNOYING_F(log, "removed %d", expensive());
+  REDLOG_INFO((evaluated += 100, log), "removed, logger expression included");
+}
+#pragma pop_macro("REDLOG_MIN_LEVEL")
+
+void test_compile_time_levels() {
+  using namespace redlog;
+
+  // every level is on at runtime, so only the compile-time cut can skip a call
+  level previous = get_level();
+  set_level(level::annoying);
+  auto sink_ptr = std::make_shared<string_sink>();
+  auto log = logger("cut", std::make_shared<default_formatter>(themes::plain), sink_ptr);
+
+  int evaluated = 0;
+  log_with_warn_minimum(log, evaluated);
+  assert(evaluated == 2);
+  std::string output = sink_ptr->get_output();
+  assert(output.find("kept") != std::string::npos && output.find("value=1") != std::string::npos);
+  assert(output.find("kept 2") != std::string::npos);
+  assert(output.find("removed") == std::string::npos);
+
+  // the same macros in this file, built with every level, still log
+  REDLOG_ANNOYING(log, "annoying kept");
+  assert(sink_ptr->get_output().find("annoying kept") != std::string::npos);
+  set_level(previous);
+}
+
+void test_logger_registry() {
+  using namespace redlog;
+
+  level previous = get_level();
+  set_level(level::info);
+  auto main_sink = std::make_shared<string_sink>();
+  auto audit_sink = std::make_shared<string_sink>();
+
+  // fetched before any configuration: registry loggers follow later changes
+  auto app = get_logger("registry");
+  auto audit = get_logger("registry.audit");
+  set_default_sink(main_sink);
+  set_default_formatter(std::make_shared<default_formatter>(themes::plain));
+
+  app.info("to the default sink");
+  audit.info("audit before routing");
+  assert(main_sink->get_output().rfind("[registry]", 0) == 0);
+  assert(main_sink->get_output().find("[inf] to the default sink") != std::string::npos);
+  assert(main_sink->get_output().find("audit before routing") != std::string::npos);
+
+  // routes apply to the name and below it, including loggers derived with with_name
+  set_sink("registry.audit", audit_sink);
+  main_sink->clear();
+  audit.info("login");
+  app.with_name("audit").with_name("login").warn_f("failed for %s", "bob");
+  app.info("still default");
+  assert(audit_sink->get_output().find("[registry.audit] [inf] login") != std::string::npos);
+  assert(audit_sink->get_output().find("[registry.audit.login] [wrn] failed for bob") != std::string::npos);
+  assert(audit_sink->get_output().find("[registry]") == std::string::npos);
+  assert(audit_sink->get_output().find("still default") == std::string::npos);
+  assert(main_sink->get_output().find("still default") != std::string::npos);
+  assert(main_sink->get_output().find("login") == std::string::npos);
+
+  clear_sink("registry.audit");
+  audit_sink->clear();
+  audit.info("back on default");
+  assert(audit_sink->get_output().empty());
+  assert(main_sink->get_output().find("back on default") != std::string::npos);
+
+  // a formatter change reaches existing loggers as well
+  set_default_formatter(std::make_shared<json_formatter>(std::nullopt));
+  main_sink->clear();
+  app.info("as json");
+  assert(main_sink->get_output() == "{\"level\":\"info\",\"source\":\"registry\",\"message\":\"as json\"}\n");
+  set_default_formatter(nullptr);
+
+  // a known name is a lookup and a copy, without allocating
+  get_logger("registry.hot").info("warm up");
+  alloc_tracking::count = 0;
+  alloc_tracking::enabled = true;
+  for (int i = 0; i < 100; ++i) {
+    auto hot = get_logger("registry.hot");
+    (void) hot;
+  }
+  alloc_tracking::enabled = false;
+  assert(alloc_tracking::count == 0);
+
+  // concurrent first lookups of the same names agree
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([] {
+      for (int i = 0; i < 50; ++i) {
+        get_logger("registry.concurrent." + std::to_string(i)).info("hello");
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::string output = main_sink->get_output();
+  std::size_t hellos = 0;
+  for (std::size_t at = output.find("hello"); at != std::string::npos; at = output.find("hello", at + 1)) {
+    hellos++;
+  }
+  assert(hellos == 8 * 50);
+
+  // deferred printf records reach a route the way the route takes records, whatever the default sink does
+  struct entry_sink : sink {
+    std::vector<std::string> entries;
+    void write(std::string_view formatted) override { entries.emplace_back(formatted); }
+    void write_entry(const log_entry& entry, const formatter&) override {
+      std::string text(entry.source);
+      text += ": " + std::string(entry.message);
+      for (const auto& f : entry.fields.fields()) {
+        text += " " + std::string(f.key) + "=" + f.value.str();
+      }
+      entries.push_back(std::move(text));
+    }
+    void flush() override {}
+  };
+  auto structured = std::make_shared<entry_sink>();
+  auto queued_default = std::make_shared<async_sink>(std::make_shared<string_sink>());
+  set_default_sink(queued_default);
+  set_sink("registry.otel", structured);
+  get_logger("registry.otel").with_field("peer", "a").info_f("sent %d bytes", 42);
+  assert(structured->entries.size() == 1);
+  assert(structured->entries[0] == "registry.otel: sent 42 bytes peer=a");
+
+  auto queued_inner = std::make_shared<string_sink>();
+  auto queued_route = std::make_shared<async_sink>(queued_inner);
+  set_default_sink(main_sink);
+  set_sink("registry.otel", queued_route);
+  get_logger("registry.otel").info_f("queued %d", 7);
+  queued_route->flush();
+  assert(queued_inner->get_output().find("queued 7") != std::string::npos);
+  clear_sink("registry.otel");
+
+  // a replaced sink is released once no record in flight uses it
+  auto replaced = std::make_shared<string_sink>();
+  std::weak_ptr<string_sink> released = replaced;
+  set_default_sink(std::move(replaced));
+  app.info("to a sink about to be replaced");
+  set_default_sink(nullptr);
+  assert(released.expired());
+
+  set_level(previous);
+}
+
+void test_zero_copy_fields() {
+  using namespace redlog;
+
+  // field::ref views the text in place
+  static const std::string region(64, 'r');
+  field viewed = field::ref("region", region);
+  assert(viewed.value.type() == field_value::kind::view);
+  assert(viewed.value.text().data() == region.data());
+
+  alloc_tracking::count = 0;
+  alloc_tracking::enabled = true;
+  field again = field::ref("region", region);
+  alloc_tracking::enabled = false;
+  assert(alloc_tracking::count == 0);
+  assert(again.value == region);
+
+  // pre-rendered context writes the same line as the same fields added one by one
+  auto rendered_sink = std::make_shared<string_sink>();
+  auto plain_sink = std::make_shared<string_sink>();
+  auto fmt = std::make_shared<default_formatter>();
+  rendered_fields connection{field("conn", 7), field("peer", "10.0.0.1"), field::ref("region", region)};
+  assert(connection.size() == 3);
+  assert(connection.text_for(detail::current_config().styles) != nullptr);
+
+  auto with_rendered = logger("conn", fmt, rendered_sink).with_fields(connection);
+  auto with_plain =
+      logger("conn", fmt, plain_sink).with_fields(field("conn", 7), field("peer", "10.0.0.1"), field("region", region));
+  const auto run = [](const logger& log) {
+    log.info("opened");
+    log.info("read", field("bytes", 512));
+    log.info_f("closed after %d ms", 12);
+    log.with_name("tls").with_field("cipher", "aes").warn("renegotiated");
+  };
+  run(with_rendered);
+  run(with_plain);
+  assert(rendered_sink->get_output() == plain_sink->get_output());
+  assert(rendered_sink->get_output().find("peer") != std::string::npos);
+
+  // fields already on the logger are rendered along with the new ones
+  rendered_sink->clear();
+  plain_sink->clear();
+  logger("conn", fmt, rendered_sink).with_field("shard", 2).with_fields(connection).info("nested", field("n", 1));
+  logger("conn", fmt, plain_sink)
+      .with_fields(field("shard", 2), field("conn", 7), field("peer", "10.0.0.1"), field("region", region))
+      .info("nested", field("n", 1));
+  assert(rendered_sink->get_output() == plain_sink->get_output());
+
+  // a formatter with other field styles, and structured formatters, format the fields themselves
+  rendered_sink->clear();
+  plain_sink->clear();
+  rendered_fields themed({field("conn", 7)}, themes::default_theme);
+  auto other_fmt = std::make_shared<default_formatter>(themes::plain);
+  logger("conn", other_fmt, rendered_sink).with_fields(themed).info("themed");
+  logger("conn", other_fmt, plain_sink).with_field("conn", 7).info("themed");
+  assert(rendered_sink->get_output() == plain_sink->get_output());
+
+  rendered_sink->clear();
+  logger("conn", std::make_shared<json_formatter>(std::nullopt), rendered_sink).with_fields(connection).info("json");
+  assert(rendered_sink->get_output().find("\"peer\":\"10.0.0.1\"") != std::string::npos);
+}
+
 int main() {
   std::cout << "=== redlog Test Suite ===\n\n";
 
@@ -1415,6 +3574,35 @@ int main() {
   runner.run_test("Thread Safety", test_thread_safety);
   runner.run_test("Error Handling", test_error_handling);
   runner.run_test("Performance Characteristics", test_performance_characteristics);
+  runner.run_test("Async Sink", test_async_sink);
+  runner.run_test("Deferred Formatting", test_deferred_formatting);
+  runner.run_test("Compiled Format Strings", test_compiled_format);
+  runner.run_test("Format Buffer", test_fmt_buffer);
+  runner.run_test("Allocation-Free Logging", test_allocation_free_logging);
+  runner.run_test("ANSI Styles", test_ansi_styles);
+  runner.run_test("Context Chains", test_context_chains);
+  runner.run_test("Buffered File Sink", test_buffered_file_sink);
+  runner.run_test("Rotating File Sink", test_rotating_file_sink);
+  runner.run_test("Memory-Mapped File Sink", test_mmap_file_sink);
+  runner.run_test("Binary Log Format", test_binary_log);
+  runner.run_test("Lazy Fields and Macros", test_lazy_fields_and_macros);
+  runner.run_test("Hierarchical Levels", test_hierarchical_levels);
+  runner.run_test("Runtime Config Updates", test_runtime_config_updates);
+  runner.run_test("Distributing Sink", test_dist_sink);
+  runner.run_test("Batched Writes", test_batched_writes);
+  runner.run_test("Timestamps and Clocks", test_timestamps_and_clocks);
+  runner.run_test("Interned Names and Keys", test_interning);
+  runner.run_test("Typed Field Values", test_typed_field_values);
+  runner.run_test("Rate Limiting", test_rate_limiting);
+  runner.run_test("Structured Formatters", test_structured_formatters);
+  runner.run_test("Source Locations", test_source_locations);
+  runner.run_test("Flight Recorder", test_flight_recorder);
+  runner.run_test("Statistics", test_statistics);
+  runner.run_test("Console Sink", test_console_sink);
+  runner.run_test("Network Sinks", test_network_sinks);
+  runner.run_test("Compile-Time Levels", test_compile_time_levels);
+  runner.run_test("Logger Registry", test_logger_registry);
+  runner.run_test("Zero-Copy Fields", test_zero_copy_fields);
 
   runner.print_summary();
 
@@ -0,0 +1,157 @@
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <redlog.hpp>
+#include <string>
+
+// redlog-decode: render binary_sink logs as the default text layout or as json lines
+
+namespace {
+
+void usage() {
+  std::cerr << "usage: redlog-decode [--json] <file>...\n"
+            << "  renders logs written by redlog::binary_sink; '-' reads stdin\n";
+}
+
+using redlog::detail::append_json_string;
+
+// numbers and booleans as json literals, everything else as a string
+void append_json_value(std::string& out, const redlog::field_value& value) {
+  using kind = redlog::field_value::kind;
+  switch (value.type()) {
+  case kind::boolean:
+    out += value.as_bool() ? "true" : "false";
+    return;
+  case kind::int64:
+  case kind::uint64:
+    out += value.str();
+    return;
+  case kind::float64:
+    if (std::isfinite(value.as_double())) {
+      out += value.str();
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+  append_json_string(out, value.str());
+}
+
+bool stdout_is_tty() {
+#ifdef _WIN32
+  return _isatty(_fileno(stdout)) != 0;
+#else
+  return isatty(fileno(stdout)) != 0;
+#endif
+}
+
+// rfc 3339 utc time with nanoseconds
+std::string format_time(std::chrono::system_clock::time_point time) {
+  auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+  std::time_t seconds = static_cast<std::time_t>(nanoseconds / 1000000000);
+  long fraction = static_cast<long>(nanoseconds % 1000000000);
+  if (fraction < 0) {
+    seconds -= 1;
+    fraction += 1000000000;
+  }
+
+  std::tm parts{};
+#ifdef _WIN32
+  gmtime_s(&parts, &seconds);
+#else
+  gmtime_r(&seconds, &parts);
+#endif
+  char buffer[64];
+  std::size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &parts);
+  std::snprintf(buffer + length, sizeof(buffer) - length, ".%09ldZ", fraction);
+  return buffer;
+}
+
+std::string to_json(const redlog::binary_record& record) {
+  std::string out = "{\"time\":";
+  append_json_string(out, format_time(record.timestamp));
+  out += ",\"level\":";
+  append_json_string(out, redlog::level_name(record.level_val));
+  out += ",\"source\":";
+  append_json_string(out, record.source);
+  out += ",\"message\":";
+  append_json_string(out, record.message);
+  if (!record.format.empty()) {
+    out += ",\"format\":";
+    append_json_string(out, record.format);
+  }
+  for (const auto& f : record.fields.fields()) {
+    out.push_back(',');
+    append_json_string(out, f.key);
+    out.push_back(':');
+    append_json_value(out, f.value);
+  }
+  out.push_back('}');
+  return out;
+}
+
+bool decode(std::istream& in, const std::string& name, bool json, const redlog::formatter& text_formatter) {
+  std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  redlog::binary_reader reader(data);
+  redlog::binary_record record;
+
+  while (reader.next(record)) {
+    if (json) {
+      std::cout << to_json(record) << '\n';
+    } else {
+      std::cout << text_formatter.format(record.entry()) << '\n';
+    }
+  }
+
+  if (!reader.error().empty()) {
+    std::cerr << "redlog-decode: " << name << ": " << reader.error() << "\n";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  bool json = false;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--json") {
+      json = true;
+    } else if (arg == "-h" || arg == "--help") {
+      usage();
+      return 0;
+    } else {
+      files.push_back(arg);
+    }
+  }
+  if (files.empty()) {
+    usage();
+    return 2;
+  }
+
+  // colors only when they would reach a terminal
+  bool color = redlog::detail::should_use_color() && stdout_is_tty();
+  redlog::default_formatter text_formatter(color ? redlog::themes::default_theme : redlog::themes::plain);
+
+  bool ok = true;
+  for (const auto& file : files) {
+    if (file == "-") {
+      ok = decode(std::cin, "<stdin>", json, text_formatter) && ok;
+      continue;
+    }
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+      std::cerr << "redlog-decode: cannot open " << file << "\n";
+      ok = false;
+      continue;
+    }
+    ok = decode(in, file, json, text_formatter) && ok;
+  }
+  return ok ? 0 : 1;
+}